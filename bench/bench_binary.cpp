@@ -0,0 +1,51 @@
+#include "../include/log.hpp"
+#include <ctime>
+#include <cstdio>
+#include <iostream>
+#include <string>
+/*
+    二进制格式与文本格式的对比测试
+    同步日志器分别写入文本文件和二进制文件,统计每条日志的字节数和CPU耗时
+    用法: bench_binary [条数]
+*/
+
+static double Run(Log::Sink::ptr sink, const std::string &name, size_t count)
+{
+    Log::LogGer::Logger::ptr lg;
+    {
+        Log::LogGer::LoggerBuilder::ptr bp = std::make_shared<Log::LogGer::LocalLogder>();
+        bp->InitLevel(Log::LogLevel::DEBUG);
+        bp->InitLoggerType(Log::Data::SYNCLOGGER);
+        bp->InitLoggername(name);
+        bp->InitFormat(Log::Data::defaultformat());
+        bp->InitSinkWay(sink);
+        lg = bp->InitLB();
+    }
+    std::string ip = "10.0.0.1";
+    std::clock_t begin = std::clock();
+    for (size_t i = 0; i < count; ++i)
+        lg->Info(__LINE__, __FILE__, "user {} login from {} took {} ms", i, ip, 3.25);
+    std::clock_t end = std::clock();
+    return double(end - begin) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 200000;
+    const std::string text = "./bench_logs/text.log", bin = "./bench_logs/binary.blog";
+    std::remove(text.c_str());
+    std::remove(bin.c_str());
+
+    double ttext = Run(Log::SinkFactory::FiletSink(text), "bench_text", count);
+    double tbin = Run(Log::SinkFactory::BinaryFileSink(bin), "bench_binary", count);
+
+    Log::tool::File::FileInfo ti, bi;
+    Log::tool::File::GetFileInfo(text, ti);
+    Log::tool::File::GetFileInfo(bin, bi);
+    printf("%-8s %12s %14s %14s\n", "格式", "字节/条", "CPU ns/条", "总字节");
+    printf("%-8s %12.1f %14.1f %14llu\n", "text", double(ti.size) / count, ttext * 1e9 / count,
+           (unsigned long long)ti.size);
+    printf("%-8s %12.1f %14.1f %14llu\n", "binary", double(bi.size) / count, tbin * 1e9 / count,
+           (unsigned long long)bi.size);
+    return 0;
+}
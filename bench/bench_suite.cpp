@@ -0,0 +1,320 @@
+#include "../include/log.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+/*
+    日志性能测试套件
+    按场景组合日志器类型(同步/AnsyCtrlCommon/AnsyCtrlThpool)、线程数、输出格式、参数个数、消息长度和落地方向,
+    每个场景统计每次调用耗时的分位数、调用吞吐量和包含后台写完的整体吞吐量,结果以JSON输出,便于比较不同版本
+    每次调用前后各取一次单调时钟,调用耗时包含约几十纳秒的计时开销
+
+    用法: bench_suite [选项]
+        --count N        每个场景的日志总条数(平均分给各线程),默认200000
+        --threads 1,2,4  线程数场景使用的线程数,默认1,2,4,8,16,32,64
+        --groups a,b     只运行指定的场景组: threads,pattern,args,size,sink
+        --out FILE       JSON输出文件,默认./bench_logs/bench.json,为-时输出到标准错误
+        --quick          少量条数和线程数,用于快速检查
+    stdout落地方向会写标准输出,建议运行时把标准输出重定向到/dev/null
+*/
+
+namespace
+{
+    class NullSink : public Log::Sink
+    {
+    public:
+        void WriteFile(const std::string &str) override { _bytes += str.size(); }
+        void WriteData(const char *, size_t len) override { _bytes += len; }
+        std::atomic<size_t> _bytes{0};
+    };
+
+    struct Case
+    {
+        std::string group;
+        std::string mode; // sync / common / thpool
+        size_t threads;
+        std::string pattern; // minimal / default / json
+        size_t args;
+        size_t size;
+        std::string sink; // null / file / roll / stdout
+    };
+
+    struct Result
+    {
+        Case c;
+        size_t messages;
+        double call_seconds;  // 所有生产线程从开始到调用结束
+        double total_seconds; // 包含异步后台写完
+        Log::LatencyStats latency;
+        size_t dropped;
+        size_t bytes; // 交给落地方向的字节数
+    };
+
+    const char *PatternOf(const std::string &name)
+    {
+        if (name == "minimal")
+            return "%c%n";
+        if (name == "json")
+            return Log::Data::JSONLINES;
+        return "[%L][%N][{%Y-%m-%d %H:%M:%S}][%f:%l][%t] %c%n";
+    }
+
+    Log::Sink::ptr SinkOf(const std::string &name, size_t id)
+    {
+        std::string base = "./bench_logs/suite/" + std::to_string(id);
+        if (name == "file")
+            return Log::SinkFactory::FiletSink(base + ".log");
+        if (name == "roll")
+            return Log::SinkFactory::RollFileSink(16 * 1024 * 1024, base + "_roll", Log::Data::NONE, Log::RetainPolicy(2));
+        if (name == "stdout")
+            return Log::SinkFactory::StdoutSink();
+        return std::make_shared<NullSink>();
+    }
+
+    // 按参数个数调用,消息正文用text补足到指定长度
+    void Call(Log::LogGer::Logger::ptr &lg, size_t args, const std::string &text, size_t i)
+    {
+        switch (args)
+        {
+        case 0:
+            lg->INFO(text.c_str());
+            break;
+        case 1:
+            lg->INFO("{} {}", text, i);
+            break;
+        case 3:
+            lg->INFO("{} id={} cost={} ok={}", text, i, i * 0.25, true);
+            break;
+        default:
+            lg->INFO("{} id={} cost={} ok={} user={} ip={} code={}", text, i, i * 0.25, true, "guest", "10.0.0.1", -1);
+            break;
+        }
+    }
+
+    Result Run(const Case &c, size_t count, size_t id)
+    {
+        Log::LogGer::Logger::ptr lg;
+        {
+            Log::LogGer::LoggerBuilder::ptr bp = std::make_shared<Log::LogGer::LocalLogder>();
+            bp->InitLevel(Log::LogLevel::DEBUG);
+            bp->InitLoggerType(c.mode == "sync" ? Log::Data::SYNCLOGGER : Log::Data::ASYNLOGGER);
+            bp->InitACType(c.mode == "thpool" ? Log::Data::THPOOL : Log::Data::COMMON);
+            bp->InitLoggername("bench_" + std::to_string(id));
+            bp->InitFormat(PatternOf(c.pattern));
+            bp->InitSinkWay(SinkOf(c.sink, id));
+            lg = bp->InitLB();
+        }
+        std::string text(c.size, 'x');
+        size_t per = count / c.threads ? count / c.threads : 1;
+
+        // 各线程分别记录,最后合并
+        std::vector<std::unique_ptr<Log::Histogram>> hists;
+        for (size_t t = 0; t < c.threads; ++t)
+            hists.emplace_back(new Log::Histogram());
+        std::atomic<size_t> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> ths;
+        for (size_t t = 0; t < c.threads; ++t)
+        {
+            ths.emplace_back([&, t]()
+                             {
+                Log::Histogram &h = *hists[t];
+                // 预热:格式化缓冲区和记录池的线程缓存
+                for (size_t i = 0; i < 100; ++i)
+                    Call(lg, c.args, text, i);
+                ++ready;
+                while (!go.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                for (size_t i = 0; i < per; ++i)
+                {
+                    uint64_t begin = Log::Histogram::Now();
+                    Call(lg, c.args, text, i);
+                    h.record(Log::Histogram::Now() - begin);
+                } });
+        }
+        while (ready.load() < c.threads)
+            std::this_thread::yield();
+        auto begin = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto &th : ths)
+            th.join();
+        auto called = std::chrono::steady_clock::now();
+
+        Result r;
+        r.c = c;
+        r.messages = per * c.threads;
+        // 统计在停止前读取,停止时等待后台写完缓冲区
+        std::vector<Log::ChannelStats> before = lg->getSinkStats();
+        r.dropped = before[0].dropped;
+        lg.reset();
+        auto done = std::chrono::steady_clock::now();
+        r.call_seconds = std::chrono::duration<double>(called - begin).count();
+        r.total_seconds = std::chrono::duration<double>(done - begin).count();
+        Log::Histogram all;
+        for (auto &h : hists)
+            all.merge(*h);
+        r.latency = all.stats();
+        r.bytes = before[0].pushed;
+        return r;
+    }
+
+    std::string Escape(const std::string &s)
+    {
+        std::string res;
+        for (char ch : s)
+        {
+            if (ch == '"' || ch == '\\')
+                res.push_back('\\');
+            res.push_back(ch);
+        }
+        return res;
+    }
+
+    std::string ToJson(const std::vector<Result> &results, size_t count)
+    {
+        std::ostringstream out;
+        out.precision(10);
+        char date[32];
+        time_t now = time(nullptr);
+        Log::Data::FormatTime(date, sizeof(date), now, "%Y-%m-%dT%H:%M:%S");
+        out << "{\n  \"schema\": 1,\n  \"date\": \"" << date << "\",\n"
+            << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"count\": " << count << ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &r = results[i];
+            const Log::LatencyStats &l = r.latency;
+            out << (i ? "," : "") << "\n    {"
+                << "\"group\": \"" << Escape(r.c.group) << "\", "
+                << "\"mode\": \"" << r.c.mode << "\", "
+                << "\"threads\": " << r.c.threads << ", "
+                << "\"pattern\": \"" << r.c.pattern << "\", "
+                << "\"args\": " << r.c.args << ", "
+                << "\"size\": " << r.c.size << ", "
+                << "\"sink\": \"" << r.c.sink << "\", "
+                << "\"messages\": " << r.messages << ", "
+                << "\"call_seconds\": " << r.call_seconds << ", "
+                << "\"total_seconds\": " << r.total_seconds << ", "
+                << "\"calls_per_sec\": " << r.messages / r.call_seconds << ", "
+                << "\"msgs_per_sec\": " << r.messages / r.total_seconds << ", "
+                << "\"bytes_per_sec\": " << r.bytes / r.total_seconds << ", "
+                << "\"dropped\": " << r.dropped << ", "
+                << "\"latency_ns\": {"
+                << "\"mean\": " << (l.count ? l.sum_ns / l.count : 0) << ", "
+                << "\"p50\": " << l.p50_ns << ", "
+                << "\"p90\": " << l.p90_ns << ", "
+                << "\"p99\": " << l.p99_ns << ", "
+                << "\"p999\": " << l.p999_ns << ", "
+                << "\"max\": " << l.max_ns << "}}";
+        }
+        out << "\n  ]\n}\n";
+        return out.str();
+    }
+
+    std::vector<size_t> ParseList(const std::string &s)
+    {
+        std::vector<size_t> res;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                res.push_back(std::stoul(item));
+        return res;
+    }
+
+    bool Selected(const std::string &groups, const std::string &g)
+    {
+        return groups.empty() || ("," + groups + ",").find("," + g + ",") != std::string::npos;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 200000;
+    std::vector<size_t> threads = {1, 2, 4, 8, 16, 32, 64};
+    std::string groups, outfile = "./bench_logs/bench.json";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool more = i + 1 < argc;
+        if (arg == "--count" && more)
+            count = std::stoul(argv[++i]);
+        else if (arg == "--threads" && more)
+            threads = ParseList(argv[++i]);
+        else if (arg == "--groups" && more)
+            groups = argv[++i];
+        else if (arg == "--out" && more)
+            outfile = argv[++i];
+        else if (arg == "--quick")
+        {
+            count = 20000;
+            threads = {1, 4, 16};
+        }
+        else
+        {
+            fprintf(stderr, "用法: %s [--count N] [--threads 1,2,4] [--groups threads,pattern,args,size,sink] [--out FILE] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+    Log::tool::File::createFilePath("./bench_logs/suite");
+    if (outfile != "-")
+        Log::tool::File::createFilePath(Log::tool::File::GetFilepath(outfile));
+
+    // 每组只改变一个维度,其余取基准值:默认格式、3个参数、64字节、null落地方向
+    std::vector<Case> cases;
+    const char *modes[] = {"sync", "common", "thpool"};
+    if (Selected(groups, "threads"))
+        for (const char *m : modes)
+            for (size_t t : threads)
+                cases.push_back({"threads", m, t, "default", 3, 64, "null"});
+    if (Selected(groups, "pattern"))
+        for (const char *m : modes)
+            for (const char *p : {"minimal", "default", "json"})
+                cases.push_back({"pattern", m, 1, p, 3, 64, "null"});
+    if (Selected(groups, "args"))
+        for (const char *m : modes)
+            for (size_t a : {0, 1, 3, 7})
+                cases.push_back({"args", m, 1, "default", a, 64, "null"});
+    if (Selected(groups, "size"))
+        for (const char *m : modes)
+            for (size_t s : {16, 256, 1024, 4096})
+                cases.push_back({"size", m, 1, "default", 3, s, "null"});
+    if (Selected(groups, "sink"))
+        for (const char *m : modes)
+            for (const char *s : {"null", "file", "roll", "stdout"})
+                cases.push_back({"sink", m, 1, "default", 3, 64, s});
+
+    std::vector<Result> results;
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        const Case &c = cases[i];
+        Result r = Run(c, count, i);
+        results.push_back(r);
+        fprintf(stderr, "[%3zu/%zu] %-8s %-7s t=%-3zu %-8s args=%zu size=%-5zu %-6s %12.0f msg/s  p50=%llu p99=%llu p999=%llu ns  dropped=%zu\n",
+                i + 1, cases.size(), c.group.c_str(), c.mode.c_str(), c.threads, c.pattern.c_str(), c.args, c.size,
+                c.sink.c_str(), r.messages / r.total_seconds, (unsigned long long)r.latency.p50_ns,
+                (unsigned long long)r.latency.p99_ns, (unsigned long long)r.latency.p999_ns, r.dropped);
+    }
+
+    std::string json = ToJson(results, count);
+    if (outfile == "-")
+    {
+        std::cerr << json;
+        return 0;
+    }
+    if (!Log::tool::File::WriteFileAtomic(outfile, json))
+    {
+        fprintf(stderr, "写入%s失败\n", outfile.c_str());
+        return 1;
+    }
+    fprintf(stderr, "结果已写入%s\n", outfile.c_str());
+    return 0;
+}
@@ -12,27 +12,54 @@
 #include <mutex>
 #include <functional>
 #include <type_traits>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
 #include "tool.hpp"
+#include "level.hpp"
 
 #define DConfig ConfigManager::getInstance()::setDefaultConfig()
 
 // X-Macro技术：用于自动添加新配置项
 // 用户只需在CONFIG_ITEMS列表中添加一行即可完成新配置项的添加
 #define CONFIG_ITEMS(X)                                                                             \
-    X(TIME_FORMAT, "log.time_format", "%Y-%m-%d %H:%M:%S", String, {}, "时间格式")                  \
-    X(MAX_LOGFILE_SIZE, "log.max_logfile_size", "10485760", SizeT, {}, "最大日志文件大小(字节)")    \
-    X(EXCEED_SIZE, "log.Exceed_size", "1024", SizeT, {}, "日志文件大小可超过阈值的大小(字节)")      \
-    X(MAX_BUFFER_SIZE, "log.max_buffer_size", "1048567", SizeT, {}, "最大缓冲区大小(字节)")         \
-    X(FORMAT, "log.format", "[%L][%N][{%Y-%m-%d %H:%M:%S}][%f][%l][%c]%n", String, {}, "日志格式")  \
-    X(FILE_TIME_FORMAT, "log.file_time_format", "%Y%m%d%H%M%S", String, {}, "文件时间格式")         \
-    X(BASE_FILE_NAME, "log.BaseFileName", "../logs/log", String, {}, "基础文件名")                  \
-    X(BOUND_SYMBOL, "log.BoundSymbol", "_", Char, {}, "文件名连接符")                               \
-    X(FILE_EXTENSION, "log.file_extension", ".txt", String, {}, "文件扩展名")                       \
-    X(MAX_FILE_SERIAL, "log.MaxFileSerial", "50", SizeT, {}, "最大文件序号")                        \
-    X(THREAD_COUNT, "log.threadCount", "5", SizeT, {}, "线程数")                                    \
-    X(DLOGGER_TYPE, "log.DLoggerType", "ASYNLOGGER", String, {}, "默认日志记录器类型")              \
-    X(DANSY_CTRL_TYPE, "log.DAnsyCtrlType", "COMMON", String, {}, "默认异步控制类型 COMMON/THPOOL") \
-    X(DLEVEL, "log.DLevel", "DEBUG", String, {}, "默认日志级别")
+    X(TIME_FORMAT, "log.time_format", "%Y-%m-%d %H:%M:%S", String, ConfigCheck::NonEmpty(), "时间格式")                  \
+    X(MAX_LOGFILE_SIZE, "log.max_logfile_size", "10485760", SizeT, ConfigCheck::Range(1), "最大日志文件大小(字节)")    \
+    X(EXCEED_SIZE, "log.Exceed_size", "1024", SizeT, ConfigCheck::Range(0), "日志文件大小可超过阈值的大小(字节)")      \
+    X(MAX_BUFFER_SIZE, "log.max_buffer_size", "1048567", SizeT, ConfigCheck::Range(1), "最大缓冲区大小(字节)")         \
+    X(FORMAT, "log.format", "[%L][%N][{%Y-%m-%d %H:%M:%S}][%f][%l][%c]%n", String, ConfigCheck::NonEmpty(), "日志格式")  \
+    X(FILE_TIME_FORMAT, "log.file_time_format", "%Y%m%d%H%M%S", String, ConfigCheck::NonEmpty(), "文件时间格式")         \
+    X(BASE_FILE_NAME, "log.BaseFileName", "../logs/log", String, ConfigCheck::NonEmpty(), "基础文件名")                  \
+    X(BOUND_SYMBOL, "log.BoundSymbol", "_", Char, ConfigCheck::Symbol(), "文件名连接符")                               \
+    X(FILE_EXTENSION, "log.file_extension", ".txt", String, ConfigCheck::NonEmpty(), "文件扩展名")                       \
+    X(MAX_FILE_SERIAL, "log.MaxFileSerial", "50", SizeT, ConfigCheck::Range(1), "已不再使用,文件序号单调递增不回绕(保留以兼容旧配置)")                        \
+    X(THREAD_COUNT, "log.threadCount", "5", SizeT, ConfigCheck::Range(1, 1024), "线程数")                                    \
+    X(DLOGGER_TYPE, "log.DLoggerType", "ASYNLOGGER", EnumLoggerType, ConfigCheck::OneOf("ASYNLOGGER|SYNCLOGGER"), "默认日志记录器类型")              \
+    X(DANSY_CTRL_TYPE, "log.DAnsyCtrlType", "COMMON", EnumAnsyCtrl, ConfigCheck::OneOf("COMMON|THPOOL"), "默认异步控制类型 COMMON/THPOOL") \
+    X(DLEVEL, "log.DLevel", "DEBUG", EnumLevel, ConfigCheck::Level(), "默认日志级别")                                    \
+    X(ROLL_INTERVAL, "log.roll_interval", "NONE", EnumRoll, ConfigCheck::OneOf("NONE|HOURLY|DAILY"), "按时间滚动周期 NONE/HOURLY/DAILY")   \
+    X(RETAIN_COUNT, "log.retain_count", "0", SizeT, ConfigCheck::Range(0), "最多保留的滚动文件个数(0为不限制)")        \
+    X(RETAIN_BYTES, "log.retain_bytes", "0", SizeT, ConfigCheck::Range(0), "滚动文件总大小上限(字节,0为不限制)")       \
+    X(RETAIN_SECONDS, "log.retain_seconds", "0", SizeT, ConfigCheck::Range(0), "滚动文件最长保留时间(秒,0为不限制)")   \
+    X(COMPRESS, "log.compress", "NONE", EnumCompress, ConfigCheck::OneOf("NONE|GZIP|FAST"), "滚动后压缩方式 NONE/GZIP/FAST")                \
+    X(COMPRESS_THREADS, "log.compress_threads", "1", SizeT, ConfigCheck::Range(1, 64), "后台压缩并发上限")                  \
+    X(COMPRESS_NICE, "log.compress_nice", "10", SizeT, ConfigCheck::Range(0, 19), "后台压缩线程nice值")                     \
+    X(OVERFLOW_POLICY, "log.overflow_policy", "BLOCK", EnumOverflow, ConfigCheck::OneOf("BLOCK|DROP"), "异步缓冲区满时的处理 BLOCK/DROP") \
+    X(BACKTRACE_SIZE, "log.backtrace_size", "0", SizeT, ConfigCheck::Range(0), "内存中保留的被过滤日志条数(0为关闭)")    \
+    X(BACKTRACE_LEVEL, "log.backtrace_level", "ERRNO", EnumLevel, ConfigCheck::Level(), "触发输出被过滤日志的等级")   \
+    X(VMODULE, "log.vmodule", "", String, ConfigCheck::VModule(), "按源文件设置等级 例如 net/*=DEBUG,db/pool.cpp=WARNING") \
+    X(SCRATCH_SIZE, "log.scratch_size", "4096", SizeT, ConfigCheck::Range(0), "线程本地缓冲区大小(字节),不超过时记录日志不分配内存") \
+    X(RECORD_POOL_SIZE, "log.record_pool_size", "256", SizeT, ConfigCheck::Range(0), "日志记录池最多预分配的记录数") \
+    X(BUFFER_PAGES, "log.buffer_pages", "NORMAL", EnumPages, ConfigCheck::OneOf("NORMAL|THP|HUGETLB"), "异步缓冲区使用的内存页 NORMAL/THP/HUGETLB") \
+    X(BUFFER_MLOCK, "log.buffer_mlock", "0", SizeT, ConfigCheck::Range(0, 1), "锁定异步缓冲区内存,不被换出(1为开启)") \
+    X(TOTAL_BUFFER_BUDGET, "log.total_buffer_budget", "0", SizeT, ConfigCheck::Range(0), "所有异步缓冲区合计可使用的内存(字节,0为不限制)") \
+    X(METRICS_TARGET, "log.metrics_target", "", String, ConfigCheck::NonEmpty(), "统计导出目标:文件路径或unix:套接字路径(为空不导出)") \
+    X(METRICS_INTERVAL, "log.metrics_interval", "10", SizeT, ConfigCheck::Range(1), "统计导出周期(秒)") \
+    X(LATENCY_SAMPLE, "log.latency_sample", "0", SizeT, ConfigCheck::Range(0), "每N条日志采样一条统计延迟(0为不统计)") \
+    X(PROFILE_TRACE, "log.profile_trace", "", String, ConfigCheck::NonEmpty(), "定义LOG_PROFILE编译时,Chrome trace事件的输出文件(为空不记录)") \
+    X(PROFILE_TRACE_EVENTS, "log.profile_trace_events", "100000", SizeT, ConfigCheck::Range(0), "Chrome trace最多记录的事件数") \
+    X(RELOAD_INTERVAL, "log.reload_interval", "0", SizeT, ConfigCheck::Range(0), "检查配置文件变化的间隔(秒,0为不热加载),Linux上用inotify立即生效")
 
 // 声明配置项的宏：展开为枚举值
 #define DECLARE_CONFIG_ENUM(Name, Key, DefaultValue, Type, Validator, Description) Name,
@@ -56,48 +83,258 @@
 #define GENERATE_GETTER_BY_TYPE(Name, Key, DefaultValue, Type, Validator, Description) \
     _GENERATE_GETTER_FOR_##Type(Name)
 
-#define _GENERATE_GETTER_FOR_String(Name)                            \
-    const char *get##Name()                                          \
-    {                                                                \
-        static std::string value = getConfigString(ConfigKey::Name); \
-        return value.c_str();                                        \
+// 返回的指针指向配置快照,快照在进程内一直保留,热加载后旧指针仍然有效
+#define _GENERATE_GETTER_FOR_String(Name)  \
+    const char *get##Name() const          \
+    {                                      \
+        return snapshot().Name.c_str();    \
     }
 
-#define _GENERATE_GETTER_FOR_SizeT(Name)        \
-    size_t get##Name() const                    \
-    {                                           \
-        return getConfigSizeT(ConfigKey::Name); \
+#define _GENERATE_GETTER_FOR_SizeT(Name) \
+    size_t get##Name() const             \
+    {                                    \
+        return snapshot().Name;          \
     }
 
-#define _GENERATE_GETTER_FOR_Char(Name)        \
-    char get##Name() const                     \
-    {                                          \
-        return getConfigChar(ConfigKey::Name); \
+#define _GENERATE_GETTER_FOR_Char(Name) \
+    char get##Name() const              \
+    {                                   \
+        return snapshot().Name;         \
     }
 
-#define _GENERATE_GETTER_FOR_Bool(Name)                        \
-    bool get##Name() const                                     \
-    {                                                          \
-        const auto &item = getConfigItem(ConfigKey::Name);     \
-        return getBool(item.key, item.defaultValue == "true"); \
+#define _GENERATE_GETTER_FOR_Bool(Name) \
+    bool get##Name() const              \
+    {                                   \
+        return snapshot().Name;         \
     }
 
+// 枚举配置项返回快照中已经转换好的值
+#define _GENERATE_ENUM_GETTER(Type, Name)     \
+    _CONFIG_FIELD_TYPE_##Type get##Name() const \
+    {                                         \
+        return snapshot().Name;               \
+    }
+#define _GENERATE_GETTER_FOR_EnumLoggerType(Name) _GENERATE_ENUM_GETTER(EnumLoggerType, Name)
+#define _GENERATE_GETTER_FOR_EnumAnsyCtrl(Name) _GENERATE_ENUM_GETTER(EnumAnsyCtrl, Name)
+#define _GENERATE_GETTER_FOR_EnumRoll(Name) _GENERATE_ENUM_GETTER(EnumRoll, Name)
+#define _GENERATE_GETTER_FOR_EnumCompress(Name) _GENERATE_ENUM_GETTER(EnumCompress, Name)
+#define _GENERATE_GETTER_FOR_EnumOverflow(Name) _GENERATE_ENUM_GETTER(EnumOverflow, Name)
+#define _GENERATE_GETTER_FOR_EnumPages(Name) _GENERATE_ENUM_GETTER(EnumPages, Name)
+#define _GENERATE_GETTER_FOR_EnumLevel(Name) _GENERATE_ENUM_GETTER(EnumLevel, Name)
+
+// 快照中的类型化字段:字段名与配置项名称相同
+#define _CONFIG_FIELD_TYPE_String std::string
+#define _CONFIG_FIELD_TYPE_SizeT size_t
+#define _CONFIG_FIELD_TYPE_Char char
+#define _CONFIG_FIELD_TYPE_Bool bool
+#define _CONFIG_FIELD_TYPE_EnumLoggerType ConfigEnums::LogGerType
+#define _CONFIG_FIELD_TYPE_EnumAnsyCtrl ConfigEnums::AnsyCtrlType
+#define _CONFIG_FIELD_TYPE_EnumRoll ConfigEnums::RollInterval
+#define _CONFIG_FIELD_TYPE_EnumCompress ConfigEnums::CompressType
+#define _CONFIG_FIELD_TYPE_EnumOverflow ConfigEnums::OverflowPolicy
+#define _CONFIG_FIELD_TYPE_EnumPages ConfigEnums::BufferPages
+#define _CONFIG_FIELD_TYPE_EnumLevel LogLevel::VALUE
+#define DECLARE_CONFIG_FIELD(Name, Key, DefaultValue, Type, Validator, Description) \
+    _CONFIG_FIELD_TYPE_##Type Name;
+#define CONVERT_CONFIG_FIELD(Name, Key, DefaultValue, Type, Validator, Description) \
+    Convert(value(*snap, ConfigKey::Name), snap->Name);
+
 // 为配置项生成GETTER的宏定义
 #define GENERATE_GETTERS() \
     CONFIG_ITEMS(GENERATE_GETTER_BY_TYPE)
 
 /*
     管理Data中常用数据的类
+    配置以不可变快照的形式发布:加载时逐项校验,并把所有配置项转换为快照中的类型化字段,
+    读取时只加载一次当前快照的指针,不加锁、不查找、不转换
+    校验失败的配置项输出提示并使用默认值
+    reload()重新读取配置文件,内容变化时发布新快照并增加版本号,旧快照保留到进程退出
 */
 namespace Log
 {
-    // 配置项类型枚举
+    using ConfigValidator = std::function<bool(const std::string &)>;
+
+    // 配置项的校验器
+    struct ConfigCheck
+    {
+        // 十进制无符号整数,取值在[min,max]之间
+        static ConfigValidator Range(size_t min, size_t max = SIZE_MAX)
+        {
+            return [min, max](const std::string &value)
+            {
+                if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+                    return false;
+                errno = 0;
+                unsigned long long v = strtoull(value.c_str(), nullptr, 10);
+                return errno == 0 && v >= min && v <= max;
+            };
+        }
+        static ConfigValidator NonEmpty()
+        {
+            return [](const std::string &value)
+            { return !value.empty(); };
+        }
+        // 单个字符,不能是路径分隔符
+        static ConfigValidator Symbol()
+        {
+            return [](const std::string &value)
+            { return value.size() == 1 && value[0] != '/' && value[0] != '\\'; };
+        }
+        // choices为用|分隔的可选值
+        static ConfigValidator OneOf(const std::string &choices)
+        {
+            return [choices](const std::string &value)
+            {
+                return !value.empty() && value.find('|') == std::string::npos &&
+                       ("|" + choices + "|").find("|" + value + "|") != std::string::npos;
+            };
+        }
+        static ConfigValidator Level()
+        {
+            return [](const std::string &value)
+            { return LogLevel::StoLevel(value) != LogLevel::UNKNOW; };
+        }
+        // 逗号分隔的 通配符=等级,与VModule::set()的格式相同
+        static ConfigValidator VModule()
+        {
+            return [](const std::string &value)
+            {
+                size_t pos = 0;
+                while (pos <= value.size())
+                {
+                    size_t end = value.find(',', pos);
+                    if (end == std::string::npos)
+                        end = value.size();
+                    std::string item = value.substr(pos, end - pos);
+                    pos = end + 1;
+                    if (item.find_first_not_of(" \t") == std::string::npos)
+                        continue;
+                    size_t eq = item.rfind('=');
+                    if (eq == std::string::npos || item.find_first_not_of(" \t") >= eq)
+                        return false;
+                    std::string lv = item.substr(eq + 1);
+                    lv.erase(0, lv.find_first_not_of(" \t"));
+                    lv.erase(lv.find_last_not_of(" \t") + 1);
+                    if (LogLevel::StoLevel(lv) == LogLevel::UNKNOW)
+                        return false;
+                }
+                return true;
+            };
+        }
+    };
+
+    // 枚举值的配置项对应的类型,Data继承这些定义(Data::DROP等)
+    // 快照加载时用下面的函数转换一次,读取时不再比较字符串
+    struct ConfigEnums
+    {
+        enum LogGerType
+        {
+            SYNCLOGGER,
+            ASYNLOGGER
+        };
+
+        enum AnsyCtrlType
+        {
+            COMMON,
+            THPOOL
+        };
+
+        // 滚动文件的时间周期,值为周期秒数
+        enum RollInterval
+        {
+            NONE = 0,
+            HOURLY = 3600,
+            DAILY = 86400
+        };
+
+        // 滚动后对旧文件的压缩方式,未编译zlib时GZIP退化为FAST
+        enum CompressType
+        {
+            NOCOMPRESS,
+            GZIP,
+            FAST
+        };
+
+        // 异步缓冲区写满时的处理方式:阻塞等待或丢弃本条日志
+        enum OverflowPolicy
+        {
+            BLOCK,
+            DROP
+        };
+
+        // 异步缓冲区的内存页:普通页/透明大页/显式大页(需要预留hugetlbfs页)
+        enum BufferPages
+        {
+            NORMALPAGE,
+            THP,
+            HUGETLB
+        };
+
+        static const LogGerType StoLogGerType(const std::string &s)
+        {
+            if (s == "SYNCLOGGER")
+                return SYNCLOGGER;
+            else
+                return ASYNLOGGER;
+        }
+
+        static const AnsyCtrlType StoAnsyCtrlType(const std::string &s)
+        {
+            if (s == "COMMON")
+                return COMMON;
+            else
+                return THPOOL;
+        }
+        static const RollInterval StoRollInterval(const std::string &s)
+        {
+            if (s == "HOURLY")
+                return HOURLY;
+            else if (s == "DAILY")
+                return DAILY;
+            else
+                return NONE;
+        }
+        static const CompressType StoCompressType(const std::string &s)
+        {
+            if (s == "GZIP")
+                return GZIP;
+            else if (s == "FAST")
+                return FAST;
+            else
+                return NOCOMPRESS;
+        }
+        static const OverflowPolicy StoOverflowPolicy(const std::string &s)
+        {
+            if (s == "DROP")
+                return DROP;
+            else
+                return BLOCK;
+        }
+        static const BufferPages StoBufferPages(const std::string &s)
+        {
+            if (s == "THP")
+                return THP;
+            else if (s == "HUGETLB")
+                return HUGETLB;
+            else
+                return NORMALPAGE;
+        }
+    };
+
+    // 配置项类型枚举,Enum开头的为转换成枚举的字符串配置项
     enum ConfigType
     {
         String,
         SizeT,
         Char,
-        Bool
+        Bool,
+        EnumLoggerType,
+        EnumAnsyCtrl,
+        EnumRoll,
+        EnumCompress,
+        EnumOverflow,
+        EnumPages,
+        EnumLevel
     };
 
     // 泛型模板：类型到配置类型的映射
@@ -160,7 +397,7 @@ namespace Log
     {
     public:
         // 配置项验证器类型
-        using Validator = std::function<bool(const std::string &)>;
+        using Validator = ConfigValidator;
 
         // 配置项结构体
         struct ConfigItem
@@ -172,13 +409,28 @@ namespace Log
             std::string description;
         };
 
+        // 一次加载的配置内容,发布后不再修改
+        // 每个配置项对应一个同名的类型化字段,例如 snapshot().MAX_BUFFER_SIZE,
+        // 枚举值的配置项为对应的枚举,例如 snapshot().OVERFLOW_POLICY == ConfigEnums::DROP
+        struct Snapshot
+        {
+            CONFIG_ITEMS(DECLARE_CONFIG_FIELD)
+            // 文件中的原始键值对,校验失败的配置项已被移除
+            std::unordered_map<std::string, std::string> values;
+            // 校验失败而使用默认值的配置项
+            std::vector<std::string> invalid;
+            size_t version;
+        };
+
         // 配置项键枚举 - 使用X-Macro自动生成
         BEGIN_CONFIG_DECLARATION()
 
     private:
-        std::unordered_map<std::string, std::string> _configMap;
+        // 发布过的所有快照,其他线程可能仍在读取旧快照;只有内容变化时才发布,个数等于配置的修改次数
+        std::vector<std::unique_ptr<Snapshot>> _snapshots;
+        std::string _filename;
         std::mutex _mutex;
-        bool _loaded = false;
+        std::atomic<bool> _loaded{false};
 
         static constexpr const char *PropertiesName = "../config/.properties";
 
@@ -198,58 +450,80 @@ namespace Log
         }
         bool loadConfig(const std::string &filename)
         {
+            std::unique_lock<std::mutex> lock(_mutex);
             if (_loaded)
                 return true;
+            _filename = filename;
+            _loaded = true;
 
-            std::ifstream file(filename);
-            if (!file.is_open())
+            std::unique_ptr<Snapshot> snap(new Snapshot);
+            if (!Parse(filename, snap->values))
             {
-                {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    setDefaultConfig();
-                    writeDefaultConfig();
-                }
-
-                _loaded = true;
+                setDefaultConfig(snap->values);
+                Publish(Build(std::move(snap)));
+                writeDefaultConfig();
                 return false;
             }
+            Publish(Build(std::move(snap)));
+            return true;
+        }
 
-            std::string line;
-            while (std::getline(file, line))
-            {
-                if (line.empty() || line[0] == '#')
-                    continue;
+        // 重新读取配置文件,内容有变化时发布新快照
+        // 文件无法打开时保留当前配置并返回false
+        bool reload()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::unique_ptr<Snapshot> snap(new Snapshot);
+            if (!Parse(_filename.empty() ? PropertiesName : _filename, snap->values))
+                return false;
+            snap = Build(std::move(snap));
+            if (snap->values != snapshot().values)
+                Publish(std::move(snap));
+            return true;
+        }
 
-                size_t pos = line.find('=');
-                if (pos != std::string::npos)
-                {
-                    std::string key = trim(line.substr(0, pos));
-                    std::string value = trim(line.substr(pos + 1));
+        // 已经发布的当前快照,没有加载过配置时为空
+        // 常量初始化的静态变量,读取时只有一次指针加载,没有线程安全初始化的检查
+        static const Snapshot *current() { return Current().load(std::memory_order_acquire); }
+        // 当前快照,没有加载过配置时为全部默认值;调用者可以一直持有该引用
+        const Snapshot &snapshot() const
+        {
+            const Snapshot *snap = current();
+            return snap ? *snap : Defaults();
+        }
+        // 每发布一次快照加1,没有加载过配置时为0
+        size_t version() const { return snapshot().version; }
+        // 配置文件路径,没有加载过时为默认路径
+        std::string filename()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _filename.empty() ? PropertiesName : _filename;
+        }
 
-                    if (!key.empty() && !value.empty())
-                    {
-                        _configMap[key] = value;
-                    }
-                }
-            }
+        static const ConfigItem &configItem(ConfigKey key) { return configItems()[key]; }
 
-            file.close();
-            _loaded = true;
-            return true;
+        // 在指定快照中读取配置项,没有设置时返回默认值
+        static const std::string &value(const Snapshot &snap, ConfigKey key)
+        {
+            const ConfigItem &item = configItems()[key];
+            auto it = snap.values.find(item.key);
+            return it != snap.values.end() ? it->second : item.defaultValue;
         }
 
         std::string getString(const std::string &key, const std::string &defaultValue = "") const
         {
-            auto it = _configMap.find(key);
-            if (it != _configMap.end())
+            const auto &values = snapshot().values;
+            auto it = values.find(key);
+            if (it != values.end())
                 return it->second;
             return defaultValue;
         }
 
         size_t getSizeT(const std::string &key, size_t defaultValue = 0) const
         {
-            auto it = _configMap.find(key);
-            if (it != _configMap.end())
+            const auto &values = snapshot().values;
+            auto it = values.find(key);
+            if (it != values.end())
             {
                 try
                 {
@@ -265,8 +539,9 @@ namespace Log
 
         char getChar(const std::string &key, char defaultValue = '\0') const
         {
-            auto it = _configMap.find(key);
-            if (it != _configMap.end() && !it->second.empty())
+            const auto &values = snapshot().values;
+            auto it = values.find(key);
+            if (it != values.end() && !it->second.empty())
             {
                 return it->second[0];
             }
@@ -275,8 +550,9 @@ namespace Log
 
         bool getBool(const std::string &key, bool defaultValue = false) const
         {
-            auto it = _configMap.find(key);
-            if (it != _configMap.end())
+            const auto &values = snapshot().values;
+            auto it = values.find(key);
+            if (it != values.end())
             {
                 const std::string &value = it->second;
                 return value == "true" || value == "1" || value == "TRUE" || value == "YES" || value == "yes";
@@ -290,37 +566,94 @@ namespace Log
         bool isLoaded() const { return _loaded; }
 
     private:
-        void setDefaultConfig()
+        static std::atomic<const Snapshot *> &Current()
         {
-            // 使用集中管理的配置项设置默认值
+            static std::atomic<const Snapshot *> current(nullptr);
+            return current;
+        }
+        static const Snapshot &Defaults()
+        {
+            static const Snapshot *defaults = Build(std::unique_ptr<Snapshot>(new Snapshot)).release();
+            return *defaults;
+        }
+
+        // 校验原始键值对并转换出所有类型化字段
+        static std::unique_ptr<Snapshot> Build(std::unique_ptr<Snapshot> snap)
+        {
+            snap->version = 0;
             for (const auto &item : configItems())
             {
-                _configMap[item.key] = item.defaultValue;
+                auto it = snap->values.find(item.key);
+                // 默认值总是有效的,例如为空表示关闭的配置项
+                if (it == snap->values.end() || it->second == item.defaultValue ||
+                    !item.validator || item.validator(it->second))
+                    continue;
+                std::cout << "配置项 " << item.key << "=" << it->second << " 无效,使用默认值 "
+                          << item.defaultValue << std::endl;
+                snap->invalid.push_back(item.key);
+                snap->values.erase(it);
             }
+            CONFIG_ITEMS(CONVERT_CONFIG_FIELD)
+            return snap;
         }
-
-        // 类型安全访问方法
-        const ConfigItem &getConfigItem(ConfigKey key) const
+        static void Convert(const std::string &value, std::string &field) { field = value; }
+        static void Convert(const std::string &value, size_t &field)
         {
-            return configItems()[key];
+            field = static_cast<size_t>(strtoull(value.c_str(), nullptr, 10));
         }
-
-        std::string getConfigString(ConfigKey key) const
+        static void Convert(const std::string &value, char &field) { field = value.empty() ? '\0' : value[0]; }
+        static void Convert(const std::string &value, bool &field) { field = StringConverter<bool>::from(value); }
+        static void Convert(const std::string &value, ConfigEnums::LogGerType &field) { field = ConfigEnums::StoLogGerType(value); }
+        static void Convert(const std::string &value, ConfigEnums::AnsyCtrlType &field) { field = ConfigEnums::StoAnsyCtrlType(value); }
+        static void Convert(const std::string &value, ConfigEnums::RollInterval &field) { field = ConfigEnums::StoRollInterval(value); }
+        static void Convert(const std::string &value, ConfigEnums::CompressType &field) { field = ConfigEnums::StoCompressType(value); }
+        static void Convert(const std::string &value, ConfigEnums::OverflowPolicy &field) { field = ConfigEnums::StoOverflowPolicy(value); }
+        static void Convert(const std::string &value, ConfigEnums::BufferPages &field) { field = ConfigEnums::StoBufferPages(value); }
+        static void Convert(const std::string &value, LogLevel::VALUE &field) { field = LogLevel::StoLevel(value); }
+
+        void setDefaultConfig(std::unordered_map<std::string, std::string> &values)
         {
-            const auto &item = getConfigItem(key);
-            return getString(item.key, item.defaultValue);
+            // 使用集中管理的配置项设置默认值
+            for (const auto &item : configItems())
+            {
+                values[item.key] = item.defaultValue;
+            }
         }
 
-        size_t getConfigSizeT(ConfigKey key) const
+        // 读取配置文件中的键值对,文件无法打开时返回false
+        bool Parse(const std::string &filename, std::unordered_map<std::string, std::string> &values) const
         {
-            const auto &item = getConfigItem(key);
-            return getSizeT(item.key, std::stoull(item.defaultValue));
+            std::ifstream file(filename);
+            if (!file.is_open())
+                return false;
+
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (line.empty() || line[0] == '#')
+                    continue;
+
+                size_t pos = line.find('=');
+                if (pos != std::string::npos)
+                {
+                    std::string key = trim(line.substr(0, pos));
+                    std::string value = trim(line.substr(pos + 1));
+
+                    if (!key.empty() && !value.empty())
+                    {
+                        values[key] = value;
+                    }
+                }
+            }
+            return true;
         }
 
-        char getConfigChar(ConfigKey key) const
+        // 发布Build()生成的快照,需要持有_mutex;快照保留到进程退出
+        void Publish(std::unique_ptr<Snapshot> snap)
         {
-            const auto &item = getConfigItem(key);
-            return getChar(item.key, item.defaultValue[0]);
+            snap->version = _snapshots.size() + 1;
+            _snapshots.push_back(std::move(snap));
+            Current().store(_snapshots.back().get(), std::memory_order_release);
         }
 
         bool openfile(const std::string &filename, std::ofstream &file)
@@ -361,7 +694,7 @@ namespace Log
 
                 // 输出配置项的描述和默认值
                 file << "# " << item.description << "\n";
-                file << item.key << "=" << getInstance()._configMap[item.key] << "\n\n";
+                file << item.key << "=" << item.defaultValue << "\n\n";
             }
 
             return true;
@@ -1,44 +1,106 @@
 #pragma once
 #include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
+#include "field.hpp"
+#include "scratch.hpp"
 
 class ParseFormat {
 public:
   ParseFormat() = default;
   ~ParseFormat() = default;
 
+  // 结构化字段(Log::Field)不参与{}占位符替换
   template <class... Args> std::string parse(std::string format, Args... args) {
-    std::vector<std::string> args_str = {toString(args)...};
-    size_t arg_index = 0;
-    size_t pos = 0;
+    std::string out;
+    Format(out, format, args...);
+    return out;
+  }
+
+  // 将替换结果追加到out,参数直接写入out,不产生临时字符串
+  // 多余的参数被忽略,没有匹配参数的占位符原样保留
+  template <class... Args>
+  static void Format(std::string &out, Log::StrView format,
+                     const Args &...args) {
+    const char *p = format.data, *end = format.data + format.size;
+    Append(out, p, end, args...);
+    out.append(p, end - p);
+  }
 
-    // 替换花括号占位符
-    while ((pos = format.find("{}", pos)) != std::string::npos) {
-      if (arg_index < args_str.size()) {
-        // 有匹配的参数，进行替换
-        format.replace(pos, 2, args_str[arg_index]);
-        pos += args_str[arg_index].length();
-        arg_index++;
-      } else {
-        // 没有匹配的参数，跳过当前占位符
-        pos += 2;
-      }
+private:
+  static const char *FindHole(const char *p, const char *end) {
+    for (; p + 1 < end; ++p) {
+      if (p[0] == '{' && p[1] == '}')
+        return p;
     }
+    return nullptr;
+  }
 
-    return format;
+  static void Append(std::string &, const char *&, const char *) {}
+  template <class... Rest>
+  static void Append(std::string &out, const char *&p, const char *end,
+                     const Log::Field &, const Rest &...rest) {
+    Append(out, p, end, rest...);
+  }
+  template <class T, class... Rest>
+  static void Append(std::string &out, const char *&p, const char *end,
+                     const T &value, const Rest &...rest) {
+    const char *hole = FindHole(p, end);
+    if (!hole)
+      return;
+    out.append(p, hole - p);
+    Write(out, value);
+    p = hole + 2;
+    Append(out, p, end, rest...);
   }
 
-private:
-  template <class T> std::string toString(T value) {
-    std::stringstream ss;
-    ss << value;
-    return ss.str();
+  // 与 ostream << value 的输出一致
+  static void Write(std::string &out, const std::string &v) { out += v; }
+  static void Write(std::string &out, const char *v) {
+    if (v)
+      out += v;
+  }
+  static void Write(std::string &out, char v) { out += v; }
+  static void Write(std::string &out, bool v) { out += v ? '1' : '0'; }
+  static void Write(std::string &out, int v) { WriteInt(out, v); }
+  static void Write(std::string &out, long v) { WriteInt(out, v); }
+  static void Write(std::string &out, long long v) { WriteInt(out, v); }
+  static void Write(std::string &out, short v) { WriteInt(out, v); }
+  static void Write(std::string &out, unsigned v) { WriteInt(out, v); }
+  static void Write(std::string &out, unsigned long v) { WriteInt(out, v); }
+  static void Write(std::string &out, unsigned long long v) {
+    WriteInt(out, v);
+  }
+  static void Write(std::string &out, unsigned short v) { WriteInt(out, v); }
+  static void Write(std::string &out, double v) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%g", v);
+    out.append(buf, n);
+  }
+  static void Write(std::string &out, float v) { Write(out, double(v)); }
+  // 其他类型通过线程本地的ostream输出
+  template <class T>
+  static typename std::enable_if<!std::is_convertible<T, const char *>::value>::type
+  Write(std::string &out, const T &v) {
+    Log::ScratchStream ss(out);
+    ss.get() << v;
   }
 
-private:
-  std::string _formatted;
+  template <class T> static void WriteInt(std::string &out, T v) {
+    char buf[24];
+    char *e = buf + sizeof(buf), *b = e;
+    typedef typename std::make_unsigned<T>::type U;
+    U u = v < 0 ? U(0) - U(v) : U(v);
+    do {
+      *--b = char('0' + u % 10);
+      u /= 10;
+    } while (u);
+    if (v < 0)
+      *--b = '-';
+    out.append(b, e - b);
+  }
 };
-
@@ -1,11 +1,14 @@
 #pragma once
 #include "buffer.hpp"
 #include "threadpool.hpp"
+#include "counter.hpp"
+#include "histogram.hpp"
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include <chrono>
 
 /*
     异步线程控制器
@@ -22,22 +25,65 @@ namespace Log
         {
 
         public:
-            typedef std::function<void(const std::string &Buffer)> CallbackF;
+            typedef std::function<void(const char *data, size_t len)> CallbackF;
             typedef std::shared_ptr<AnsyCtrl> ptr;
-            AnsyCtrl()
-                : _stop(false)
+            // bufsize: 每个缓冲区的大小
+            explicit AnsyCtrl(size_t bufsize = Data::max_buffer_size())
+                : _stop(false), _overflow(Data::overflowPolicy()), _dropped(0), _accepted(0), _bufbytes(0),
+                  _por_buf(bufsize, Data::bufferPages(), Data::bufferMlock(), &_bufbytes),
+                  _con_buf(bufsize, Data::bufferPages(), Data::bufferMlock(), &_bufbytes)
             {
             }
             virtual void bindcallbackf(const CallbackF &) = 0;
             virtual void stop() = 0;
             virtual void push(const std::string &str) = 0;
+            // stamp不为0时是被采样日志的写入时间,写入落地方向后计入延迟直方图
+            // 自定义的控制器不重写时不统计延迟
+            virtual void push(const std::string &str, uint64_t stamp)
+            {
+                (void)stamp;
+                push(str);
+            }
             virtual ~AnsyCtrl() {};
 
+            // 缓冲区写满时的处理方式
+            void setOverflow(Data::OverflowPolicy policy) { _overflow = policy; }
+            Data::OverflowPolicy overflow() const { return _overflow; }
+            // 因缓冲区写满而丢弃的日志条数
+            size_t dropped() const { return _dropped; }
+            // 成功写入缓冲区的字节数
+            size_t accepted() const { return _accepted; }
+            // 交换缓冲区(交给后台写入)的次数
+            uint64_t swaps() const { return _swaps; }
+            // 生产者等待缓冲区空间的累计耗时
+            uint64_t waitNs() const { return _wait_ns; }
+            // 两个缓冲区当前从全局预算借用的字节数
+            size_t bufferBytes() const { return _bufbytes; }
+            // 被采样日志从写入缓冲区到写入落地方向完成的延迟
+            const Histogram &latency() const { return _latency; }
+
         protected:
             virtual void HandleBuffer() = 0;
 
+            // 缓冲区内容写入落地方向后调用
+            void RecordLatency(const Buffer &buf)
+            {
+                if (!buf.stampCount())
+                    return;
+                uint64_t now = Histogram::Now();
+                for (size_t i = 0; i < buf.stampCount(); ++i)
+                    _latency.record(now > buf.stamps()[i] ? now - buf.stamps()[i] : 0);
+            }
+
         protected:
             std::atomic<bool> _stop;
+            std::atomic<Data::OverflowPolicy> _overflow;
+            Counter _dropped;
+            Counter _accepted;
+            Counter _swaps;
+            Counter _wait_ns;
+            std::atomic<size_t> _bufbytes;
+            Histogram _latency;
             CallbackF _callbackf;
             Buffer _por_buf;
             Buffer _con_buf;
@@ -47,8 +93,8 @@ namespace Log
         {
 
         public:
-            AnsyCtrlCommon()
-                : _th(std::bind(&AnsyCtrlCommon::HandleBuffer, this))
+            explicit AnsyCtrlCommon(size_t bufsize = Data::max_buffer_size())
+                : AnsyCtrl(bufsize), _th(std::bind(&AnsyCtrlCommon::HandleBuffer, this))
             {
             }
             ~AnsyCtrlCommon() { stop(); }
@@ -62,12 +108,37 @@ namespace Log
                 if (_th.joinable())
                     _th.join();
             }
-            void push(const std::string &str) override
+            void push(const std::string &str) override { push(str, 0); }
+            void push(const std::string &str, uint64_t stamp) override
             {
                 std::unique_lock<std::mutex> lock(_mutex);
-                _por.wait(lock, [&]()
-                          { return !_stop && str.size() <= _por_buf.WriteBSize(); });
+                // 比整个缓冲区还大的日志永远放不下,阻塞策略下也只能丢弃
+                // 缓冲区写满或全局预算用完时按溢出策略处理
+                if (str.size() > _por_buf.maxsize() ||
+                    (_overflow == Data::DROP && !_por_buf.fits(str.size())))
+                {
+                    ++_dropped;
+                    return;
+                }
+                // 空缓冲区仍借不到预算时不再等待(只有其他日志器归还预算才能继续)
+                if (!_por_buf.fits(str.size()))
+                {
+                    auto begin = std::chrono::steady_clock::now();
+                    _por.wait(lock, [&]()
+                              { return !_stop && (_por_buf.fits(str.size()) || _por_buf.empty()); });
+                    _wait_ns.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - begin)
+                                     .count());
+                }
+                if (!_por_buf.fits(str.size()))
+                {
+                    ++_dropped;
+                    return;
+                }
                 _por_buf.push(str);
+                if (stamp)
+                    _por_buf.stamp(stamp);
+                _accepted += str.size();
                 _con.notify_all();
             }
             void bindcallbackf(const CallbackF &cf)
@@ -86,24 +157,32 @@ namespace Log
                                   { return !_por_buf.empty() || _stop; });
                         if (_stop && _por_buf.empty())
                             break;
-                        _con_buf.clear();
                         _por_buf.swap(_con_buf);
+                        _swaps.add();
                         _por.notify_all();
                     }
-                    _callbackf(_con_buf.ReadBuffer());
+                    _callbackf(_con_buf.data(), _con_buf.size());
+                    RecordLatency(_con_buf);
+                    // 交换回来之前只有消费线程使用,在锁外清空和归还内存
+                    _con_buf.clear();
                 }
             }
 
         private:
-            std::thread _th;
             std::condition_variable _por;
             std::condition_variable _con;
+            // 线程在构造时启动并使用上面的条件变量,必须最后声明
+            std::thread _th;
         };
 
+        // 写满时交给全局线程池写出;同一时刻每个控制器只有一个线程在写出(_drain),
+        // 落地方向不会被并发调用,正在写出的缓冲区也不会被交换或清空
+        // BLOCK策略下放不下时由记录日志的线程自己写出,不依赖线程池中的空闲线程
         class AnsyCtrlThpool : public AnsyCtrl, public std::enable_shared_from_this<AnsyCtrlThpool>
         {
         public:
-            AnsyCtrlThpool()
+            explicit AnsyCtrlThpool(size_t bufsize = Data::max_buffer_size())
+                : AnsyCtrl(bufsize), _scheduled(false)
             {
             }
             ~AnsyCtrlThpool() override
@@ -120,32 +199,56 @@ namespace Log
                 }
 
                 // 处理剩余的缓冲区内容
-                if (!_por_buf.empty())
-                {
-                    // 使用局部变量保存回调函数和缓冲区内容
-                    HandleBuffer();
-                }
+                HandleBuffer();
             }
-            void push(const std::string &str) override
+            void push(const std::string &str) override { push(str, 0); }
+            void push(const std::string &str, uint64_t stamp) override
             {
                 std::unique_lock<std::mutex> lock(_mutex);
-                if (_stop || str.size() > _por_buf.WriteBSize())
+                if (_stop)
+                    return;
+                // 比整个缓冲区还大的日志永远放不下,阻塞策略下也只能丢弃
+                if (str.size() > _por_buf.maxsize())
+                {
+                    ++_dropped;
                     return;
+                }
+                // 全局预算用完时缓冲区在远未达到上限前就放不下,同样要写出,否则之后一直丢弃
+                if (!_por_buf.fits(str.size()))
+                {
+                    if (_overflow == Data::DROP)
+                    {
+                        ++_dropped;
+                        Schedule(lock);
+                        return;
+                    }
+                    auto begin = std::chrono::steady_clock::now();
+                    // 空缓冲区仍借不到预算时不再等待(只有其他日志器归还预算才能继续)
+                    while (!_stop && !_por_buf.fits(str.size()) && !_por_buf.empty())
+                    {
+                        lock.unlock();
+                        HandleBuffer();
+                        lock.lock();
+                    }
+                    _wait_ns.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - begin)
+                                     .count());
+                    if (_stop || !_por_buf.fits(str.size()))
+                    {
+                        ++_dropped;
+                        return;
+                    }
+                }
 
                 _por_buf.push(str);
+                if (stamp)
+                    _por_buf.stamp(stamp);
+                _accepted += str.size();
 
                 // 当缓冲区达到一定大小后，使用线程池处理
                 // 这里设置一个简单的阈值：当剩余空间小于1024字节时处理
                 if (_por_buf.WriteBSize() < 1024)
-                {
-                    // 创建一个共享指针副本，避免对象被销毁
-                    auto self = shared_from_this();
-                    lock.unlock();
-
-                    // 使用全局线程池处理缓冲区
-                    GlobalTPool::getInstance().enqueue([self]()
-                                                       { self->HandleBuffer(); });
-                }
+                    Schedule(lock);
             }
 
             void bindcallbackf(const CallbackF &cf)
@@ -154,24 +257,45 @@ namespace Log
             }
 
         private:
-            void HandleBuffer() override
+            // 把缓冲区交给全局线程池写出,调用时持有lock;已经安排过且还没开始写出时不再重复安排
+            void Schedule(std::unique_lock<std::mutex> &lock)
             {
+                if (_scheduled)
+                    return;
+                _scheduled = true;
+                // 创建一个共享指针副本，避免对象被销毁
+                auto self = shared_from_this();
+                lock.unlock();
 
-                // 保留这个方法是为了兼容基类接口
+                // 使用全局线程池处理缓冲区
+                GlobalTPool::getInstance().enqueue([self]()
+                                                   { self->HandleBuffer(); });
+            }
+
+            // 交换、写出和清空都在_drain下完成,_con_buf只在持有_drain时访问
+            void HandleBuffer() override
+            {
+                std::unique_lock<std::mutex> drain(_drain);
                 {
                     std::unique_lock<std::mutex> lock(_mutex);
+                    _scheduled = false;
                     if (_por_buf.empty())
                         return;
-                    _con_buf.clear();
                     _por_buf.swap(_con_buf);
+                    _swaps.add();
                 }
 
                 if (_callbackf)
                 {
-                    _callbackf(_con_buf.ReadBuffer());
+                    _callbackf(_con_buf.data(), _con_buf.size());
+                    RecordLatency(_con_buf);
                 }
-               
+                _con_buf.clear();
             }
+
+        private:
+            std::mutex _drain;
+            bool _scheduled; // 由_mutex保护
         };
 
     } // neamspace ACtrl
@@ -179,12 +303,38 @@ namespace Log
     class ACtrlFactory
     {
     public:
+        // 每个落地方向需要独立的线程控制器,通过Creator按需创建
+        typedef std::function<ACtrl::AnsyCtrl::ptr()> Creator;
+
         template <class AnsyWay, class... Args>
         static ACtrl::AnsyCtrl::ptr ACtrlWay(Args &&...args)
         {
             return std::make_shared<AnsyWay>(std::forward<Args>(args)...);
         }
 
+        // 保存构造参数,每次调用创建一个新的AnsyWay
+        template <class AnsyWay, class... Args>
+        static Creator ACtrlCreator(Args &&...args)
+        {
+            return std::bind([](auto &...a)
+                             { return ACtrl::AnsyCtrl::ptr(std::make_shared<AnsyWay>(a...)); },
+                             std::forward<Args>(args)...);
+        }
+
+        // bufsize为0时缓冲区大小使用log.max_buffer_size
+        static Creator CreatorOf(const Data::AnsyCtrlType &type, size_t bufsize = 0)
+        {
+            if (bufsize)
+            {
+                if (type == Data::THPOOL)
+                    return ACtrlCreator<ACtrl::AnsyCtrlThpool>(bufsize);
+                return ACtrlCreator<ACtrl::AnsyCtrlCommon>(bufsize);
+            }
+            if (type == Data::THPOOL)
+                return &ACtrlFactory::AnsyThpool;
+            return &ACtrlFactory::AnsyCommon;
+        }
+
         static ACtrl::AnsyCtrl::ptr AnsyCommon()
         {
             return std::make_shared<ACtrl::AnsyCtrlCommon>();
@@ -0,0 +1,83 @@
+#pragma once
+#include "binary.hpp"
+#include "level.hpp"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+/*
+    回溯缓冲模块
+    在内存中保留最近N条被等级过滤掉的日志,出现高等级日志或手动调用时再输出
+    日志以延迟形式保存:原始格式串 + 按类型打包的参数,不做{}替换也不写落地方向
+    槽位预先分配并循环复用,字符串容量保留下来,稳定后不再分配内存
+*/
+namespace Log
+{
+    // 一条延迟格式化的日志
+    struct Deferred
+    {
+        time_t time;
+        int line;
+        LogLevel::VALUE level;
+        std::thread::id tid;
+        std::string filename;
+        std::string format;
+        std::string packed;  // Binary::Pack打包的参数
+        MDC::Context context; // 记录时线程上下文的副本
+    };
+
+    class BacktraceRing
+    {
+    public:
+        typedef std::shared_ptr<BacktraceRing> ptr;
+
+        BacktraceRing(size_t capacity)
+            : _slots(capacity ? capacity : 1), _next(0), _size(0)
+        {
+        }
+
+        template <class... Args>
+        void push(int line, LogLevel::VALUE level, const char *filename,
+                  StrView format, const Args &...args)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            Deferred &d = _slots[_next];
+            d.time = tool::Date::GetTime();
+            d.line = line;
+            d.level = level;
+            d.tid = std::this_thread::get_id();
+            d.filename.assign(filename);
+            d.format.assign(format.data, format.size);
+            d.packed.clear();
+            Binary::Pack(d.packed, args...);
+            d.context.assign(MDC::Current());
+            _next = (_next + 1) % _slots.size();
+            if (_size < _slots.size())
+                ++_size;
+        }
+
+        // 按时间顺序交给f处理并清空,f在锁内执行
+        void drain(const std::function<void(const Deferred &)> &f)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            size_t first = (_next + _slots.size() - _size) % _slots.size();
+            for (size_t i = 0; i < _size; ++i)
+                f(_slots[(first + i) % _slots.size()]);
+            _size = 0;
+        }
+
+        size_t size()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _size;
+        }
+        size_t capacity() const { return _slots.size(); }
+
+    private:
+        std::mutex _mutex;
+        std::vector<Deferred> _slots;
+        size_t _next;
+        size_t _size;
+    };
+}
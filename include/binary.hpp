@@ -0,0 +1,687 @@
+#pragma once
+#include "message.hpp"
+#include "level.hpp"
+#include "logdata.hpp"
+#include "field.hpp"
+#include "scratch.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+/*
+    紧凑二进制日志格式
+    每个调用点(格式串、文件、行号、等级、日志器)只在字典记录中出现一次,
+    之后的日志记录只保存调用点id、时间差、线程号和打包后的参数
+    文件头:   "LBIN" + 版本号u32
+    会话记录: 'S' + 起始时间(微秒)u64    -- 每次打开文件时写入,之后的时间差以此为基准
+    字典记录: 'D' + id + 等级 + 日志器类型 + 行号 + 文件名 + 日志器名 + 格式串
+    日志记录: 'R' + id + 时间差(微秒) + 线程号 + 参数长度 + 参数
+    整数均为varint,字符串为varint长度 + 内容
+    字典记录由落地方向(BinaryFileSink)在本会话第一次写出引用它的日志记录时补上,
+    被丢弃或被过滤的日志不会让后面的记录缺少字典;格式化时只输出日志记录
+    解码时先收集本会话的全部字典,找不到字典的日志记录被跳过
+    参数: 'i' zigzag整数, 'u' 无符号整数, 'd' 8字节double, 'b' 布尔, 's' 字符串,
+          'k' + 键 + 值 表示kv结构化字段
+*/
+namespace Log
+{
+    namespace Binary
+    {
+        static constexpr const char *Magic = "LBIN";
+        static const uint32_t Version = 1;
+
+        inline void PutVar(std::string &out, uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                out += static_cast<char>((v & 0x7f) | 0x80);
+                v >>= 7;
+            }
+            out += static_cast<char>(v);
+        }
+        inline void PutStr(std::string &out, const char *s, size_t n)
+        {
+            PutVar(out, n);
+            out.append(s, n);
+        }
+        inline void PutStr(std::string &out, const std::string &s)
+        {
+            PutStr(out, s.data(), s.size());
+        }
+        inline void PutU64(std::string &out, uint64_t v)
+        {
+            for (int i = 0; i < 8; ++i)
+                out += static_cast<char>((v >> (8 * i)) & 0xff);
+        }
+        inline uint64_t ZigZag(int64_t v)
+        {
+            return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+        }
+        inline int64_t UnZigZag(uint64_t v)
+        {
+            return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+        }
+
+        // 顺序读取二进制数据,越界后ok()为false
+        class Reader
+        {
+        public:
+            Reader(const char *data, size_t size)
+                : _p(data), _end(data + size), _ok(true)
+            {
+            }
+            bool ok() const { return _ok; }
+            bool eof() const { return _p >= _end; }
+            size_t remain() const { return _end - _p; }
+            const char *pos() const { return _p; }
+
+            uint8_t byte()
+            {
+                if (_p >= _end)
+                    return _ok = false, 0;
+                return static_cast<uint8_t>(*_p++);
+            }
+            uint64_t var()
+            {
+                uint64_t v = 0;
+                for (int shift = 0; shift < 64; shift += 7)
+                {
+                    uint8_t b = byte();
+                    if (!_ok)
+                        return 0;
+                    v |= uint64_t(b & 0x7f) << shift;
+                    if (!(b & 0x80))
+                        return v;
+                }
+                _ok = false;
+                return 0;
+            }
+            uint64_t u64()
+            {
+                uint64_t v = 0;
+                for (int i = 0; i < 8; ++i)
+                    v |= uint64_t(byte()) << (8 * i);
+                return v;
+            }
+            std::string str()
+            {
+                uint64_t n = var();
+                if (!_ok || n > remain())
+                    return _ok = false, std::string();
+                std::string s(_p, n);
+                _p += n;
+                return s;
+            }
+            const char *skip(size_t n)
+            {
+                if (n > remain())
+                    return _ok = false, nullptr;
+                const char *p = _p;
+                _p += n;
+                return p;
+            }
+
+        private:
+            const char *_p;
+            const char *_end;
+            bool _ok;
+        };
+
+        // 进程内统一的时间基准,二进制记录保存相对它的微秒数
+        inline uint64_t EpochUs()
+        {
+            static const uint64_t epoch = std::chrono::duration_cast<std::chrono::microseconds>(
+                                              std::chrono::system_clock::now().time_since_epoch())
+                                              .count();
+            return epoch;
+        }
+        inline uint64_t NowUs()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        }
+        // 线程号,与文本格式%t输出的数字相同(无法转换为数字时使用哈希值)
+        inline uint64_t ThreadNum()
+        {
+            static thread_local uint64_t num = []()
+            {
+                std::ostringstream ss;
+                ss << std::this_thread::get_id();
+                std::string text = ss.str();
+                char *end = nullptr;
+                uint64_t v = strtoull(text.c_str(), &end, 10);
+                return end && *end == '\0' && v ? v : static_cast<uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            }();
+            return num;
+        }
+
+        // 参数打包,字符串以外的类型保持二进制形式
+        inline void PackOne(std::string &out, bool v)
+        {
+            out += 'b';
+            out += static_cast<char>(v);
+        }
+        inline void PackOne(std::string &out, const char *v)
+        {
+            out += 's';
+            PutStr(out, v ? v : "", v ? strlen(v) : 0);
+        }
+        inline void PackOne(std::string &out, const std::string &v)
+        {
+            out += 's';
+            PutStr(out, v);
+        }
+        // 字符类型与文本输出一致,按字符保存
+        inline void PackOne(std::string &out, char v)
+        {
+            out += 's';
+            PutStr(out, &v, 1);
+        }
+        inline void PackOne(std::string &out, signed char v)
+        {
+            PackOne(out, static_cast<char>(v));
+        }
+        inline void PackOne(std::string &out, unsigned char v)
+        {
+            PackOne(out, static_cast<char>(v));
+        }
+        template <class T>
+        typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+        PackOne(std::string &out, const T &v)
+        {
+            out += 'i';
+            PutVar(out, ZigZag(v));
+        }
+        template <class T>
+        typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+        PackOne(std::string &out, const T &v)
+        {
+            out += 'u';
+            PutVar(out, v);
+        }
+        template <class T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type
+        PackOne(std::string &out, const T &v)
+        {
+            double d = v;
+            uint64_t bits;
+            memcpy(&bits, &d, 8);
+            out += 'd';
+            PutU64(out, bits);
+        }
+        // 其他类型只能在调用线程转为文本
+        template <class T>
+        typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_convertible<T, const char *>::value &&
+                                !std::is_same<T, Field>::value>::type
+        PackOne(std::string &out, const T &v)
+        {
+            std::stringstream ss;
+            ss << v;
+            PackOne(out, ss.str());
+        }
+        inline void PackOne(std::string &out, const Field &f)
+        {
+            out += 'k';
+            PutStr(out, f.key, strlen(f.key));
+            switch (f.type)
+            {
+            case Field::INT: PackOne(out, f.i); break;
+            case Field::UINT: PackOne(out, f.u); break;
+            case Field::DOUBLE: PackOne(out, f.d); break;
+            case Field::BOOL: PackOne(out, f.b); break;
+            case Field::STRING:
+                out += 's';
+                PutStr(out, f.str.ptr, f.str.len);
+                break;
+            case Field::OTHER:
+            {
+                std::stringstream ss;
+                f.write(ss);
+                PackOne(out, ss.str());
+                break;
+            }
+            }
+        }
+
+        inline void Pack(std::string &)
+        {
+        }
+        template <class T, class... Rest>
+        void Pack(std::string &out, const T &v, const Rest &...rest)
+        {
+            PackOne(out, v);
+            Pack(out, rest...);
+        }
+
+        // 读取一个打包的值并按文本输出,与ParseFormat的输出一致
+        // kv字段的布尔值与文本/JSON格式一致输出true/false
+        inline bool RenderOne(Reader &r, std::ostream &out, bool kv = false)
+        {
+            switch (r.byte())
+            {
+            case 'i': out << UnZigZag(r.var()); break;
+            case 'u': out << r.var(); break;
+            case 'b':
+                if (kv)
+                    out << (r.byte() ? "true" : "false");
+                else
+                    out << (r.byte() ? 1 : 0);
+                break;
+            case 'd':
+            {
+                uint64_t bits = r.u64();
+                double d;
+                memcpy(&d, &bits, 8);
+                out << d;
+                break;
+            }
+            case 's':
+            {
+                uint64_t n = r.var();
+                const char *p = r.skip(n);
+                if (p)
+                    out.write(p, n);
+                break;
+            }
+            default: return false;
+            }
+            return r.ok();
+        }
+
+        // 用打包的参数还原日志内容:按顺序替换{},withfields时kv字段以 key=value 跟在内容之后
+        inline bool Render(const std::string &format, const char *args, size_t size, std::string &content,
+                           bool withfields = true)
+        {
+            std::stringstream body, fields;
+            Reader r(args, size);
+            size_t pos = 0;
+            while (!r.eof())
+            {
+                if (static_cast<uint8_t>(*r.pos()) == 'k')
+                {
+                    r.byte();
+                    std::string key = r.str();
+                    std::stringstream skip;
+                    std::ostream &out = withfields ? fields : skip;
+                    out << ' ' << key << '=';
+                    if (!RenderOne(r, out, true))
+                        return false;
+                    continue;
+                }
+                size_t hole = format.find("{}", pos);
+                std::stringstream skip;
+                std::ostream &out = hole == std::string::npos ? skip : body;
+                if (hole != std::string::npos)
+                {
+                    body.write(format.data() + pos, hole - pos);
+                    pos = hole + 2;
+                }
+                if (!RenderOne(r, out))
+                    return false;
+            }
+            body.write(format.data() + pos, format.size() - pos);
+            content = body.str() + fields.str();
+            return true;
+        }
+
+        // 从打包的参数中还原kv字段,字符串值引用args,键复制到keys(以'\0'结尾)
+        // fields和keys的容量保留复用;args损坏时返回false
+        inline bool Fields(const char *args, size_t size, std::vector<Field> &fields, std::string &keys)
+        {
+            fields.clear();
+            keys.clear();
+            // 每个键前至少有'k'和长度两个字节,预留size后追加不会重新分配,键指针保持有效
+            keys.reserve(size);
+            Reader r(args, size);
+            while (!r.eof())
+            {
+                if (static_cast<uint8_t>(*r.pos()) != 'k')
+                {
+                    // {}参数只跳过
+                    std::stringstream skip;
+                    if (!RenderOne(r, skip))
+                        return false;
+                    continue;
+                }
+                r.byte();
+                uint64_t n = r.var();
+                const char *key = r.skip(n);
+                if (!key)
+                    return false;
+                Field f;
+                f.key = keys.data() + keys.size();
+                keys.append(key, n);
+                keys += '\0';
+                switch (r.byte())
+                {
+                case 'i': f.type = Field::INT, f.i = UnZigZag(r.var()); break;
+                case 'u': f.type = Field::UINT, f.u = r.var(); break;
+                case 'b': f.type = Field::BOOL, f.b = r.byte() != 0; break;
+                case 'd':
+                {
+                    uint64_t bits = r.u64();
+                    f.type = Field::DOUBLE;
+                    memcpy(&f.d, &bits, 8);
+                    break;
+                }
+                case 's':
+                    f.type = Field::STRING;
+                    f.str.len = r.var();
+                    f.str.ptr = r.skip(f.str.len);
+                    break;
+                default: return false;
+                }
+                if (!r.ok())
+                    return false;
+                fields.push_back(f);
+            }
+            return r.ok();
+        }
+
+        // 进程内的调用点表
+        class Sites
+        {
+        public:
+            struct Site
+            {
+                uint32_t id;
+                uint64_t hash;
+                std::string file;
+                std::string format;
+                std::string logger;
+                int line;
+                LogLevel::VALUE level;
+                Data::LogGerType type;
+            };
+
+            static Sites &getInstance()
+            {
+                static Sites instance;
+                return instance;
+            }
+
+            // 查找或登记调用点,线程本地缓存命中时不加锁
+            uint32_t id(const Message &msg, StrView format)
+            {
+                uint64_t h = Hash(msg, format);
+                static thread_local std::unordered_map<uint64_t, const Site *> cache;
+                auto it = cache.find(h);
+                if (it != cache.end() && Same(*it->second, msg, format))
+                    return it->second->id;
+
+                std::unique_lock<std::mutex> lock(_mutex);
+                const Site *found = nullptr;
+                auto range = _index.equal_range(h);
+                for (auto i = range.first; i != range.second; ++i)
+                {
+                    if (Same(_sites[i->second], msg, format))
+                    {
+                        found = &_sites[i->second];
+                        break;
+                    }
+                }
+                if (!found)
+                {
+                    uint32_t id = static_cast<uint32_t>(_sites.size());
+                    _sites.push_back(Site{id, h, msg._filename, format.str(), msg._loggername, msg._line, msg._value, msg._loggertype});
+                    _index.insert({h, id});
+                    found = &_sites.back();
+                }
+                lock.unlock();
+                cache[h] = found;
+                return found->id;
+            }
+
+            // deque扩容不移动已有元素,返回的引用一直有效
+            const Site &site(uint32_t id)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                return _sites[id];
+            }
+
+        private:
+            Sites() = default;
+
+            static bool Same(const Site &s, const Message &msg, StrView format)
+            {
+                return s.line == msg._line && s.level == msg._value && s.type == msg._loggertype &&
+                       s.file == msg._filename && format == s.format && s.logger == msg._loggername;
+            }
+            static uint64_t Hash(const Message &msg, StrView format)
+            {
+                uint64_t h = 1469598103934665603ull;
+                auto mix = [&h](const char *p, size_t n)
+                {
+                    for (size_t i = 0; i < n; ++i)
+                        h = (h ^ static_cast<uint8_t>(p[i])) * 1099511628211ull;
+                    h = (h ^ 0xff) * 1099511628211ull;
+                };
+                mix(msg._filename.data(), msg._filename.size());
+                mix(format.data, format.size);
+                mix(msg._loggername.data(), msg._loggername.size());
+                int64_t tail[3] = {msg._line, msg._value, msg._loggertype};
+                mix(reinterpret_cast<const char *>(tail), sizeof(tail));
+                return h;
+            }
+
+        private:
+            std::mutex _mutex;
+            std::deque<Site> _sites;
+            std::unordered_multimap<uint64_t, uint32_t> _index;
+        };
+
+        // 一个文件会话中已经写出的字典,由落地方向持有
+        // 把日志记录引用而本会话尚未写出的字典记录插在第一次引用它的日志记录之前
+        class Dictionary
+        {
+        public:
+            // 开始新的会话
+            void reset() { _written.clear(); }
+
+            // data为若干完整的日志记录,补上字典后追加到out;无法解析时不修改状态并返回false
+            bool annotate(const char *data, size_t len, std::string &out)
+            {
+                size_t mark = out.size();
+                _fresh.clear();
+                Reader r(data, len);
+                const char *copied = data;
+                while (!r.eof())
+                {
+                    const char *rec = r.pos();
+                    if (r.byte() != 'R')
+                        return Undo(out, mark);
+                    uint64_t id = r.var();
+                    r.var(), r.var();
+                    r.skip(r.var());
+                    if (!r.ok())
+                        return Undo(out, mark);
+                    if (id >= _written.size())
+                        _written.resize(id + 1, false);
+                    if (_written[id])
+                        continue;
+                    out.append(copied, rec - copied);
+                    copied = rec;
+                    Write(out, Sites::getInstance().site(static_cast<uint32_t>(id)));
+                    _written[id] = true;
+                    _fresh.push_back(id);
+                }
+                out.append(copied, data + len - copied);
+                return true;
+            }
+
+            static void Write(std::string &out, const Sites::Site &site)
+            {
+                out += 'D';
+                PutVar(out, site.id);
+                out += static_cast<char>(site.level);
+                out += static_cast<char>(site.type);
+                PutVar(out, static_cast<uint64_t>(site.line));
+                PutStr(out, site.file);
+                PutStr(out, site.logger);
+                PutStr(out, site.format);
+            }
+
+        private:
+            bool Undo(std::string &out, size_t mark)
+            {
+                out.resize(mark);
+                for (uint64_t id : _fresh)
+                    _written[id] = false;
+                return false;
+            }
+
+        private:
+            std::vector<bool> _written;
+            std::vector<uint64_t> _fresh;
+        };
+
+        // 会话记录,由落地方向在打开文件时写入
+        inline std::string SessionRecord()
+        {
+            std::string out(1, 'S');
+            PutU64(out, EpochUs());
+            return out;
+        }
+        // 解码后的一条日志
+        struct Entry
+        {
+            LogLevel::VALUE level;
+            Data::LogGerType type;
+            int line;
+            std::string file;
+            std::string logger;
+            std::string content;
+            uint64_t time_us; // 微秒级时间戳
+            uint64_t tid;
+        };
+
+        // 解码整个二进制日志文件的内容,按写入顺序回调每条日志
+        // 每个会话先收集全部字典记录再还原日志;找不到字典的日志记录被跳过,个数累加到skipped
+        // 遇到损坏或写了一半的记录时停止并返回false
+        inline bool Decode(const std::string &data, const std::function<void(const Entry &)> &cb,
+                           size_t *skipped = nullptr)
+        {
+            if (data.size() < 8 || memcmp(data.data(), Magic, 4) != 0)
+                return false;
+            struct Dict
+            {
+                LogLevel::VALUE level;
+                Data::LogGerType type;
+                int line;
+                std::string file, logger, format;
+            };
+            Reader r(data.data() + 8, data.size() - 8);
+            while (!r.eof())
+            {
+                if (r.byte() != 'S')
+                    return false;
+                uint64_t epoch = r.u64();
+                const char *begin = r.pos();
+                // 第一遍:收集本会话的字典,确定会话结束位置
+                std::unordered_map<uint64_t, Dict> dicts;
+                bool ok = true;
+                while (!r.eof() && static_cast<uint8_t>(*r.pos()) != 'S')
+                {
+                    uint8_t tag = r.byte();
+                    if (tag == 'D')
+                    {
+                        uint64_t id = r.var();
+                        Dict d;
+                        d.level = static_cast<LogLevel::VALUE>(r.byte());
+                        d.type = static_cast<Data::LogGerType>(r.byte());
+                        d.line = static_cast<int>(r.var());
+                        d.file = r.str();
+                        d.logger = r.str();
+                        d.format = r.str();
+                        if (r.ok())
+                            dicts[id] = d;
+                    }
+                    else if (tag == 'R')
+                    {
+                        r.var(), r.var(), r.var();
+                        r.skip(r.var());
+                    }
+                    if (!r.ok() || (tag != 'D' && tag != 'R'))
+                    {
+                        ok = false;
+                        break;
+                    }
+                }
+                // 第二遍:还原日志记录
+                Reader rr(begin, r.pos() - begin);
+                Entry e;
+                while (!rr.eof())
+                {
+                    uint8_t tag = rr.byte();
+                    if (tag == 'D')
+                    {
+                        rr.var(), rr.byte(), rr.byte(), rr.var();
+                        rr.str(), rr.str(), rr.str();
+                        if (!rr.ok())
+                            break;
+                        continue;
+                    }
+                    uint64_t id = rr.var();
+                    uint64_t ts = rr.var();
+                    uint64_t tid = rr.var();
+                    uint64_t n = rr.var();
+                    const char *args = rr.skip(n);
+                    if (!rr.ok() || tag != 'R')
+                        break;
+                    auto it = dicts.find(id);
+                    if (it == dicts.end())
+                    {
+                        if (skipped)
+                            ++*skipped;
+                        continue;
+                    }
+                    const Dict &d = it->second;
+                    e.level = d.level;
+                    e.type = d.type;
+                    e.line = d.line;
+                    e.file = d.file;
+                    e.logger = d.logger;
+                    e.time_us = epoch + ts;
+                    e.tid = tid;
+                    if (!Render(d.format, args, n, e.content))
+                        return false;
+                    cb(e);
+                }
+                if (!ok)
+                    return false;
+            }
+            return true;
+        }
+
+        // 编码器,只输出日志记录;调用点登记到Sites,字典记录由落地方向写出(见Dictionary)
+        class Encoder
+        {
+        public:
+            // 日志器没有打包参数时(_rawformat为空),以日志内容作为格式串
+            void encode(std::string &rec, const Message &msg)
+            {
+                StrView fmt = msg._rawformat.data ? msg._rawformat : StrView(msg._content);
+                uint32_t id = Sites::getInstance().id(msg, fmt);
+                rec += 'R';
+                PutVar(rec, id);
+                uint64_t now = NowUs(), epoch = EpochUs();
+                PutVar(rec, now > epoch ? now - epoch : 0);
+                PutVar(rec, ThreadNum());
+                if (msg._rawformat.data && msg._packed)
+                    PutStr(rec, *msg._packed);
+                else
+                    PutVar(rec, 0);
+            }
+        };
+    } // namespace Binary
+}
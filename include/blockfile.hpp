@@ -0,0 +1,275 @@
+#pragma once
+#include "compress.hpp"
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+/*
+    可定位的块压缩日志文件格式
+    文件头: "LBLK" + 版本号u32
+    数据块: "BLK1" + 原始长度u32 + 压缩长度u32 + 记录数u32
+            + 最早时间u64 + 最晚时间u64 + 块在原始流中的偏移u64 + 数据
+            每个块独立压缩(FastLZ),压缩长度等于原始长度时按原样存储
+    索引:   "IDX1" + 块数u32 + 每块[文件偏移u64 最早时间u64 最晚时间u64 记录数u32 原始偏移u64]
+    文件尾: 索引偏移u64 + "LEND"
+    正常关闭时写入索引和文件尾,进程崩溃导致缺少索引时可顺序扫描块头重建
+*/
+namespace Log
+{
+    namespace Block
+    {
+        static constexpr const char *FileMagic = "LBLK";
+        static constexpr const char *BlockMagic = "BLK1";
+        static constexpr const char *IndexMagic = "IDX1";
+        static constexpr const char *EndMagic = "LEND";
+        static const uint32_t Version = 1;
+        static const size_t FileHeaderSize = 8;
+        static const size_t BlockHeaderSize = 4 + 4 * 3 + 8 * 3;
+        static const size_t IndexEntrySize = 8 * 3 + 4 + 8;
+        static const size_t TrailerSize = 8 + 4;
+
+        struct BlockInfo
+        {
+            uint64_t fileoffset; // 块头在文件中的位置
+            uint32_t rawlen;
+            uint32_t complen;
+            uint32_t records;
+            uint64_t tsmin;
+            uint64_t tsmax;
+            uint64_t rawoffset; // 块在解压后日志流中的位置
+        };
+
+        inline void PutU32(std::string &out, uint32_t v)
+        {
+            for (int i = 0; i < 4; ++i)
+                out += static_cast<char>((v >> (8 * i)) & 0xff);
+        }
+        inline void PutU64(std::string &out, uint64_t v)
+        {
+            for (int i = 0; i < 8; ++i)
+                out += static_cast<char>((v >> (8 * i)) & 0xff);
+        }
+        inline uint32_t GetU32(const char *p)
+        {
+            const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+            return b[0] | (b[1] << 8) | (b[2] << 16) | (uint32_t(b[3]) << 24);
+        }
+        inline uint64_t GetU64(const char *p)
+        {
+            return GetU32(p) | (uint64_t(GetU32(p + 4)) << 32);
+        }
+
+        inline std::string EncodeBlockHeader(const BlockInfo &b)
+        {
+            std::string out(BlockMagic, 4);
+            PutU32(out, b.rawlen);
+            PutU32(out, b.complen);
+            PutU32(out, b.records);
+            PutU64(out, b.tsmin);
+            PutU64(out, b.tsmax);
+            PutU64(out, b.rawoffset);
+            return out;
+        }
+
+        inline std::string EncodeIndex(const std::vector<BlockInfo> &blocks, uint64_t indexoffset)
+        {
+            std::string out(IndexMagic, 4);
+            PutU32(out, static_cast<uint32_t>(blocks.size()));
+            for (auto &b : blocks)
+            {
+                PutU64(out, b.fileoffset);
+                PutU64(out, b.tsmin);
+                PutU64(out, b.tsmax);
+                PutU32(out, b.records);
+                PutU64(out, b.rawoffset);
+            }
+            PutU64(out, indexoffset);
+            out.append(EndMagic, 4);
+            return out;
+        }
+
+        inline int64_t Tell(FILE *f)
+        {
+#ifdef _WIN32
+            return _ftelli64(f);
+#else
+            return ftello(f);
+#endif
+        }
+        inline bool Seek(FILE *f, int64_t off)
+        {
+#ifdef _WIN32
+            return _fseeki64(f, off, SEEK_SET) == 0;
+#else
+            return fseeko(f, off, SEEK_SET) == 0;
+#endif
+        }
+
+        // 块文件读取器,优先使用文件尾的索引,索引缺失时顺序扫描块头
+        class Reader
+        {
+        public:
+            Reader()
+                : _fp(nullptr), _indexed(false), _end(0)
+            {
+            }
+            ~Reader() { close(); }
+            Reader(const Reader &) = delete;
+            Reader &operator=(const Reader &) = delete;
+
+            bool open(const std::string &path)
+            {
+                close();
+                _fp = fopen(path.c_str(), "rb");
+                if (!_fp)
+                    return false;
+                char head[FileHeaderSize];
+                if (fread(head, 1, FileHeaderSize, _fp) != FileHeaderSize || memcmp(head, FileMagic, 4) != 0 ||
+                    GetU32(head + 4) != Version)
+                {
+                    close();
+                    return false;
+                }
+                if (!LoadIndex())
+                    Scan();
+                return true;
+            }
+            void close()
+            {
+                if (_fp)
+                    fclose(_fp);
+                _fp = nullptr;
+                _blocks.clear();
+                _indexed = false;
+                _end = 0;
+            }
+
+            const std::vector<BlockInfo> &blocks() const { return _blocks; }
+            // 是否通过文件尾索引加载(否则为扫描重建)
+            bool indexed() const { return _indexed; }
+            // 最后一个完整块之后的文件位置,追加写入从这里开始
+            uint64_t dataEnd() const { return _end; }
+
+            // 第一个可能包含不早于ts的记录的块
+            size_t seek(uint64_t ts) const
+            {
+                size_t lo = 0, hi = _blocks.size();
+                // 块按写入顺序排列,最晚时间单调不减
+                while (lo < hi)
+                {
+                    size_t mid = (lo + hi) / 2;
+                    if (_blocks[mid].tsmax < ts)
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+                return lo;
+            }
+
+            // 解压第i块的全部内容
+            bool read(size_t i, std::string &out)
+            {
+                if (!_fp || i >= _blocks.size())
+                    return false;
+                const BlockInfo &b = _blocks[i];
+                std::string comp(b.complen, '\0');
+                if (!Seek(_fp, b.fileoffset + BlockHeaderSize) ||
+                    (b.complen && fread(&comp[0], 1, b.complen, _fp) != b.complen))
+                    return false;
+                if (b.complen == b.rawlen)
+                {
+                    out.swap(comp);
+                    return true;
+                }
+                out.assign(b.rawlen, '\0');
+                return Codec::FastLZ::Decompress(comp.data(), comp.size(), &out[0], b.rawlen);
+            }
+
+        private:
+            bool LoadIndex()
+            {
+                if (fseek(_fp, 0, SEEK_END) != 0)
+                    return false;
+                int64_t size = Tell(_fp);
+                if (size < static_cast<int64_t>(FileHeaderSize + TrailerSize))
+                    return false;
+                char trailer[TrailerSize];
+                if (!Seek(_fp, size - TrailerSize) || fread(trailer, 1, TrailerSize, _fp) != TrailerSize ||
+                    memcmp(trailer + 8, EndMagic, 4) != 0)
+                    return false;
+                uint64_t indexoffset = GetU64(trailer);
+                if (indexoffset + 8 + TrailerSize > static_cast<uint64_t>(size))
+                    return false;
+                char head[8];
+                if (!Seek(_fp, indexoffset) || fread(head, 1, 8, _fp) != 8 || memcmp(head, IndexMagic, 4) != 0)
+                    return false;
+                uint32_t count = GetU32(head + 4);
+                if (indexoffset + 8 + uint64_t(count) * IndexEntrySize + TrailerSize != static_cast<uint64_t>(size))
+                    return false;
+                std::string entries(size_t(count) * IndexEntrySize, '\0');
+                if (count && fread(&entries[0], 1, entries.size(), _fp) != entries.size())
+                    return false;
+                std::vector<BlockInfo> blocks(count);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    const char *p = entries.data() + size_t(i) * IndexEntrySize;
+                    BlockInfo &b = blocks[i];
+                    b.fileoffset = GetU64(p);
+                    b.tsmin = GetU64(p + 8);
+                    b.tsmax = GetU64(p + 16);
+                    b.records = GetU32(p + 24);
+                    b.rawoffset = GetU64(p + 28);
+                    // 长度信息只在块头中,校验块头与索引一致
+                    char bh[BlockHeaderSize];
+                    if (!Seek(_fp, b.fileoffset) || fread(bh, 1, BlockHeaderSize, _fp) != BlockHeaderSize ||
+                        memcmp(bh, BlockMagic, 4) != 0)
+                        return false;
+                    b.rawlen = GetU32(bh + 4);
+                    b.complen = GetU32(bh + 8);
+                }
+                _blocks.swap(blocks);
+                _indexed = true;
+                _end = indexoffset;
+                return true;
+            }
+
+            void Scan()
+            {
+                _blocks.clear();
+                uint64_t off = FileHeaderSize;
+                char bh[BlockHeaderSize];
+                while (Seek(_fp, off) && fread(bh, 1, BlockHeaderSize, _fp) == BlockHeaderSize &&
+                       memcmp(bh, BlockMagic, 4) == 0)
+                {
+                    BlockInfo b;
+                    b.fileoffset = off;
+                    b.rawlen = GetU32(bh + 4);
+                    b.complen = GetU32(bh + 8);
+                    b.records = GetU32(bh + 12);
+                    b.tsmin = GetU64(bh + 16);
+                    b.tsmax = GetU64(bh + 24);
+                    b.rawoffset = GetU64(bh + 32);
+                    // 最后一块可能只写了一半
+                    if (fseek(_fp, 0, SEEK_END) != 0 ||
+                        static_cast<uint64_t>(Tell(_fp)) < off + BlockHeaderSize + b.complen)
+                        break;
+                    _blocks.push_back(b);
+                    off += BlockHeaderSize + b.complen;
+                }
+                _end = off;
+            }
+
+        private:
+            FILE *_fp;
+            bool _indexed;
+            uint64_t _end;
+            std::vector<BlockInfo> _blocks;
+        };
+    } // namespace Block
+}
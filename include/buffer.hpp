@@ -1,52 +1,267 @@
 #pragma once
 #include "logdata.hpp"
-#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 /*
     日志写入和读取的缓冲区
     在异步写入时，采用双缓冲区的方式进行写入
     一个线程负责写入缓冲区，一个线程负责写入磁盘
     当写入缓存区写完一次日志后会交换缓冲区
+    缓冲区是构造时一次保留的定长地址空间,用写入位置记录已用长度,写入只做memcpy
+    实际使用的内存按块从全局预算(log.total_buffer_budget)借用,写满一块再借下一块并触碰其内存页,
+    借到的块在清空时继续保留,之后的写入不再缺页;只有预算紧张(再借一块就会失败)时,
+    清空才只保留上一轮用到的块,其余归还预算并释放物理内存
+    被采样的日志在写入时记下时间戳,时间戳随缓冲区一起交换,写入落地方向后用于统计端到端延迟
+    可选透明大页/显式大页(log.buffer_pages)和mlock锁定(log.buffer_mlock)
 */
 namespace Log
 {
+    // 所有异步缓冲区共享的内存预算
+    class BufferBudget
+    {
+    public:
+        static BufferBudget &getInstance()
+        {
+            static BufferBudget instance;
+            return instance;
+        }
+
+        // 预算不足时返回false;force为true时总是成功(每个缓冲区的第一块)
+        bool borrow(size_t n, bool force = false)
+        {
+            size_t used = _used.load(std::memory_order_relaxed);
+            do
+            {
+                if (!force && _limit && used + n > _limit)
+                    return false;
+            } while (!_used.compare_exchange_weak(used, used + n, std::memory_order_relaxed));
+            return true;
+        }
+        void giveback(size_t n) { _used.fetch_sub(n, std::memory_order_relaxed); }
+        // 再借n字节就会失败时返回true,缓冲区据此决定清空时是否归还空闲的块
+        bool pressure(size_t n) const
+        {
+            size_t limit = _limit.load(std::memory_order_relaxed);
+            return limit && used() + n > limit;
+        }
+
+        size_t used() const { return _used.load(std::memory_order_relaxed); }
+        // 0为不限制
+        size_t limit() const { return _limit; }
+        // 运行时调整,已借出的内存不受影响,之后的借用按新上限判断
+        void setLimit(size_t limit) { _limit = limit; }
+
+    private:
+        BufferBudget()
+            : _limit(Data::totalBufferBudget()), _used(0)
+        {
+        }
+
+    private:
+        std::atomic<size_t> _limit;
+        std::atomic<size_t> _used;
+    };
+
     class Buffer
     {
     public:
-        Buffer(const size_t buffsize = Data::max_buffer_size())
-            : _surplus_size(buffsize), _max_size(buffsize)
+        enum
+        {
+            MaxStamps = 64
+        };
+
+        // account不为空时,借用和归还的字节数同时计入其中(按日志器统计用量)
+        Buffer(const size_t buffsize = Data::max_buffer_size(),
+               Data::BufferPages pages = Data::bufferPages(),
+               bool lock = Data::bufferMlock(),
+               std::atomic<size_t> *account = nullptr)
+            : _data(nullptr), _max_size(buffsize), _pos(0), _capacity(0), _mapsize(0),
+              _chunk(pages == Data::NORMALPAGE ? 64 * 1024 : 2 * 1024 * 1024),
+              _lock(lock), _locked(false), _account(account), _nstamps(0)
         {
+            Allocate(pages);
+            // 第一块不受预算限制,保证每个缓冲区都能工作
+            Grow(std::min(_chunk, _max_size), true);
         }
-        void push(const std::string &con)
+        ~Buffer()
+        {
+            Shrink(0);
+            Free();
+        }
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+
+        // 还能写入len字节时返回true,必要时从预算借用新的块
+        bool fits(size_t len)
         {
-            _buffer += con;
-            if (_surplus_size > con.size())
+            if (len <= _capacity - _pos)
+                return true;
+            if (len > _max_size - _pos)
+                return false;
+            size_t need = (_pos + len + _chunk - 1) / _chunk * _chunk;
+            return Grow(std::min(need, _max_size), false);
+        }
+
+        // 调用者需先用fits()确认空间,超出已借用部分的内容被丢弃
+        void push(const char *data, size_t len)
+        {
+            if (len > _capacity - _pos)
+                len = _capacity - _pos;
+            memcpy(_data + _pos, data, len);
+            _pos += len;
+        }
+        void push(const std::string &con) { push(con.data(), con.size()); }
+
+        // 记录被采样日志的写入时间,超过MaxStamps个时忽略
+        void stamp(uint64_t ns)
+        {
+            if (_nstamps < MaxStamps)
+                _stamps[_nstamps++] = ns;
+        }
+        const uint64_t *stamps() const { return _stamps; }
+        size_t stampCount() const { return _nstamps; }
+
+        // 只交换内存区域,不复制内容
+        void swap(Buffer &buf)
+        {
+            std::swap(_data, buf._data);
+            std::swap(_max_size, buf._max_size);
+            std::swap(_pos, buf._pos);
+            std::swap(_capacity, buf._capacity);
+            std::swap(_mapsize, buf._mapsize);
+            std::swap(_chunk, buf._chunk);
+            std::swap(_lock, buf._lock);
+            std::swap(_locked, buf._locked);
+            std::swap(_account, buf._account);
+            std::swap(_stamps, buf._stamps);
+            std::swap(_nstamps, buf._nstamps);
+        }
+        bool empty() const { return _pos == 0; }
+        const char *data() const { return _data; }
+        size_t size() const { return _pos; }
+        // 当前借用的字节数
+        size_t capacity() const { return _capacity; }
+        // 单个缓冲区的上限(log.max_buffer_size)
+        size_t maxsize() const { return _max_size; }
+        // 距离单个缓冲区上限的剩余空间
+        size_t WriteBSize() const { return _max_size - _pos; }
+        // 清空,预算紧张时归还上一轮没有用到的块
+        void clear()
+        {
+            size_t keep = (_pos + _chunk - 1) / _chunk * _chunk;
+            _pos = 0;
+            _nstamps = 0;
+            if (BufferBudget::getInstance().pressure(_chunk))
+                Shrink(std::max(std::min(keep, _max_size), std::min(_chunk, _max_size)));
+        }
+        // 是否成功锁定在物理内存中
+        bool locked() const { return _locked; }
+
+    private:
+        // 只保留地址空间,物理内存在借用块时才触碰
+        void Allocate(Data::BufferPages pages)
+        {
+            size_t size = _max_size ? _max_size : 1;
+#ifndef _WIN32
+            size_t align = pages == Data::NORMALPAGE ? 4096 : 2 * 1024 * 1024;
+            size_t mapsize = (size + align - 1) / align * align;
+            void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            if (pages == Data::HUGETLB)
+                p = mmap(nullptr, mapsize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+            // 没有预留大页时退回到透明大页
+            if (p == MAP_FAILED)
             {
-                _surplus_size -= con.size();
+                p = mmap(nullptr, mapsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+                if (p != MAP_FAILED && pages != Data::NORMALPAGE)
+                    madvise(p, mapsize, MADV_HUGEPAGE);
+#endif
             }
-            else
+            if (p != MAP_FAILED)
             {
-                _surplus_size = 0;
+                _data = static_cast<char *>(p);
+                _mapsize = mapsize;
             }
+#endif
+            if (!_data)
+                _data = static_cast<char *>(malloc(size));
         }
-        void swap(Buffer &buf)
+        void Free()
         {
-            std::swap(_surplus_size, buf._surplus_size);
-            std::swap(_buffer, buf._buffer);
+            if (!_data)
+                return;
+#ifndef _WIN32
+            if (_mapsize)
+            {
+                munmap(_data, _mapsize);
+                _data = nullptr;
+                return;
+            }
+#endif
+            free(_data);
+            _data = nullptr;
         }
-        bool empty() const { return _surplus_size == _max_size; }
-        const std::string &ReadBuffer() const { return _buffer; }
-        size_t WriteBSize() const { return _surplus_size; }
-        void clear() 
+
+        bool Grow(size_t target, bool force)
         {
-            _buffer.clear();
-            _surplus_size = _max_size; 
+            if (target <= _capacity)
+                return true;
+            size_t n = target - _capacity;
+            if (!BufferBudget::getInstance().borrow(n, force))
+                return false;
+            if (_account)
+                _account->fetch_add(n, std::memory_order_relaxed);
+            // 预先触碰新借用的内存页,借到的块在清空时保留,只有超过此前的峰值时才会走到这里
+            memset(_data + _capacity, 0, n);
+#ifndef _WIN32
+            // 超过RLIMIT_MEMLOCK时锁定失败,缓冲区仍可正常使用
+            if (_lock)
+                _locked = mlock(_data + _capacity, n) == 0 && (_capacity == 0 || _locked);
+#endif
+            _capacity = target;
+            return true;
+        }
+        void Shrink(size_t target)
+        {
+            if (target >= _capacity)
+                return;
+            size_t n = _capacity - target;
+#ifndef _WIN32
+            if (_lock)
+                munlock(_data + target, n);
+            // 归还物理内存,地址空间保留
+            if (_mapsize && target % _chunk == 0)
+                madvise(_data + target, n, MADV_DONTNEED);
+#endif
+            BufferBudget::getInstance().giveback(n);
+            if (_account)
+                _account->fetch_sub(n, std::memory_order_relaxed);
+            _capacity = target;
         }
 
     private:
-    private:
-        size_t _surplus_size;
+        char *_data;
         size_t _max_size;
-        std::string _buffer;
+        size_t _pos;
+        size_t _capacity; // 已从预算借用的字节数
+        size_t _mapsize;  // 不为0时内存来自mmap
+        size_t _chunk;
+        bool _lock;
+        bool _locked;
+        std::atomic<size_t> *_account;
+        uint64_t _stamps[MaxStamps];
+        size_t _nstamps;
     };
 
 }
@@ -0,0 +1,222 @@
+#pragma once
+#include "level.hpp"
+#include "tool.hpp"
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+/*
+    调用点注册模块(动态调试)
+    每个日志宏展开处有一个静态的CallSite,第一次执行时登记到全局表中
+    运行时可以按文件通配符、行号范围、日志器名称打开或关闭一批调用点:
+        打开(ON)的调用点不受日志器等级限制,关闭(OFF)的调用点不再输出
+    调用点状态按(调用点,日志器)区分:第一个执行该调用点的日志器使用CallSite中的状态,
+    热路径上只有两次relaxed读取;同一个宏调用点被其他日志器执行时,
+    在调用点的附加槽位链表中无锁查找,第一次执行时在锁内追加槽位
+*/
+namespace Log
+{
+    // 调用点被其他日志器执行时的状态,登记后不再释放
+    struct SiteSlot
+    {
+        uint32_t logger;
+        std::atomic<int> state;
+        SiteSlot *next;
+    };
+
+    struct CallSite
+    {
+        enum State : int
+        {
+            UNREGISTERED = 0, // 尚未执行过
+            DEFAULT,          // 按日志器等级过滤
+            ON,
+            OFF
+        };
+
+        // constexpr构造:宏中的静态CallSite在编译期初始化,没有初始化守卫
+        constexpr CallSite(const char *f, int l, LogLevel::VALUE lv)
+            : file(f), line(l), level(lv), state(UNREGISTERED), logger(0), extra(nullptr), vcache(0)
+        {
+        }
+        CallSite(const CallSite &) = delete;
+        CallSite &operator=(const CallSite &) = delete;
+
+        const char *file;
+        int line;
+        LogLevel::VALUE level;
+        std::atomic<int> state;          // 第一个执行的日志器的状态
+        std::atomic<uint32_t> logger;    // 该日志器的编号(CallSites::loggerId),0为尚未登记
+        std::atomic<SiteSlot *> extra;   // 其他日志器的状态
+        // 按模块等级规则的缓存:高32位为规则版本,低32位为匹配到的等级(见vmodule.hpp)
+        std::atomic<uint64_t> vcache;
+    };
+
+    // 选择调用点的条件,空字符串表示不限制
+    struct SiteFilter
+    {
+        std::string file; // 路径通配符,规则见tool::File::MatchPath
+        int from;
+        int to;
+        std::string logger;
+
+        SiteFilter(const std::string &f = "", int begin = 0, int end = INT_MAX, const std::string &lg = "")
+            : file(f), from(begin), to(end), logger(lg)
+        {
+        }
+        bool match(const CallSite &site, const std::string &loggername) const
+        {
+            return site.line >= from && site.line <= to &&
+                   (logger.empty() || logger == loggername) &&
+                   tool::File::MatchPath(file, site.file);
+        }
+    };
+
+    class CallSites
+    {
+    public:
+        // 已登记调用点的快照
+        struct Info
+        {
+            std::string file;
+            int line;
+            LogLevel::VALUE level;
+            std::string logger;
+            CallSite::State state;
+        };
+
+        static CallSites &getInstance()
+        {
+            static CallSites instance;
+            return instance;
+        }
+
+        // 日志器名称对应的编号,从1开始,同名日志器编号相同
+        uint32_t loggerId(const std::string &loggername)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (size_t i = 0; i < _loggers.size(); ++i)
+            {
+                if (_loggers[i] == loggername)
+                    return static_cast<uint32_t>(i + 1);
+            }
+            _loggers.push_back(loggername);
+            return static_cast<uint32_t>(_loggers.size());
+        }
+
+        // 编号为id的日志器执行该调用点时的状态,第一次执行时登记并按已有规则确定初始状态
+        // 热路径(第一个执行的日志器)在日志器中内联,这里处理登记和其他日志器
+        int state(CallSite &site, uint32_t id)
+        {
+            for (SiteSlot *slot = site.extra.load(std::memory_order_acquire); slot; slot = slot->next)
+            {
+                if (slot->logger == id)
+                    return slot->state.load(std::memory_order_relaxed);
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            uint32_t owner = site.logger.load(std::memory_order_relaxed);
+            if (owner == id)
+                return site.state.load(std::memory_order_relaxed);
+            if (owner == 0)
+            {
+                site.logger.store(id, std::memory_order_relaxed);
+                _entries.push_back(Entry{&site, id, &site.state});
+                int st = Resolve(_entries.back());
+                site.state.store(st, std::memory_order_relaxed);
+                return st;
+            }
+            for (SiteSlot *slot = site.extra.load(std::memory_order_relaxed); slot; slot = slot->next)
+            {
+                if (slot->logger == id)
+                    return slot->state.load(std::memory_order_relaxed);
+            }
+            _slots.emplace_back();
+            SiteSlot *slot = &_slots.back();
+            slot->logger = id;
+            slot->next = site.extra.load(std::memory_order_relaxed);
+            _entries.push_back(Entry{&site, id, &slot->state});
+            int st = Resolve(_entries.back());
+            slot->state.store(st, std::memory_order_relaxed);
+            site.extra.store(slot, std::memory_order_release);
+            return st;
+        }
+
+        // 打开/关闭匹配的调用点,之后登记的调用点同样生效,返回当前匹配的个数
+        size_t enable(const SiteFilter &filter) { return Apply(filter, CallSite::ON); }
+        size_t disable(const SiteFilter &filter) { return Apply(filter, CallSite::OFF); }
+        // 恢复为按日志器等级过滤
+        size_t restore(const SiteFilter &filter) { return Apply(filter, CallSite::DEFAULT); }
+
+        // 清除所有规则
+        void reset()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _rules.clear();
+            for (auto &e : _entries)
+                e.state->store(CallSite::DEFAULT, std::memory_order_relaxed);
+        }
+
+        std::vector<Info> list()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::vector<Info> out;
+            out.reserve(_entries.size());
+            for (auto &e : _entries)
+                out.push_back(Info{e.site->file, e.site->line, e.site->level, _loggers[e.logger - 1],
+                                   static_cast<CallSite::State>(e.state->load(std::memory_order_relaxed))});
+            return out;
+        }
+
+    private:
+        // 一个(调用点,日志器)的登记
+        struct Entry
+        {
+            CallSite *site;
+            uint32_t logger;
+            std::atomic<int> *state;
+        };
+        struct Rule
+        {
+            SiteFilter filter;
+            CallSite::State state;
+        };
+
+        CallSites() = default;
+
+        size_t Apply(const SiteFilter &filter, CallSite::State state)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _rules.push_back(Rule{filter, state});
+            size_t n = 0;
+            for (auto &e : _entries)
+            {
+                if (filter.match(*e.site, _loggers[e.logger - 1]))
+                {
+                    e.state->store(state, std::memory_order_relaxed);
+                    ++n;
+                }
+            }
+            return n;
+        }
+        // 后设置的规则优先
+        int Resolve(const Entry &e) const
+        {
+            for (auto it = _rules.rbegin(); it != _rules.rend(); ++it)
+            {
+                if (it->filter.match(*e.site, _loggers[e.logger - 1]))
+                    return it->state;
+            }
+            return CallSite::DEFAULT;
+        }
+
+    private:
+        std::mutex _mutex;
+        std::deque<Entry> _entries;
+        std::deque<SiteSlot> _slots;        // deque扩容不移动已有元素,槽位地址一直有效
+        std::vector<std::string> _loggers; // 编号-1为下标
+        std::vector<Rule> _rules;
+    };
+}
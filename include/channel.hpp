@@ -0,0 +1,153 @@
+#pragma once
+#include "ansyctrl.hpp"
+#include "sink.hpp"
+#include "profile.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+/*
+    落地通道模块
+    每个落地方向拥有独立的缓冲区和写入线程(异步)或独立的锁(同步),
+    一个落地方向阻塞(例如被管道堵住的终端)不会拖慢其他落地方向
+    通道统计写入量、丢弃量、积压量、写入耗时、缓冲区交换次数、生产者等待时间和滚动次数,
+    以及被采样日志从提交到写入落地方向完成的延迟分布
+*/
+namespace Log
+{
+    // 单个落地方向的统计快照
+    struct ChannelStats
+    {
+        size_t pushed;          // 进入缓冲区(同步时为提交)的字节数
+        size_t written;         // 已写入落地方向的字节数
+        size_t dropped;         // 因缓冲区写满而丢弃的日志条数
+        size_t lag;             // 已提交尚未写入的字节数
+        size_t writes;          // 调用WriteFile的次数
+        uint64_t write_ns;      // WriteFile累计耗时
+        uint64_t max_write_ns;  // 单次WriteFile最大耗时
+        size_t buffered;        // 异步缓冲区从全局预算借用的字节数(同步时为0)
+        uint64_t swaps;         // 交换缓冲区的次数(同步时为0)
+        uint64_t wait_ns;       // 生产者等待缓冲区空间的累计耗时
+        uint64_t rotations;     // 落地方向滚动文件的次数
+        Data::OverflowPolicy overflow; // 缓冲区写满时的处理方式(同步时为落地方向的设置)
+        LatencyStats latency;   // 被采样日志从提交到写入完成的延迟
+    };
+
+    class SinkChannel
+    {
+    public:
+        typedef std::shared_ptr<SinkChannel> ptr;
+
+        // ansyctrl为空时为同步通道,在调用线程中直接写入
+        // profiler不为空时统计写入阶段的耗时(LOG_PROFILE)
+        SinkChannel(const Sink::ptr &sink, const ACtrl::AnsyCtrl::ptr &ansyctrl = nullptr,
+                    const Profiler::ptr &profiler = nullptr)
+            : _state(std::make_shared<State>(sink, profiler)), _ansyctrl(ansyctrl)
+        {
+            if (_ansyctrl)
+            {
+                _ansyctrl->setOverflow(sink->GetOverflow());
+                // 回调只持有通道状态,线程池中迟到的任务不会访问已销毁的通道
+                std::shared_ptr<State> state = _state;
+                _ansyctrl->bindcallbackf([state](const char *data, size_t len)
+                                         { state->Write(data, len); });
+            }
+        }
+        ~SinkChannel()
+        {
+            if (_ansyctrl)
+                _ansyctrl->stop();
+        }
+        SinkChannel(const SinkChannel &) = delete;
+        SinkChannel &operator=(const SinkChannel &) = delete;
+
+        // stamp不为0时统计这条日志的端到端延迟
+        void push(const std::string &str, uint64_t stamp = 0)
+        {
+            if (_ansyctrl)
+            {
+                _ansyctrl->push(str, stamp);
+            }
+            else
+            {
+                _state->_pushed += str.size();
+                {
+                    std::unique_lock<std::mutex> lock(_state->_mutex);
+                    _state->Write(str);
+                }
+                if (stamp)
+                    _state->_latency.record(Histogram::Now() - stamp);
+            }
+        }
+
+        const Sink::ptr &sink() const { return _state->_sink; }
+        const ACtrl::AnsyCtrl::ptr &ansyctrl() const { return _ansyctrl; }
+
+        ChannelStats stats() const
+        {
+            ChannelStats st;
+            st.pushed = _ansyctrl ? _ansyctrl->accepted() : _state->_pushed.get();
+            st.written = _state->_written;
+            st.dropped = _ansyctrl ? _ansyctrl->dropped() : 0;
+            st.writes = _state->_writes;
+            st.write_ns = _state->_write_ns;
+            st.max_write_ns = _state->_max_write_ns;
+            st.lag = st.pushed > st.written ? st.pushed - st.written : 0;
+            st.buffered = _ansyctrl ? _ansyctrl->bufferBytes() : 0;
+            st.swaps = _ansyctrl ? _ansyctrl->swaps() : 0;
+            st.wait_ns = _ansyctrl ? _ansyctrl->waitNs() : 0;
+            st.rotations = _state->_sink->GetRotations();
+            st.overflow = _ansyctrl ? _ansyctrl->overflow() : _state->_sink->GetOverflow();
+            st.latency = _ansyctrl ? _ansyctrl->latency().stats() : _state->_latency.stats();
+            return st;
+        }
+
+    private:
+        struct State
+        {
+            State(const Sink::ptr &sink, const Profiler::ptr &profiler)
+                : _sink(sink), _profiler(profiler), _pushed(0), _written(0), _writes(0), _write_ns(0), _max_write_ns(0)
+            {
+            }
+            void Write(const std::string &buf)
+            {
+                LOG_PROFILE_SCOPE(_profiler.get(), WRITE);
+                auto begin = std::chrono::steady_clock::now();
+                _sink->WriteFile(buf);
+                Done(begin, buf.size());
+            }
+            // 异步缓冲区的整块内容,直接交给落地方向不复制
+            void Write(const char *data, size_t len)
+            {
+                LOG_PROFILE_SCOPE(_profiler.get(), WRITE);
+                auto begin = std::chrono::steady_clock::now();
+                _sink->WriteData(data, len);
+                Done(begin, len);
+            }
+            void Done(std::chrono::steady_clock::time_point begin, size_t len)
+            {
+                uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - begin)
+                                  .count();
+                _written += len;
+                ++_writes;
+                _write_ns += ns;
+                _max_write_ns.max(ns);
+            }
+
+            Sink::ptr _sink;
+            Profiler::ptr _profiler;
+            std::mutex _mutex;
+            Counter _pushed;
+            Counter _written;
+            Counter _writes;
+            Counter _write_ns;
+            Counter _max_write_ns;
+            Histogram _latency;
+        };
+
+    private:
+        std::shared_ptr<State> _state;
+        ACtrl::AnsyCtrl::ptr _ansyctrl;
+    };
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "logdata.hpp"
+#include "tool.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+/*
+    滚动日志文件清理模块
+    1.按文件个数、总大小、保留时间三种方式限制历史日志
+    2.清理任务只在文件滚动时提交,由后台线程扫描目录并删除旧文件
+    3.同一组日志文件的多个未处理任务会被合并,避免重复扫描
+    4.单例在第一个使用它的RollFileSink或全局管理之前构造,析构晚于它们,
+      析构过程中的滚动仍可以提交任务
+*/
+namespace Log
+{
+    // 历史日志保留策略,各项为0表示不限制
+    struct RetainPolicy
+    {
+        size_t count;
+        size_t bytes;
+        size_t seconds;
+
+        RetainPolicy(size_t c = 0, size_t b = 0, size_t s = 0)
+            : count(c), bytes(b), seconds(s)
+        {
+        }
+        static RetainPolicy Default()
+        {
+            return RetainPolicy(Data::retainCount(), Data::retainBytes(), Data::retainSeconds());
+        }
+        bool enabled() const { return count || bytes || seconds; }
+    };
+
+    class LogCleaner
+    {
+    public:
+        struct Job
+        {
+            std::string pattern; // 匹配该组日志文件的通配符
+            std::string keep;    // 正在写入的文件,永远不会被删除
+            RetainPolicy policy;
+        };
+
+        static LogCleaner &getInstance()
+        {
+            static LogCleaner instance;
+            return instance;
+        }
+
+        void submit(const Job &job)
+        {
+            if (!job.policy.enabled())
+                return;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_stop)
+                    return;
+                if (!_th.joinable())
+                    _th = std::thread(&LogCleaner::HandleJobs, this);
+                // 合并同一组文件尚未处理的任务
+                auto it = std::find_if(_jobs.begin(), _jobs.end(), [&](const Job &j)
+                                       { return j.pattern == job.pattern; });
+                if (it != _jobs.end())
+                    *it = job;
+                else
+                    _jobs.push_back(job);
+            }
+            _cond.notify_one();
+        }
+
+        // 等待已提交的清理任务全部完成
+        void drain()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [&]()
+                       { return _jobs.empty() && _running == 0; });
+        }
+
+        // 立即执行一次清理,返回删除的文件个数
+        static size_t Clean(const Job &job)
+        {
+            std::vector<tool::File::FileInfo> files = tool::File::ListFiles(job.pattern);
+            // 旧文件排在前面
+            std::sort(files.begin(), files.end(), [](const tool::File::FileInfo &a, const tool::File::FileInfo &b)
+                      {
+                          if (a.mtime != b.mtime)
+                              return a.mtime < b.mtime;
+                          if (a.mtime_ns != b.mtime_ns)
+                              return a.mtime_ns < b.mtime_ns;
+                          return a.path < b.path; });
+
+            size_t total = 0;
+            for (auto &f : files)
+                total += f.size;
+            size_t count = files.size();
+            time_t now = tool::Date::GetTime();
+            size_t removed = 0;
+
+            for (auto &f : files)
+            {
+                // 跳过正在写入的文件和尚未完成的压缩临时文件
+                if (f.path == job.keep || IsTmp(f.path))
+                    continue;
+                bool over = (job.policy.count && count > job.policy.count) ||
+                            (job.policy.bytes && total > job.policy.bytes) ||
+                            (job.policy.seconds && now - f.mtime > static_cast<time_t>(job.policy.seconds));
+                if (!over)
+                    break;
+                if (std::remove(f.path.c_str()) == 0)
+                {
+                    --count;
+                    total -= f.size;
+                    ++removed;
+                }
+            }
+            return removed;
+        }
+
+        static bool IsTmp(const std::string &path)
+        {
+            return path.size() >= 4 && path.compare(path.size() - 4, 4, ".tmp") == 0;
+        }
+
+        LogCleaner(const LogCleaner &) = delete;
+        LogCleaner &operator=(const LogCleaner &) = delete;
+
+    private:
+        LogCleaner()
+            : _stop(false), _running(0)
+        {
+        }
+        ~LogCleaner()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            if (_th.joinable())
+                _th.join();
+        }
+
+        void HandleJobs()
+        {
+            while (true)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _cond.wait(lock, [&]()
+                               { return _stop || !_jobs.empty(); });
+                    // 退出前处理完剩余任务
+                    if (_jobs.empty())
+                        break;
+                    job = _jobs.front();
+                    _jobs.pop_front();
+                    ++_running;
+                }
+                Clean(job);
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    --_running;
+                }
+                _done.notify_all();
+            }
+        }
+
+    private:
+        bool _stop;
+        size_t _running;
+        std::deque<Job> _jobs;
+        std::thread _th;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::condition_variable _done;
+    };
+}
@@ -0,0 +1,483 @@
+#pragma once
+#include "logdata.hpp"
+#include "tool.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#ifdef LOG_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+/*
+    日志文件压缩模块
+    1.FastLZ: 内置的LZ77块编码,格式与LZ4 block类似,无外部依赖
+    2.Gzip: 定义LOG_USE_ZLIB并链接-lz时可用,输出标准gzip流
+    3.Compressor: 低优先级后台线程压缩滚动后的旧文件
+      压缩结果先写入临时文件并落盘,重命名完成后才删除原文件,
+      任何时刻崩溃都至少保留一份完整的日志
+    4.崩溃遗留的临时文件在RollFileSink启动时由recover()删除,原文件重新提交压缩
+*/
+namespace Log
+{
+    namespace Codec
+    {
+        class FastLZ
+        {
+        public:
+            static constexpr const char *Magic = "FLZ1";
+            static constexpr const char *Suffix = ".flz";
+            static const size_t BlockSize = 256 * 1024;
+
+            // 压缩结果的最大长度
+            static size_t Bound(size_t n) { return n + n / 255 + 16; }
+
+            // 压缩src到dst,dst至少Bound(n)字节,返回压缩后长度
+            static size_t Compress(const char *src, size_t n, char *dst)
+            {
+                const size_t MinMatch = 4;
+                const size_t HashLog = 12;
+                uint32_t table[1 << HashLog];
+                memset(table, 0, sizeof(table));
+
+                const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+                uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+                size_t op = 0, ip = 0, anchor = 0;
+                // 末尾保留一段字面量,保证解码时拷贝不越界
+                size_t mflimit = n > 12 ? n - 12 : 0;
+
+                while (ip < mflimit)
+                {
+                    uint32_t seq = Read32(in + ip);
+                    uint32_t h = (seq * 2654435761u) >> (32 - HashLog);
+                    size_t ref = table[h];
+                    table[h] = static_cast<uint32_t>(ip + 1);
+                    if (ref == 0 || ip + 1 - ref > 65535 || Read32(in + ref - 1) != seq)
+                    {
+                        // 不可压缩的数据逐渐加大步长
+                        ip += 1 + ((ip - anchor) >> 6);
+                        continue;
+                    }
+                    --ref;
+                    size_t len = MinMatch;
+                    while (ip + len < n - 5 && in[ref + len] == in[ip + len])
+                        ++len;
+
+                    op = WriteSequence(out, op, in + anchor, ip - anchor, ip - ref, len - MinMatch);
+                    ip += len;
+                    anchor = ip;
+                }
+                // 最后一段字面量
+                size_t lit = n - anchor;
+                out[op++] = static_cast<uint8_t>((lit >= 15 ? 15 : lit) << 4);
+                op = WriteLength(out, op, lit);
+                memcpy(out + op, in + anchor, lit);
+                return op + lit;
+            }
+
+            // 解压到dst,raw为原始长度,数据损坏时返回false
+            static bool Decompress(const char *src, size_t n, char *dst, size_t raw)
+            {
+                const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+                uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+                size_t ip = 0, op = 0;
+                while (ip < n)
+                {
+                    uint8_t token = in[ip++];
+                    size_t lit = token >> 4;
+                    if (!ReadLength(in, n, ip, lit))
+                        return false;
+                    if (ip + lit > n || op + lit > raw)
+                        return false;
+                    memcpy(out + op, in + ip, lit);
+                    ip += lit;
+                    op += lit;
+                    if (ip == n)
+                        break;
+
+                    if (ip + 2 > n)
+                        return false;
+                    size_t offset = in[ip] | (in[ip + 1] << 8);
+                    ip += 2;
+                    size_t len = token & 15;
+                    if (!ReadLength(in, n, ip, len))
+                        return false;
+                    len += 4;
+                    if (offset == 0 || offset > op || op + len > raw)
+                        return false;
+                    // 匹配区间可能与输出重叠,逐字节拷贝
+                    for (size_t i = 0; i < len; ++i, ++op)
+                        out[op] = out[op - offset];
+                }
+                return op == raw;
+            }
+
+            // 文件格式: Magic + 若干块[原始长度u32][压缩长度u32][数据] + 原始长度为0的结束块
+            // 压缩长度等于原始长度时数据按原样存储
+            static bool CompressStream(FILE *in, FILE *out)
+            {
+                std::vector<char> raw(BlockSize), comp(Bound(BlockSize));
+                if (fwrite(Magic, 1, 4, out) != 4)
+                    return false;
+                size_t n;
+                while ((n = fread(raw.data(), 1, raw.size(), in)) > 0)
+                {
+                    size_t c = Compress(raw.data(), n, comp.data());
+                    const char *data = comp.data();
+                    if (c >= n)
+                    {
+                        c = n;
+                        data = raw.data();
+                    }
+                    if (!WriteU32(out, n) || !WriteU32(out, c) || fwrite(data, 1, c, out) != c)
+                        return false;
+                }
+                return !ferror(in) && WriteU32(out, 0) && WriteU32(out, 0);
+            }
+
+            static bool DecompressStream(FILE *in, FILE *out)
+            {
+                char magic[4];
+                if (fread(magic, 1, 4, in) != 4 || memcmp(magic, Magic, 4) != 0)
+                    return false;
+                std::vector<char> raw, comp;
+                while (true)
+                {
+                    uint32_t n, c;
+                    if (!ReadU32(in, n) || !ReadU32(in, c))
+                        return false;
+                    if (n == 0)
+                        return true;
+                    if (c > n)
+                        return false;
+                    raw.resize(n);
+                    comp.resize(c);
+                    if (fread(comp.data(), 1, c, in) != c)
+                        return false;
+                    if (c == n)
+                        raw.swap(comp);
+                    else if (!Decompress(comp.data(), c, raw.data(), n))
+                        return false;
+                    if (fwrite(raw.data(), 1, n, out) != n)
+                        return false;
+                }
+            }
+
+        private:
+            static uint32_t Read32(const uint8_t *p)
+            {
+                uint32_t v;
+                memcpy(&v, p, 4);
+                return v;
+            }
+            static size_t WriteLength(uint8_t *out, size_t op, size_t len)
+            {
+                if (len < 15)
+                    return op;
+                len -= 15;
+                while (len >= 255)
+                {
+                    out[op++] = 255;
+                    len -= 255;
+                }
+                out[op++] = static_cast<uint8_t>(len);
+                return op;
+            }
+            static bool ReadLength(const uint8_t *in, size_t n, size_t &ip, size_t &len)
+            {
+                if (len != 15)
+                    return true;
+                uint8_t b;
+                do
+                {
+                    if (ip >= n)
+                        return false;
+                    b = in[ip++];
+                    len += b;
+                } while (b == 255);
+                return true;
+            }
+            static size_t WriteSequence(uint8_t *out, size_t op, const uint8_t *lit, size_t litlen,
+                                        size_t offset, size_t matchlen)
+            {
+                out[op++] = static_cast<uint8_t>(((litlen >= 15 ? 15 : litlen) << 4) | (matchlen >= 15 ? 15 : matchlen));
+                op = WriteLength(out, op, litlen);
+                memcpy(out + op, lit, litlen);
+                op += litlen;
+                out[op++] = static_cast<uint8_t>(offset & 0xff);
+                out[op++] = static_cast<uint8_t>(offset >> 8);
+                return WriteLength(out, op, matchlen);
+            }
+            static bool WriteU32(FILE *out, uint32_t v)
+            {
+                uint8_t b[4] = {uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24)};
+                return fwrite(b, 1, 4, out) == 4;
+            }
+            static bool ReadU32(FILE *in, uint32_t &v)
+            {
+                uint8_t b[4];
+                if (fread(b, 1, 4, in) != 4)
+                    return false;
+                v = b[0] | (b[1] << 8) | (b[2] << 16) | (uint32_t(b[3]) << 24);
+                return true;
+            }
+        };
+
+#ifdef LOG_USE_ZLIB
+        class Gzip
+        {
+        public:
+            static constexpr const char *Suffix = ".gz";
+
+            static bool CompressStream(FILE *in, FILE *out, int level = Z_DEFAULT_COMPRESSION)
+            {
+                z_stream zs;
+                memset(&zs, 0, sizeof(zs));
+                // windowBits + 16 输出gzip头
+                if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                    return false;
+                std::vector<unsigned char> inbuf(64 * 1024), outbuf(64 * 1024);
+                bool ok = true;
+                int flush = Z_NO_FLUSH;
+                do
+                {
+                    zs.avail_in = static_cast<uInt>(fread(inbuf.data(), 1, inbuf.size(), in));
+                    if (ferror(in))
+                    {
+                        ok = false;
+                        break;
+                    }
+                    flush = feof(in) ? Z_FINISH : Z_NO_FLUSH;
+                    zs.next_in = inbuf.data();
+                    do
+                    {
+                        zs.avail_out = static_cast<uInt>(outbuf.size());
+                        zs.next_out = outbuf.data();
+                        deflate(&zs, flush);
+                        size_t have = outbuf.size() - zs.avail_out;
+                        if (fwrite(outbuf.data(), 1, have, out) != have)
+                            ok = false;
+                    } while (ok && zs.avail_out == 0);
+                } while (ok && flush != Z_FINISH);
+                deflateEnd(&zs);
+                return ok;
+            }
+        };
+#endif
+    } // namespace Codec
+
+    class Compressor
+    {
+    public:
+        static Compressor &getInstance()
+        {
+            static Compressor instance;
+            return instance;
+        }
+
+        // 压缩后的文件后缀
+        static std::string Suffix(Data::CompressType type)
+        {
+#ifdef LOG_USE_ZLIB
+            if (type == Data::GZIP)
+                return Codec::Gzip::Suffix;
+#endif
+            (void)type;
+            return Codec::FastLZ::Suffix;
+        }
+
+        // 同步压缩一个文件:写临时文件->落盘->重命名->删除原文件
+        static bool CompressFile(const std::string &file, Data::CompressType type)
+        {
+            if (type == Data::NOCOMPRESS)
+                return false;
+            std::string target = file + Suffix(type);
+            std::string tmp = target + ".tmp";
+            FILE *in = fopen(file.c_str(), "rb");
+            if (!in)
+                return false;
+            FILE *out = fopen(tmp.c_str(), "wb");
+            if (!out)
+            {
+                fclose(in);
+                return false;
+            }
+            bool ok;
+#ifdef LOG_USE_ZLIB
+            if (type == Data::GZIP)
+                ok = Codec::Gzip::CompressStream(in, out);
+            else
+#endif
+                ok = Codec::FastLZ::CompressStream(in, out);
+            fclose(in);
+            ok = ok && fflush(out) == 0 && Sync(out);
+            ok = (fclose(out) == 0) && ok;
+            if (!ok || std::rename(tmp.c_str(), target.c_str()) != 0)
+            {
+                std::remove(tmp.c_str());
+                return false;
+            }
+            // 压缩文件已经完整落地,此时才能删除原文件
+            std::remove(file.c_str());
+            return true;
+        }
+
+        void submit(const std::string &file, Data::CompressType type)
+        {
+            if (type == Data::NOCOMPRESS)
+                return;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_stop)
+                    return;
+                _jobs.push_back(Job{file, type});
+                _busy.insert(file);
+                // 按需创建线程,数量不超过并发上限
+                size_t limit = Data::compressThreads() ? Data::compressThreads() : 1;
+                if (_workers.size() < limit && _idle == 0)
+                    _workers.emplace_back(&Compressor::HandleJobs, this);
+            }
+            _cond.notify_one();
+        }
+
+        // 删除pattern匹配的、不属于排队或进行中任务的临时文件(崩溃时遗留),返回删除的个数
+        // type不为NOCOMPRESS时,仍然存在的原文件(keep除外)重新提交压缩
+        size_t recover(const std::string &pattern, const std::string &keep, Data::CompressType type)
+        {
+            std::vector<std::string> sources;
+            size_t removed = 0;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                for (auto &f : tool::File::ListFiles(pattern))
+                {
+                    std::string source = Source(f.path);
+                    if (source.empty() || _busy.count(source))
+                        continue;
+                    if (std::remove(f.path.c_str()) == 0)
+                        ++removed;
+                    if (source != keep && tool::File::FileisExist(source))
+                        sources.push_back(source);
+                }
+            }
+            for (auto &source : sources)
+                submit(source, type);
+            return removed;
+        }
+
+        // 等待队列中的压缩任务全部完成
+        void drain()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [&]()
+                       { return _jobs.empty() && _running == 0; });
+        }
+
+        Compressor(const Compressor &) = delete;
+        Compressor &operator=(const Compressor &) = delete;
+
+    private:
+        struct Job
+        {
+            std::string file;
+            Data::CompressType type;
+        };
+
+        Compressor()
+            : _stop(false), _idle(0), _running(0)
+        {
+        }
+        ~Compressor()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            for (auto &th : _workers)
+            {
+                if (th.joinable())
+                    th.join();
+            }
+        }
+
+        // 临时文件对应的原文件: <原文件><压缩后缀>.tmp,不是压缩临时文件时返回空
+        static std::string Source(const std::string &tmp)
+        {
+            const std::string suffixes[] = {Codec::FastLZ::Suffix, ".gz"};
+            for (auto &suffix : suffixes)
+            {
+                std::string tail = suffix + ".tmp";
+                if (tmp.size() > tail.size() && tmp.compare(tmp.size() - tail.size(), tail.size(), tail) == 0)
+                    return tmp.substr(0, tmp.size() - tail.size());
+            }
+            return std::string();
+        }
+
+        static bool Sync(FILE *f)
+        {
+#ifdef _WIN32
+            return _commit(_fileno(f)) == 0;
+#else
+            return fsync(fileno(f)) == 0;
+#endif
+        }
+
+        // 降低当前线程的CPU优先级,避免与业务线程争抢
+        static void LowerPriority()
+        {
+#ifdef __linux__
+            setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), static_cast<int>(Data::compressNice()));
+#endif
+        }
+
+        void HandleJobs()
+        {
+            LowerPriority();
+            while (true)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    ++_idle;
+                    _cond.wait(lock, [&]()
+                               { return _stop || !_jobs.empty(); });
+                    --_idle;
+                    // 退出前处理完剩余任务
+                    if (_jobs.empty())
+                        break;
+                    job = _jobs.front();
+                    _jobs.pop_front();
+                    ++_running;
+                }
+                CompressFile(job.file, job.type);
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    --_running;
+                    _busy.erase(_busy.find(job.file));
+                }
+                _done.notify_all();
+            }
+        }
+
+    private:
+        bool _stop;
+        size_t _idle;
+        size_t _running;
+        std::deque<Job> _jobs;
+        std::multiset<std::string> _busy; // 排队和进行中任务的原文件
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::condition_variable _done;
+    };
+}
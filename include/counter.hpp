@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+/*
+    统计计数器
+    每个计数器独占一个缓存行,不同计数器被不同线程更新时互不影响(避免伪共享)
+    C++14的new和make_shared不保证超过alignof(max_align_t)的对齐,因此不用alignas,
+    而是在计数值前后各填充56字节:无论对象起始地址如何,计数值所在的缓存行里都没有其他数据
+    只保证计数本身的原子性,读取到的各计数器之间没有一致的快照关系
+*/
+namespace Log
+{
+    struct Counter
+    {
+        Counter(uint64_t v = 0)
+            : value(v)
+        {
+            (void)_front;
+            (void)_back;
+        }
+        void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+        void sub(uint64_t n = 1) { value.fetch_sub(n, std::memory_order_relaxed); }
+        uint64_t get() const { return value.load(std::memory_order_relaxed); }
+        // 只增大,用于记录最大值
+        void max(uint64_t v)
+        {
+            uint64_t cur = get();
+            while (v > cur && !value.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+            {
+            }
+        }
+        operator uint64_t() const { return get(); }
+        Counter &operator+=(uint64_t n)
+        {
+            add(n);
+            return *this;
+        }
+        Counter &operator++()
+        {
+            add();
+            return *this;
+        }
+
+    private:
+        char _front[64 - sizeof(uint64_t)];
+
+    public:
+        std::atomic<uint64_t> value;
+
+    private:
+        char _back[64 - sizeof(uint64_t)];
+    };
+}
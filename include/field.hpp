@@ -0,0 +1,179 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
+/*
+    结构化日志字段模块
+    kv("id", id) 生成一个带类型的字段,随Message传递到格式化阶段才转换为文本
+    字段只引用调用方的数据,不复制也不分配内存,只在一次日志调用期间有效
+*/
+namespace Log
+{
+    struct Field
+    {
+        enum Type
+        {
+            INT,
+            UINT,
+            DOUBLE,
+            BOOL,
+            STRING,
+            OTHER // 任意支持operator<<的类型,格式化时才输出
+        };
+        typedef void (*RenderF)(std::ostream &, const void *);
+
+        const char *key;
+        Type type;
+        union
+        {
+            int64_t i;
+            uint64_t u;
+            double d;
+            bool b;
+            struct
+            {
+                const char *ptr;
+                size_t len;
+            } str;
+            struct
+            {
+                const void *ptr;
+                RenderF render;
+            } other;
+        };
+
+        // 按文本输出值,字符串原样输出
+        void write(std::ostream &out) const
+        {
+            switch (type)
+            {
+            case INT: out << i; break;
+            case UINT: out << u; break;
+            case DOUBLE: out << d; break;
+            case BOOL: out << (b ? "true" : "false"); break;
+            case STRING: out.write(str.ptr, str.len); break;
+            case OTHER: other.render(out, other.ptr); break;
+            }
+        }
+    };
+
+    // 一次日志调用携带的字段
+    struct FieldList
+    {
+        const Field *data;
+        size_t size;
+
+        FieldList(const Field *d = nullptr, size_t n = 0)
+            : data(d), size(n)
+        {
+        }
+        const Field *begin() const { return data; }
+        const Field *end() const { return data + size; }
+        bool empty() const { return size == 0; }
+    };
+
+    namespace FieldDetail
+    {
+        template <class T>
+        void RenderOther(std::ostream &out, const void *p)
+        {
+            out << *static_cast<const T *>(p);
+        }
+
+        inline void Set(Field &f, bool v)
+        {
+            f.type = Field::BOOL;
+            f.b = v;
+        }
+        inline void Set(Field &f, const char &v)
+        {
+            f.type = Field::STRING;
+            f.str.ptr = &v;
+            f.str.len = 1;
+        }
+        inline void Set(Field &f, const char *v)
+        {
+            f.type = Field::STRING;
+            f.str.ptr = v ? v : "";
+            f.str.len = v ? std::char_traits<char>::length(v) : 0;
+        }
+        inline void Set(Field &f, const std::string &v)
+        {
+            f.type = Field::STRING;
+            f.str.ptr = v.data();
+            f.str.len = v.size();
+        }
+        template <class T>
+        typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+        Set(Field &f, const T &v)
+        {
+            f.type = Field::INT;
+            f.i = v;
+        }
+        template <class T>
+        typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+        Set(Field &f, const T &v)
+        {
+            f.type = Field::UINT;
+            f.u = v;
+        }
+        template <class T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type
+        Set(Field &f, const T &v)
+        {
+            f.type = Field::DOUBLE;
+            f.d = v;
+        }
+        template <class T>
+        typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_convertible<T, const char *>::value>::type
+        Set(Field &f, const T &v)
+        {
+            f.type = Field::OTHER;
+            f.other.ptr = &v;
+            f.other.render = &RenderOther<T>;
+        }
+    }
+
+    // 生成结构化字段,值保持原始类型,引用的数据需在本次日志调用期间有效
+    template <class T>
+    Field kv(const char *key, const T &value)
+    {
+        Field f;
+        f.key = key;
+        FieldDetail::Set(f, value);
+        return f;
+    }
+
+    // 参数包中Field的个数
+    template <class... Args>
+    struct FieldCount;
+    template <>
+    struct FieldCount<>
+    {
+        static const size_t value = 0;
+    };
+    template <class T, class... Rest>
+    struct FieldCount<T, Rest...>
+    {
+        static const size_t value = (std::is_same<typename std::decay<T>::type, Field>::value ? 1 : 0) +
+                                    FieldCount<Rest...>::value;
+    };
+
+    // 从参数包中挑出Field,其余参数留给{}占位符
+    inline void CollectFields(Field *, size_t &)
+    {
+    }
+    template <class... Rest>
+    void CollectFields(Field *out, size_t &n, const Field &f, const Rest &...rest)
+    {
+        out[n++] = f;
+        CollectFields(out, n, rest...);
+    }
+    template <class T, class... Rest>
+    void CollectFields(Field *out, size_t &n, const T &, const Rest &...rest)
+    {
+        CollectFields(out, n, rest...);
+    }
+}
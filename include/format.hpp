@@ -2,10 +2,17 @@
 #include "message.hpp"
 #include "level.hpp"
 #include "logdata.hpp"
+#include "binary.hpp"
 #include <memory>
 #include <vector>
 #include <ostream>
 #include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 // 日志消息格式化模块
 namespace Log
 {
@@ -34,7 +41,9 @@ namespace Log
             }
             void format(std::ostream &out, const Log::Message &msg) override
             {
-                out<< Data::GetFormatTime(msg._time,_tf.c_str());
+                char buf[80];
+                size_t n = Data::FormatTime(buf, sizeof(buf), msg._time, _tf.c_str());
+                out.write(buf, n);
             }  
         private:
             bool istrue(const std::string& tf)
@@ -63,7 +72,7 @@ namespace Log
         public:
             void format(std::ostream &out, const Log::Message &msg) override
             {
-                out << std::to_string(msg._line);
+                out << msg._line;
             }
         };
         class LevelFormat : public FormatBase
@@ -79,7 +88,10 @@ namespace Log
         public:
             void format(std::ostream &out, const Log::Message &msg) override
             {
-                out << msg._tid;
+                if (msg._tidnum)
+                    out << msg._tidnum;
+                else
+                    out << msg._tid;
             }
         };
         class FilenameFormat : public FormatBase
@@ -102,13 +114,244 @@ namespace Log
                 else out << name << "_" << tname;
             }
         };
+        // JSON字符串转义,SSE2下每次检查16字节,无需转义的片段整体输出
+        class Json
+        {
+        public:
+            static void Escape(std::ostream &out, const char *s, size_t n)
+            {
+                size_t i = 0, start = 0;
+#if defined(__SSE2__)
+                const __m128i quote = _mm_set1_epi8('"');
+                const __m128i bslash = _mm_set1_epi8('\\');
+                const __m128i ctrl = _mm_set1_epi8(0x1F);
+                while (i + 16 <= n)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+                    // 无符号比较 v <= 0x1F 等价于 max(v, 0x1F) == 0x1F
+                    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+                                             _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+                    int mask = _mm_movemask_epi8(m);
+                    if (mask == 0)
+                    {
+                        i += 16;
+                        continue;
+                    }
+                    i += __builtin_ctz(static_cast<unsigned>(mask));
+                    out.write(s + start, i - start);
+                    EscapeChar(out, s[i]);
+                    start = ++i;
+                }
+#endif
+                for (; i < n; ++i)
+                {
+                    unsigned char c = static_cast<unsigned char>(s[i]);
+                    if (c == '"' || c == '\\' || c < 0x20)
+                    {
+                        out.write(s + start, i - start);
+                        EscapeChar(out, s[i]);
+                        start = i + 1;
+                    }
+                }
+                out.write(s + start, n - start);
+            }
+
+            static void String(std::ostream &out, const char *s, size_t n)
+            {
+                out << '"';
+                Escape(out, s, n);
+                out << '"';
+            }
+
+            // 按JSON类型输出字段值
+            static void Value(std::ostream &out, const Field &f)
+            {
+                switch (f.type)
+                {
+                case Field::INT: out << f.i; break;
+                case Field::UINT: out << f.u; break;
+                case Field::BOOL: out << (f.b ? "true" : "false"); break;
+                case Field::STRING: String(out, f.str.ptr, f.str.len); break;
+                case Field::DOUBLE:
+                {
+                    if (!std::isfinite(f.d))
+                    {
+                        out << "null";
+                        break;
+                    }
+                    // 优先使用较短的表示,无法精确还原时再用17位
+                    char buf[32];
+                    int len = snprintf(buf, sizeof(buf), "%.15g", f.d);
+                    if (strtod(buf, nullptr) != f.d)
+                        len = snprintf(buf, sizeof(buf), "%.17g", f.d);
+                    out.write(buf, len);
+                    break;
+                }
+                case Field::OTHER:
+                {
+                    std::stringstream ss;
+                    f.write(ss);
+                    std::string str = ss.str();
+                    String(out, str.data(), str.size());
+                    break;
+                }
+                }
+            }
+
+        private:
+            static void EscapeChar(std::ostream &out, char ch)
+            {
+                switch (ch)
+                {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\t': out << "\\t"; break;
+                case '\b': out << "\\b"; break;
+                case '\f': out << "\\f"; break;
+                default:
+                {
+                    static const char hex[] = "0123456789abcdef";
+                    unsigned char c = static_cast<unsigned char>(ch);
+                    char buf[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                    out.write(buf, 6);
+                }
+                }
+            }
+        };
+
         class ContentFormat : public FormatBase
         {
         public:
+            ContentFormat()
+                : _withfields(false)
+            {
+            }
             void format(std::ostream &out, const Log::Message &msg) override
             {
                 out << msg._content;
+                if (_withfields)
+                {
+                    for (auto &f : msg._fields)
+                    {
+                        out << ' ' << f.key << '=';
+                        f.write(out);
+                    }
+                }
+            }
+            // 格式中没有%F时,结构化字段跟在内容之后输出
+            void withFields(bool on) { _withfields = on; }
+
+        private:
+            bool _withfields;
+        };
+        class FieldsFormat : public FormatBase
+        {
+        public:
+            void format(std::ostream &out, const Log::Message &msg) override
+            {
+                bool first = true;
+                for (auto &f : msg._fields)
+                {
+                    if (!first)
+                        out << ' ';
+                    first = false;
+                    out << f.key << '=';
+                    f.write(out);
+                }
+            }
+        };
+        // 将整条日志编码为一个JSON对象,结构化字段保持原始类型
+        class JsonFormat : public FormatBase
+        {
+        public:
+            void format(std::ostream &out, const Log::Message &msg) override
+            {
+                char time[80];
+                size_t n = Data::FormatTime(time, sizeof(time), msg._time, Data::defaultTF());
+                out << "{\"time\":";
+                Json::String(out, time, n);
+                out << ",\"level\":\"" << Log::LogLevel::toString(msg._value) << '"';
+                out << ",\"logger\":";
+                Json::String(out, msg._loggername.data(), msg._loggername.size());
+                out << ",\"file\":";
+                Json::String(out, msg._filename.data(), msg._filename.size());
+                out << ",\"line\":" << msg._line;
+                out << ",\"tid\":\"";
+                if (msg._tidnum)
+                    out << msg._tidnum;
+                else
+                    out << msg._tid;
+                out << '"';
+                out << ",\"msg\":";
+                Json::String(out, msg._content.data(), msg._content.size());
+                if (msg._context)
+                {
+                    for (auto &e : *msg._context)
+                    {
+                        out << ',';
+                        Json::String(out, e.key.data(), e.key.size());
+                        out << ':';
+                        Json::String(out, e.value.data(), e.value.size());
+                    }
+                }
+                for (auto &f : msg._fields)
+                {
+                    out << ',';
+                    Json::String(out, f.key, std::char_traits<char>::length(f.key));
+                    out << ':';
+                    Json::Value(out, f);
+                }
+                out << '}';
+            }
+        };
+        // 将整条日志编码为紧凑的二进制记录,由二进制落地方向使用
+        class BinaryFormat : public FormatBase
+        {
+        public:
+            void format(std::ostream &out, const Log::Message &msg) override
+            {
+                static thread_local std::string rec;
+                rec.clear();
+                _encoder.encode(rec, msg);
+                out.write(rec.data(), rec.size());
             }
+
+        private:
+            Binary::Encoder _encoder;
+        };
+        // %X{key}输出上下文中key的值,%X输出全部上下文 key=value
+        class MdcFormat : public FormatBase
+        {
+        public:
+            MdcFormat(const std::string &key)
+                : _key(key)
+            {
+            }
+            void format(std::ostream &out, const Log::Message &msg) override
+            {
+                if (!msg._context)
+                    return;
+                if (!_key.empty())
+                {
+                    const std::string *value = msg._context->find(_key);
+                    if (value)
+                        out << *value;
+                    return;
+                }
+                bool first = true;
+                for (auto &e : *msg._context)
+                {
+                    if (!first)
+                        out << ' ';
+                    first = false;
+                    out << e.key << '=' << e.value;
+                }
+            }
+
+        private:
+            std::string _key;
         };
         class NewlineFormat : public FormatBase
         {
@@ -161,10 +404,18 @@ namespace Log
             }
             std::string format(const Log::Message &msg)
             {
-                std::stringstream ss;
-                format(ss, msg);
-                return ss.str();
+                std::string out;
+                format(out, msg);
+                return out;
+            }
+            // 追加到out,通过线程本地的流输出,out的容量足够时不分配内存
+            void format(std::string &out, const Log::Message &msg)
+            {
+                ScratchStream ss(out);
+                format(ss.get(), msg);
             }
+            // 实际生效的格式(无效格式会被替换为默认格式)
+            const std::string &pattern() const { return _format; }
 
         private:
             void format(std::ostream &out, const Log::Message &msg)
@@ -186,6 +437,10 @@ namespace Log
                 //%c 文件内容
                 //%n 换行
                 //%T tab
+                //%F 结构化字段 key=value
+                //%J 整条日志编码为JSON对象,"%J%n"即JSON lines
+                //%B 整条日志编码为二进制记录,见binary.hpp
+                //%X{key} 线程上下文中key的值,%X为全部上下文
                 //%o 其他
                 switch (op)
                 {
@@ -198,6 +453,10 @@ namespace Log
                 case 'c': return std::make_shared<Format::ContentFormat>();
                 case 'n': return std::make_shared<Format::NewlineFormat>();
                 case 'T': return std::make_shared<Format::TabFormat>();
+                case 'F': return std::make_shared<Format::FieldsFormat>();
+                case 'J': return std::make_shared<Format::JsonFormat>();
+                case 'B': return std::make_shared<Format::BinaryFormat>();
+                case 'X': return std::make_shared<Format::MdcFormat>(str);
                 default:  return std::make_shared<Format::OtherFormat>(str);
                 }
             }
@@ -211,7 +470,14 @@ namespace Log
                     if(op == '%')
                     {
                         char tmp = _format[++i];
-                        if(isop(tmp))
+                        if(tmp == 'X' && i + 1 < size && _format[i + 1] == '{')
+                        {
+                            auto pos = _format.find("}",i);
+                            if(pos == std::string::npos) return false;
+                            _item.push_back(createItem('X',_format.substr(i + 2,pos - i - 2)));
+                            i = pos;
+                        }
+                        else if(isop(tmp))
                         {
                             _item.push_back(createItem((_format[i])));
                         }
@@ -233,13 +499,23 @@ namespace Log
                     }
 
                 }
+                // 没有显式的%F时,结构化字段跟随%c输出
+                if(_format.find("%F") == std::string::npos)
+                {
+                    for(auto &item : _item)
+                    {
+                        auto content = std::dynamic_pointer_cast<Format::ContentFormat>(item);
+                        if(content) content->withFields(true);
+                    }
+                }
                 return true;
             }
             bool isop(char op)
             {
                 if(op == 'L' || op == 'N' || op == 'D' \
                     || op == 'f' || op == 'l' || op == 'c' \
-                    || op == 'n' || op == 'T') {return true;}
+                    || op == 'n' || op == 'T' || op == 'F' \
+                    || op == 'J' || op == 'B' || op == 'X') {return true;}
                 else {return false;}
             }
         private:
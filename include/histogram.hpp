@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+/*
+    延迟直方图
+    按对数分桶(HDR风格):每个2的幂区间再均分为16个子桶,相对误差不超过1/16
+    记录时对桶和总和各做一次原子加,最大值用CAS更新(只有出现新的最大值时才重试),
+    不加锁不分配内存;查询时遍历各桶求分位数
+    取值单位为纳秒,超过2^40纳秒(约18分钟)的值计入最后一个桶
+*/
+namespace Log
+{
+    // 延迟统计快照,单位纳秒;分位数取所在桶的上界(不超过最大值)
+    struct LatencyStats
+    {
+        uint64_t count;
+        uint64_t sum_ns;
+        uint64_t max_ns;
+        uint64_t p50_ns;
+        uint64_t p90_ns;
+        uint64_t p99_ns;
+        uint64_t p999_ns;
+    };
+
+    class Histogram
+    {
+    public:
+        enum
+        {
+            SubBits = 4,
+            SubCount = 1 << SubBits,
+            MaxBits = 40,
+            BucketCount = (MaxBits - SubBits + 1) * SubCount
+        };
+
+        Histogram() { reset(); }
+        Histogram(const Histogram &) = delete;
+        Histogram &operator=(const Histogram &) = delete;
+
+        // 单调时钟的当前时间,用作采样时间戳(非0)
+        static uint64_t Now()
+        {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now().time_since_epoch())
+                              .count();
+            return ns ? ns : 1;
+        }
+
+        void record(uint64_t ns)
+        {
+            _buckets[Index(ns)].fetch_add(1, std::memory_order_relaxed);
+            _sum.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t cur = _max.load(std::memory_order_relaxed);
+            while (ns > cur && !_max.compare_exchange_weak(cur, ns, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        uint64_t count() const
+        {
+            uint64_t n = 0;
+            for (size_t i = 0; i < BucketCount; ++i)
+                n += _buckets[i].load(std::memory_order_relaxed);
+            return n;
+        }
+
+        // q取值(0,1],没有记录时返回0
+        uint64_t percentile(double q) const
+        {
+            return Percentile(q, count());
+        }
+
+        LatencyStats stats() const
+        {
+            LatencyStats st;
+            st.count = count();
+            st.sum_ns = _sum.load(std::memory_order_relaxed);
+            st.max_ns = _max.load(std::memory_order_relaxed);
+            st.p50_ns = Percentile(0.5, st.count);
+            st.p90_ns = Percentile(0.9, st.count);
+            st.p99_ns = Percentile(0.99, st.count);
+            st.p999_ns = Percentile(0.999, st.count);
+            return st;
+        }
+
+        // 合并另一个直方图,例如各线程分别记录后汇总
+        void merge(const Histogram &other)
+        {
+            for (size_t i = 0; i < BucketCount; ++i)
+                _buckets[i].fetch_add(other._buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            _sum.fetch_add(other._sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            uint64_t ns = other._max.load(std::memory_order_relaxed);
+            uint64_t cur = _max.load(std::memory_order_relaxed);
+            while (ns > cur && !_max.compare_exchange_weak(cur, ns, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        void reset()
+        {
+            for (size_t i = 0; i < BucketCount; ++i)
+                _buckets[i].store(0, std::memory_order_relaxed);
+            _sum.store(0, std::memory_order_relaxed);
+            _max.store(0, std::memory_order_relaxed);
+        }
+
+        // 值所在的桶,小于16的值各占一个桶
+        static size_t Index(uint64_t v)
+        {
+            if (v >= (uint64_t(1) << MaxBits))
+                return BucketCount - 1;
+            if (v < SubCount)
+                return static_cast<size_t>(v);
+            int msb = Msb(v);
+            size_t sub = static_cast<size_t>(v >> (msb - SubBits)) - SubCount;
+            return (msb - SubBits + 1) * SubCount + sub;
+        }
+        // 桶内的最大值
+        static uint64_t Upper(size_t idx)
+        {
+            if (idx < SubCount)
+                return idx;
+            size_t shift = idx / SubCount - 1;
+            uint64_t lower = static_cast<uint64_t>(SubCount + idx % SubCount) << shift;
+            return lower + (uint64_t(1) << shift) - 1;
+        }
+
+    private:
+        uint64_t Percentile(double q, uint64_t total) const
+        {
+            if (total == 0)
+                return 0;
+            uint64_t rank = static_cast<uint64_t>(q * total + 0.999999);
+            if (rank < 1)
+                rank = 1;
+            uint64_t max = _max.load(std::memory_order_relaxed);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BucketCount; ++i)
+            {
+                seen += _buckets[i].load(std::memory_order_relaxed);
+                if (seen >= rank)
+                    return Upper(i) < max ? Upper(i) : max;
+            }
+            return max;
+        }
+
+        static int Msb(uint64_t v)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return 63 - __builtin_clzll(v);
+#else
+            int n = 0;
+            while (v >>= 1)
+                ++n;
+            return n;
+#endif
+        }
+
+    private:
+        std::atomic<uint64_t> _buckets[BucketCount];
+        std::atomic<uint64_t> _sum;
+        std::atomic<uint64_t> _max;
+    };
+}
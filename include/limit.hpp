@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+/*
+    调用点限流模块
+    每个调用点持有一个限流器(宏中的静态变量),只用原子操作,不加锁
+    allow返回本次是否输出,并给出上次输出以来被抑制的条数
+*/
+namespace Log
+{
+    namespace Limit
+    {
+        inline int64_t NowNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        // 每n条输出一条(第1、n+1、2n+1...条)
+        class EveryN
+        {
+        public:
+            bool allow(uint64_t n, uint64_t &suppressed)
+            {
+                uint64_t c = _count.fetch_add(1, std::memory_order_relaxed);
+                if (n <= 1)
+                {
+                    suppressed = 0;
+                    return true;
+                }
+                if (c % n != 0)
+                    return false;
+                suppressed = c == 0 ? 0 : n - 1;
+                return true;
+            }
+
+        private:
+            std::atomic<uint64_t> _count{0};
+        };
+
+        // 只输出前n条
+        class FirstN
+        {
+        public:
+            bool allow(uint64_t n, uint64_t &suppressed)
+            {
+                suppressed = 0;
+                // 超过n之后不再递增,避免计数回绕
+                if (_count.load(std::memory_order_relaxed) >= n)
+                    return false;
+                return _count.fetch_add(1, std::memory_order_relaxed) < n;
+            }
+
+        private:
+            std::atomic<uint64_t> _count{0};
+        };
+
+        // 每ms毫秒最多输出一条
+        class EveryMs
+        {
+        public:
+            bool allow(uint64_t ms, uint64_t &suppressed)
+            {
+                int64_t now = NowNs();
+                int64_t next = _next.load(std::memory_order_relaxed);
+                if (now < next ||
+                    !_next.compare_exchange_strong(next, now + static_cast<int64_t>(ms) * 1000000,
+                                                   std::memory_order_relaxed))
+                {
+                    _suppressed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+                return true;
+            }
+
+        private:
+            std::atomic<int64_t> _next{0};
+            std::atomic<uint64_t> _suppressed{0};
+        };
+
+        // 令牌桶:平均每秒rate条,最多连续burst条
+        // 用GCRA算法实现,整个桶的状态是一个原子时间戳
+        class TokenBucket
+        {
+        public:
+            struct Param
+            {
+                double rate;
+                uint64_t burst;
+            };
+
+            bool allow(const Param &p, uint64_t &suppressed)
+            {
+                if (p.rate <= 0)
+                {
+                    _suppressed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                int64_t interval = static_cast<int64_t>(1e9 / p.rate);
+                int64_t tolerance = interval * static_cast<int64_t>(p.burst > 0 ? p.burst - 1 : 0);
+                int64_t now = NowNs();
+                int64_t tat = _tat.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    int64_t base = tat > now ? tat : now;
+                    if (base - now > tolerance)
+                    {
+                        _suppressed.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    if (_tat.compare_exchange_weak(tat, base + interval, std::memory_order_relaxed))
+                        break;
+                }
+                suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+                return true;
+            }
+
+        private:
+            std::atomic<int64_t> _tat{0}; // 理论上下一条到达的时间
+            std::atomic<uint64_t> _suppressed{0};
+        };
+    }
+}
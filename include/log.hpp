@@ -1,5 +1,6 @@
 #pragma once
 #include "logger.hpp"
+#include "metrics.hpp"
 /*
     用户使用只需要包含次头文件
     使用宏函数简化用户的操作
@@ -7,6 +8,9 @@
 
 namespace mylog
 {
+    // 结构化字段: logger->INFO("order placed", mylog::kv("id", id))
+    using Log::kv;
+
     void AddLogger(Log::LogGer::Logger::ptr logger)
     {
         return Log::LogGer::SingleManage::getInstance().addLogger(logger);
@@ -26,11 +30,37 @@ namespace mylog
         return Log::LogGer::SingleManage::getInstance().DefaultSyncLogger();
     }
 
-#define DEBUG(fmt, ...) Debug(__LINE__, __FILE__, fmt, ##__VA_ARGS__)
-#define INFO(fmt, ...) Info(__LINE__, __FILE__, fmt, ##__VA_ARGS__)
-#define WARNING(fmt, ...) Warning(__LINE__, __FILE__, fmt, ##__VA_ARGS__)
-#define ERRNO(fmt, ...) Errno(__LINE__, __FILE__, fmt, ##__VA_ARGS__)
-#define FATAL(fmt, ...) Fatal(__LINE__, __FILE__, fmt, ##__VA_ARGS__)
+    // 动态调试:按文件通配符、行号范围、日志器名称打开/关闭宏调用点
+    // mylog::EnableSites("net/*") 单独打开net目录下所有调用点,不受日志器等级限制
+    inline size_t EnableSites(const std::string &file, int from = 0, int to = INT_MAX, const std::string &logger = "")
+    {
+        return Log::CallSites::getInstance().enable(Log::SiteFilter(file, from, to, logger));
+    }
+    inline size_t DisableSites(const std::string &file, int from = 0, int to = INT_MAX, const std::string &logger = "")
+    {
+        return Log::CallSites::getInstance().disable(Log::SiteFilter(file, from, to, logger));
+    }
+    inline void ResetSites()
+    {
+        Log::CallSites::getInstance().reset();
+    }
+
+    // 按源文件设置等级,如 "net/*=DEBUG,db/pool.cpp=WARNING",为空时全部使用日志器等级
+    // 启动时从配置项 log.vmodule 读取,运行时可随时修改
+    inline bool SetVModule(const std::string &spec)
+    {
+        return Log::VModule::getInstance().set(spec);
+    }
+
+// 调用点:宏展开处的静态CallSite,编译期初始化,第一次执行时登记(见callsite.hpp)
+#define LOG_CALL_SITE(level) \
+    ([]() -> Log::CallSite & { static Log::CallSite site(__FILE__, __LINE__, level); return site; }())
+
+#define DEBUG(fmt, ...) Debug(LOG_CALL_SITE(Log::LogLevel::DEBUG), fmt, ##__VA_ARGS__)
+#define INFO(fmt, ...) Info(LOG_CALL_SITE(Log::LogLevel::INFO), fmt, ##__VA_ARGS__)
+#define WARNING(fmt, ...) Warning(LOG_CALL_SITE(Log::LogLevel::WARNING), fmt, ##__VA_ARGS__)
+#define ERRNO(fmt, ...) Errno(LOG_CALL_SITE(Log::LogLevel::ERRNO), fmt, ##__VA_ARGS__)
+#define FATAL(fmt, ...) Fatal(LOG_CALL_SITE(Log::LogLevel::FATAL), fmt, ##__VA_ARGS__)
 
 #define DEBUG_A(...) mylog::DefaultAsynLogger()->DEBUG(__VA_ARGS__)
 #define INFO_A(...) mylog::DefaultAsynLogger()->INFO(__VA_ARGS__)
@@ -44,4 +74,42 @@ namespace mylog
 #define ERRNO_S(...) mylog::DefaultSyncLogger()->ERRNO(__VA_ARGS__)
 #define FATAL_S(...) mylog::DefaultSyncLogger()->FATAL(__VA_ARGS__)
 
+// 调用点静态变量:每个lambda表达式类型不同,其中的静态变量只属于展开它的调用点
+#define LOG_SITE_STATIC(Type) ([]() -> Type & { static Type s; return s; }())
+#define LOG_LIMITED(level, Type, param, fmt, ...) \
+    Limited(LOG_SITE_STATIC(Type), param, LOG_CALL_SITE(level), fmt, ##__VA_ARGS__)
+
+// 每n条输出一条: logger->INFO_EVERY_N(1000, "重试 {}", n)
+#define DEBUG_EVERY_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::DEBUG, Log::Limit::EveryN, n, fmt, ##__VA_ARGS__)
+#define INFO_EVERY_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::INFO, Log::Limit::EveryN, n, fmt, ##__VA_ARGS__)
+#define WARNING_EVERY_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::WARNING, Log::Limit::EveryN, n, fmt, ##__VA_ARGS__)
+#define ERRNO_EVERY_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::ERRNO, Log::Limit::EveryN, n, fmt, ##__VA_ARGS__)
+#define FATAL_EVERY_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::FATAL, Log::Limit::EveryN, n, fmt, ##__VA_ARGS__)
+
+// 只输出前n条
+#define DEBUG_FIRST_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::DEBUG, Log::Limit::FirstN, n, fmt, ##__VA_ARGS__)
+#define INFO_FIRST_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::INFO, Log::Limit::FirstN, n, fmt, ##__VA_ARGS__)
+#define WARNING_FIRST_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::WARNING, Log::Limit::FirstN, n, fmt, ##__VA_ARGS__)
+#define ERRNO_FIRST_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::ERRNO, Log::Limit::FirstN, n, fmt, ##__VA_ARGS__)
+#define FATAL_FIRST_N(n, fmt, ...) LOG_LIMITED(Log::LogLevel::FATAL, Log::Limit::FirstN, n, fmt, ##__VA_ARGS__)
+
+// 每ms毫秒最多输出一条
+#define DEBUG_EVERY_MS(ms, fmt, ...) LOG_LIMITED(Log::LogLevel::DEBUG, Log::Limit::EveryMs, ms, fmt, ##__VA_ARGS__)
+#define INFO_EVERY_MS(ms, fmt, ...) LOG_LIMITED(Log::LogLevel::INFO, Log::Limit::EveryMs, ms, fmt, ##__VA_ARGS__)
+#define WARNING_EVERY_MS(ms, fmt, ...) LOG_LIMITED(Log::LogLevel::WARNING, Log::Limit::EveryMs, ms, fmt, ##__VA_ARGS__)
+#define ERRNO_EVERY_MS(ms, fmt, ...) LOG_LIMITED(Log::LogLevel::ERRNO, Log::Limit::EveryMs, ms, fmt, ##__VA_ARGS__)
+#define FATAL_EVERY_MS(ms, fmt, ...) LOG_LIMITED(Log::LogLevel::FATAL, Log::Limit::EveryMs, ms, fmt, ##__VA_ARGS__)
+
+// 令牌桶:平均每秒rate条,允许连续burst条
+#define DEBUG_RATE(rate, burst, fmt, ...) \
+    LOG_LIMITED(Log::LogLevel::DEBUG, Log::Limit::TokenBucket, (Log::Limit::TokenBucket::Param{double(rate), uint64_t(burst)}), fmt, ##__VA_ARGS__)
+#define INFO_RATE(rate, burst, fmt, ...) \
+    LOG_LIMITED(Log::LogLevel::INFO, Log::Limit::TokenBucket, (Log::Limit::TokenBucket::Param{double(rate), uint64_t(burst)}), fmt, ##__VA_ARGS__)
+#define WARNING_RATE(rate, burst, fmt, ...) \
+    LOG_LIMITED(Log::LogLevel::WARNING, Log::Limit::TokenBucket, (Log::Limit::TokenBucket::Param{double(rate), uint64_t(burst)}), fmt, ##__VA_ARGS__)
+#define ERRNO_RATE(rate, burst, fmt, ...) \
+    LOG_LIMITED(Log::LogLevel::ERRNO, Log::Limit::TokenBucket, (Log::Limit::TokenBucket::Param{double(rate), uint64_t(burst)}), fmt, ##__VA_ARGS__)
+#define FATAL_RATE(rate, burst, fmt, ...) \
+    LOG_LIMITED(Log::LogLevel::FATAL, Log::Limit::TokenBucket, (Log::Limit::TokenBucket::Param{double(rate), uint64_t(burst)}), fmt, ##__VA_ARGS__)
+
 }
@@ -1,7 +1,10 @@
 #pragma once
 #include <string>
 #include <cstddef>
+#include <cstring>
+#include <ctime>
 #include "ConfigManager.hpp"
+#include "reload.hpp"
 #include "level.hpp"
 
 /*
@@ -9,7 +12,8 @@
 */
 namespace Log
 {
-    class Data
+    // 枚举类型及其转换定义在ConfigEnums中(ConfigManager.hpp),配置快照加载时即转换为枚举
+    class Data : public ConfigEnums
     {
     private:
         static bool &initialized()
@@ -31,52 +35,62 @@ namespace Log
         {
             return ConfigManager::getInstance();
         }
+        // 当前配置快照:加载之后每次读取只有一次指针加载
+        static const ConfigManager::Snapshot &config()
+        {
+            const ConfigManager::Snapshot *snap = ConfigManager::current();
+            if (snap)
+                return *snap;
+            ensureInitialized();
+            return configManager().snapshot();
+        }
         // 这些可以保持为静态常量
         static constexpr const char *ASYN = "ASYNLOGGER";
         static constexpr const char *SYNC = "SYNCLOGGER";
         static constexpr const char *PropertiesName = "../config/.properties";
+        // JSON lines输出格式
+        static constexpr const char *JSONLINES = "%J%n";
+        // 二进制输出格式,BinaryFileSink默认使用
+        static constexpr const char *BINARY = "%B";
 
-        enum LogGerType
-        {
-            SYNCLOGGER,
-            ASYNLOGGER
-        };
-
-        enum AnsyCtrlType
-        {
-            COMMON,
-            THPOOL
-        };
-
-        static const LogGerType StoLogGerType(const std::string &s)
-        {
-            if (s == "SYNCLOGGER")
-                return SYNCLOGGER;
-            else
-                return ASYNLOGGER;
-        }
-
-        static const AnsyCtrlType StoAnsyCtrlType(const std::string &s)
-        {
-            if (s == "COMMON")
-                return COMMON;
-            else
-                return THPOOL;
-        }
         // 使用静态函数返回配置值
         static const std::string GetFormatTime(const time_t &nowt, const char *format = Data::defaultTF())
         {
-            struct tm *t = localtime(&nowt);
-            if (t)
+            char buffer[80];
+            size_t n = FormatTime(buffer, sizeof(buffer), nowt, format);
+            return std::string(buffer, n);
+        }
+        // 写入调用者提供的缓冲区,返回长度;同一线程同一秒的结果被缓存
+        static size_t FormatTime(char *buf, size_t size, const time_t &nowt, const char *format = Data::defaultTF())
+        {
+            struct Cache
             {
-                char buffer[80];
-                strftime(buffer, sizeof(buffer), format, t);
-                return buffer;
-            }
-            else
+                time_t time = -1;
+                char format[64] = "";
+                char text[80];
+                size_t size = 0;
+            };
+            static thread_local Cache cache;
+            bool cached = cache.time == nowt && strcmp(cache.format, format) == 0;
+            if (!cached)
             {
-                return "";
+                struct tm t;
+#ifdef _WIN32
+                bool ok = localtime_s(&t, &nowt) == 0;
+#else
+                bool ok = localtime_r(&nowt, &t) != nullptr;
+#endif
+                cache.size = ok ? strftime(cache.text, sizeof(cache.text), format, &t) : 0;
+                // 过长的格式串不缓存
+                bool fits = strlen(format) < sizeof(cache.format);
+                cache.time = fits ? nowt : -1;
+                if (fits)
+                    strcpy(cache.format, format);
             }
+            size_t n = cache.size < size ? cache.size : size - 1;
+            memcpy(buf, cache.text, n);
+            buf[n] = '\0';
+            return n;
         }
 
         // 确保toString方法存在 - 修复format.hpp中的错误
@@ -95,6 +109,9 @@ namespace Log
 
             bool loaded = configManager().loadConfig(configFile);
             initialized() = true;
+            // 配置了检查间隔时在后台监视配置文件
+            if (configManager().snapshot().RELOAD_INTERVAL > 0)
+                ConfigWatcher::getInstance().start(configManager().snapshot().RELOAD_INTERVAL);
 
             return loaded;
         }
@@ -108,38 +125,78 @@ namespace Log
     X(const char *, defaultformat, FORMAT)              \
     X(const char *, defaultFileTF, FILE_TIME_FORMAT)    \
     X(const char *, defaultBFile, BASE_FILE_NAME)       \
+    X(const char *, vmodule, VMODULE)                   \
     X(const char *, defaultFix, FILE_EXTENSION)         \
     X(const char, BoundSymbol, BOUND_SYMBOL)            \
-    X(const size_t, MaxFileSerial, MAX_FILE_SERIAL)     \
     X(const size_t, threadCount, THREAD_COUNT)          \
-    X(const size_t, Exceed_size, EXCEED_SIZE)
-
-// 生成简单getter方法的宏
+    X(const size_t, Exceed_size, EXCEED_SIZE)           \
+    X(const size_t, retainCount, RETAIN_COUNT)          \
+    X(const size_t, retainBytes, RETAIN_BYTES)          \
+    X(const size_t, retainSeconds, RETAIN_SECONDS)      \
+    X(const size_t, compressThreads, COMPRESS_THREADS)  \
+    X(const size_t, compressNice, COMPRESS_NICE)        \
+    X(const size_t, backtraceSize, BACKTRACE_SIZE)      \
+    X(const size_t, scratchSize, SCRATCH_SIZE)          \
+    X(const size_t, recordPoolSize, RECORD_POOL_SIZE)   \
+    X(const size_t, totalBufferBudget, TOTAL_BUFFER_BUDGET) \
+    X(const char *, metricsTarget, METRICS_TARGET)      \
+    X(const size_t, metricsInterval, METRICS_INTERVAL)  \
+    X(const size_t, latencySample, LATENCY_SAMPLE)      \
+    X(const char *, profileTrace, PROFILE_TRACE)        \
+    X(const size_t, profileTraceEvents, PROFILE_TRACE_EVENTS) \
+    X(const size_t, reloadInterval, RELOAD_INTERVAL)
+
+// 生成简单getter方法的宏,直接读取快照中的类型化字段
 #define GENERATE_SIMPLE_GETTER(ReturnType, MethodName, ConfigName) \
     static ReturnType MethodName()                                 \
     {                                                              \
-        ensureInitialized();                                       \
-        return configManager().get##ConfigName();                  \
+        return Field(config().ConfigName);                         \
     }
 
+        // 字符串配置项返回快照中的指针,快照一直保留
+        static const char *Field(const std::string &value) { return value.c_str(); }
+        template <class T>
+        static T Field(T value) { return value; }
+
         // 自动生成所有简单的getter方法
         DATA_CONFIG_ITEMS(GENERATE_SIMPLE_GETTER)
 
-        // 手动实现需要特殊处理的方法
+        // 枚举配置项在快照加载时已经转换,这里只读取字段
         static const LogGerType DLoggerType()
         {
-            ensureInitialized();
-            return StoLogGerType(configManager().getDLOGGER_TYPE());
+            return config().DLOGGER_TYPE;
         }
         static const AnsyCtrlType DAnsyCtrlType()
         {
-            ensureInitialized();
-            return StoAnsyCtrlType(configManager().getDANSY_CTRL_TYPE());
+            return config().DANSY_CTRL_TYPE;
+        }
+        static const RollInterval rollInterval()
+        {
+            return config().ROLL_INTERVAL;
+        }
+        static const CompressType compressType()
+        {
+            return config().COMPRESS;
+        }
+        static const OverflowPolicy overflowPolicy()
+        {
+            return config().OVERFLOW_POLICY;
+        }
+        static const BufferPages bufferPages()
+        {
+            return config().BUFFER_PAGES;
+        }
+        static const bool bufferMlock()
+        {
+            return config().BUFFER_MLOCK != 0;
+        }
+        static const LogLevel::VALUE backtraceLevel()
+        {
+            return config().BACKTRACE_LEVEL;
         }
         static const LogLevel::VALUE DLevel()
         {
-            ensureInitialized();
-            return LogLevel::StoLevel(configManager().getDLEVEL());
+            return config().DLEVEL;
         }
 
 // 清理宏定义
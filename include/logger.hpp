@@ -4,7 +4,14 @@
 #include "level.hpp"
 #include "message.hpp"
 #include "sink.hpp"
+#include "channel.hpp"
 #include "ParseFormat.hpp"
+#include "backtrace.hpp"
+#include "limit.hpp"
+#include "callsite.hpp"
+#include "vmodule.hpp"
+#include "pool.hpp"
+#include "topology.hpp"
 #include <atomic>
 #include <cstdarg>
 #include <mutex>
@@ -18,10 +25,28 @@
     4.通过建造这模式返回对象
     5.局部日志
     6.全局日志
+    7.回溯缓冲:被过滤的日志留在内存中,出错时再输出
+    8.日志记录取自记录池(pool.hpp),不使用全局堆
+    9.按log.latency_sample每N条采样一条,统计调用耗时和到写入落地方向的延迟
+    10.定义LOG_PROFILE编译时按阶段统计耗时(profile.hpp)
+    11.配置热加载:每次记录日志比较一次配置版本号,变化时由当前线程应用新配置(reload.hpp)
+    12.配置文件中声明的日志器在全局管理第一次使用时一次性创建(topology.hpp)
 */
 
 namespace Log
 {
+  // 日志器的统计快照
+  struct LoggerStats
+  {
+    std::string name;
+    uint64_t accepted;        // 通过等级过滤并交给落地方向的日志条数
+    uint64_t filtered;        // 被等级过滤(或没有落地方向接收)的日志条数
+    uint64_t dropped;         // 各落地方向因缓冲区写满丢弃的条数之和
+    uint64_t formatted_bytes; // 格式化产生的字节数(每种格式计一次)
+    LatencyStats call;        // 被采样日志调用本身的耗时
+    std::vector<ChannelStats> sinks; // 顺序与getSink()一致
+  };
+
   namespace LogGer
   {
 
@@ -31,16 +56,32 @@ namespace Log
       typedef std::vector<Sink::ptr> VSPtr;
       typedef Format::FormatBase::ptr FPtr;
       typedef std::shared_ptr<Logger> ptr;
-
-    protected:
-      virtual void log(const std::string &) = 0;
+      // 去重后的格式化器,以及每个通道使用的格式化器下标
+      struct FormatSet
+      {
+        std::vector<std::shared_ptr<Formatctrl>> formatters;
+        std::vector<size_t> chfmt;
+        bool packargs = false; // 有二进制格式,需要打包原始参数
+        bool needtext = false; // 有文本格式,需要替换{}
+      };
 
     public:
       Logger(const LogLevel::VALUE &value, const Data::LogGerType &loggertype,
              const VSPtr &vsptr, const FPtr &fptr, const std::string &loggername)
           : _value(value), _loggertype(loggertype),
             _vsptr(vsptr.begin(), vsptr.end()), _fptr(fptr),
-            _loggername(loggername), _parseformat(std::make_shared<ParseFormat>()) {}
+            _loggername(loggername),
+            _backtrace(nullptr), _bttrigger(LogLevel::ERRNO), _vmodule(VModule::getInstance()),
+            _sample(Data::latencySample()),
+            _cfgversion(Data::config().version), _cfgapplied(&Data::config())
+      {
+#ifdef LOG_PROFILE
+        _profiler = std::make_shared<Profiler>(loggername);
+#endif
+        if (Data::backtraceSize() > 0)
+          EnableBacktrace(Data::backtraceSize(), Data::backtraceLevel());
+        _siteid = CallSites::getInstance().loggerId(_loggername);
+      }
       virtual ~Logger() {}
       const std::string &GetLoggerName() const { return _loggername; }
 
@@ -48,76 +89,491 @@ namespace Log
       void Debug(int line, const std::string &filename, std::string format,
                  Args... args)
       {
-        if (LogLevel::DEBUG < _value || format.empty())
-          return;
-        
-        std::string fmt = _parseformat->parse(format, std::forward<Args>(args)...);
-        msgFLog(line, LogLevel::DEBUG, filename, fmt);
+        Submit(LogLevel::DEBUG >= Level(), line, LogLevel::DEBUG, filename.c_str(), StrView(format), args...);
+      }
+      // 日志宏使用的版本,带调用点状态
+      template <class... Args>
+      void Debug(CallSite &site, StrView format, const Args &...args)
+      {
+        int st = SiteState(site);
+        if (st != CallSite::OFF)
+          Submit(Passes(site, st), site.line, LogLevel::DEBUG, site.file, format, args...);
+        else
+          _filtered.add();
       }
 
       template <class... Args>
       void Info(int line, const std::string &filename, std::string format,
                 Args... args)
       {
-        if (LogLevel::INFO < _value || format.empty())
-          return;
-        
-        std::string fmt = _parseformat->parse(format, std::forward<Args>(args)...);
-        msgFLog(line, LogLevel::INFO, filename, fmt);
+        Submit(LogLevel::INFO >= Level(), line, LogLevel::INFO, filename.c_str(), StrView(format), args...);
+      }
+      // 日志宏使用的版本,带调用点状态
+      template <class... Args>
+      void Info(CallSite &site, StrView format, const Args &...args)
+      {
+        int st = SiteState(site);
+        if (st != CallSite::OFF)
+          Submit(Passes(site, st), site.line, LogLevel::INFO, site.file, format, args...);
+        else
+          _filtered.add();
       }
 
       template <class... Args>
       void Warning(int line, const std::string &filename, std::string format,
                    Args... args)
       {
-        if (LogLevel::WARNING < _value || format.empty())
-          return;
-        
-        std::string fmt = _parseformat->parse(format, std::forward<Args>(args)...);
-        msgFLog(line, LogLevel::WARNING, filename, fmt);
+        Submit(LogLevel::WARNING >= Level(), line, LogLevel::WARNING, filename.c_str(), StrView(format), args...);
+      }
+      // 日志宏使用的版本,带调用点状态
+      template <class... Args>
+      void Warning(CallSite &site, StrView format, const Args &...args)
+      {
+        int st = SiteState(site);
+        if (st != CallSite::OFF)
+          Submit(Passes(site, st), site.line, LogLevel::WARNING, site.file, format, args...);
+        else
+          _filtered.add();
       }
 
       template <class... Args>
       void Errno(int line, const std::string &filename, std::string format,
                  Args... args)
       {
-        if (LogLevel::ERRNO < _value || format.empty())
-          return;
-        
-        std::string fmt = _parseformat->parse(format, std::forward<Args>(args)...);
-        msgFLog(line, LogLevel::ERRNO, filename, fmt);
+        Submit(LogLevel::ERRNO >= Level(), line, LogLevel::ERRNO, filename.c_str(), StrView(format), args...);
+      }
+      // 日志宏使用的版本,带调用点状态
+      template <class... Args>
+      void Errno(CallSite &site, StrView format, const Args &...args)
+      {
+        int st = SiteState(site);
+        if (st != CallSite::OFF)
+          Submit(Passes(site, st), site.line, LogLevel::ERRNO, site.file, format, args...);
+        else
+          _filtered.add();
       }
 
       template <class... Args>
       void Fatal(int line, const std::string &filename, std::string format,
                  Args... args)
       {
-        if (LogLevel::FATAL < _value || format.empty())
+        Submit(LogLevel::FATAL >= Level(), line, LogLevel::FATAL, filename.c_str(), StrView(format), args...);
+      }
+      // 日志宏使用的版本,带调用点状态
+      template <class... Args>
+      void Fatal(CallSite &site, StrView format, const Args &...args)
+      {
+        int st = SiteState(site);
+        if (st != CallSite::OFF)
+          Submit(Passes(site, st), site.line, LogLevel::FATAL, site.file, format, args...);
+        else
+          _filtered.add();
+      }
+      // 限流输出,limiter为调用点的静态状态(见log.hpp中的*_EVERY_N等宏)
+      // 被抑制过的调用点在下一条输出中附带 suppressed=被抑制条数 字段
+      template <class Limiter, class Param, class... Args>
+      void Limited(Limiter &limiter, const Param &param, CallSite &site,
+                   StrView format, const Args &...args)
+      {
+        int st = SiteState(site);
+        if (st == CallSite::OFF)
+        {
+          _filtered.add();
+          return;
+        }
+        bool pass = Passes(site, st);
+        // 等级过滤掉且没有回溯缓冲时不消耗限流额度
+        if (!pass && !_backtrace.load(std::memory_order_relaxed))
+        {
+          _filtered.add();
           return;
-        
-        std::string fmt = _parseformat->parse(format, std::forward<Args>(args)...);
-        msgFLog(line, LogLevel::FATAL, filename, fmt);
+        }
+        uint64_t suppressed = 0;
+        if (!limiter.allow(param, suppressed))
+          return;
+        if (suppressed)
+          Submit(pass, site.line, site.level, site.file, format, args..., kv("suppressed", suppressed));
+        else
+          Submit(pass, site.line, site.level, site.file, format, args...);
       }
+
       const VSPtr getSink() const { return _vsptr; }
 
+      // 开启回溯缓冲:被等级过滤的日志保留最近capacity条,
+      // 记录不低于trigger的日志前先按原顺序输出到所有落地方向
+      void EnableBacktrace(size_t capacity, LogLevel::VALUE trigger = LogLevel::ERRNO)
+      {
+        std::unique_lock<std::mutex> lock(_btmutex);
+        _bttrigger = trigger;
+        BacktraceRing *cur = _backtrace.load();
+        if (cur && cur->capacity() == capacity)
+          return;
+        // 其他线程可能仍在使用旧的缓冲区,旧缓冲区随日志器一起释放
+        _btrings.emplace_back(new BacktraceRing(capacity));
+        _backtrace.store(_btrings.back().get());
+      }
+      void DisableBacktrace() { _backtrace.store(nullptr); }
+
+      // 立即输出回溯缓冲中的日志并清空
+      // 先在缓冲区的锁内复制到记录池的记录中,再在锁外写入落地方向,写完后整批归还
+      void DumpBacktrace()
+      {
+        BacktraceRing *bt = _backtrace.load();
+        if (!bt)
+          return;
+        RecordPool &pool = RecordPool::getInstance();
+        std::vector<PooledRecord *> batch;
+        batch.reserve(bt->capacity());
+        bt->drain([&](const Deferred &d)
+                  {
+          PooledRecord *rec = pool.acquire();
+          Message &msg = rec->msg;
+          msg._time = d.time;
+          msg._line = d.line;
+          msg._value = d.level;
+          msg._tid = d.tid;
+          msg._filename.assign(d.filename);
+          msg._loggertype = _loggertype;
+          msg._loggername.assign(_loggername);
+          msg._fields = FieldList();
+          msg._stamp = 0;
+          rec->format.assign(d.format);
+          rec->packed.assign(d.packed);
+          rec->context.assign(d.context);
+          batch.push_back(rec); });
+        const FormatSet &fs = *_fmtset.load(std::memory_order_acquire);
+        for (PooledRecord *rec : batch)
+        {
+          Message &msg = rec->msg;
+          msg._content.clear();
+          // kv字段与实时输出一样作为字段传给格式化器,不拼进内容
+          if (fs.needtext && !Binary::Render(rec->format, rec->packed.data(), rec->packed.size(), msg._content, false))
+            continue;
+          if (!Binary::Fields(rec->packed.data(), rec->packed.size(), rec->fields, rec->keys))
+            continue;
+          msg._fields = FieldList(rec->fields.data(), rec->fields.size());
+          msg._rawformat = StrView(rec->format);
+          msg._packed = &rec->packed;
+          msg._context = &rec->context;
+          Dispatch(fs, msg, rec->out, true);
+        }
+        pool.release(batch.data(), batch.size());
+      }
+
+      // 日志器和各落地方向的统计快照
+      LoggerStats stats() const
+      {
+        LoggerStats st;
+        st.name = _loggername;
+        st.accepted = _accepted;
+        st.filtered = _filtered;
+        st.formatted_bytes = _formatted;
+        st.call = _call_latency.stats();
+        st.sinks = getSinkStats();
+        st.dropped = 0;
+        for (auto &s : st.sinks)
+          st.dropped += s.dropped;
+        return st;
+      }
+
+      // 每n条日志采样一条统计延迟(按线程计数),0为关闭
+      void SetLatencySample(size_t n) { _sample.store(n, std::memory_order_relaxed); }
+      size_t GetLatencySample() const { return _sample.load(std::memory_order_relaxed); }
+      // 被采样日志调用本身的耗时;到写入落地方向的延迟见getSinkStats()[i].latency
+      LatencyStats getCallLatency() const { return _call_latency.stats(); }
+
+      // 分阶段耗时,只在定义LOG_PROFILE编译时不为空
+      const Profiler::ptr &getProfiler() const { return _profiler; }
+
+      // 该日志器所有异步缓冲区从全局预算借用的字节数
+      size_t getBufferBytes() const
+      {
+        size_t n = 0;
+        for (auto &ch : _channels)
+          n += ch->ansyctrl() ? ch->ansyctrl()->bufferBytes() : 0;
+        return n;
+      }
+
+      // 记录池的使用情况(所有日志器共享一个池)
+      PoolStats getPoolStats() const { return RecordPool::getInstance().stats(); }
+
+      // 各落地方向的写入统计,顺序与getSink()一致
+      std::vector<ChannelStats> getSinkStats() const
+      {
+        std::vector<ChannelStats> stats;
+        for (auto &ch : _channels)
+          stats.push_back(ch->stats());
+        return stats;
+      }
+
+    protected:
+      // 按落地方向的输出格式分组,相同格式的落地方向共享一个格式化器
+      // 需要在子类创建完通道后调用;热加载修改格式时重新调用,
+      // 其他线程可能仍在使用旧的一组(例如BLOCK时在通道中等待),替换下来的保留到日志器销毁;
+      // 只有配置中的格式真正变化时才会替换,保留的组数等于该日志器经历的格式变化次数
+      void InitFormatters()
+      {
+        std::shared_ptr<Formatctrl> def = std::dynamic_pointer_cast<Formatctrl>(_fptr);
+        if (!def)
+          def = std::make_shared<Formatctrl>();
+        std::unique_ptr<FormatSet> fs(new FormatSet);
+        for (auto &ch : _channels)
+        {
+          const std::string &pattern = ch->sink()->GetPattern();
+          std::shared_ptr<Formatctrl> fc = pattern.empty() ? def : std::make_shared<Formatctrl>(pattern);
+          size_t idx = 0;
+          while (idx < fs->formatters.size() && fs->formatters[idx]->pattern() != fc->pattern())
+            ++idx;
+          if (idx == fs->formatters.size())
+            fs->formatters.push_back(fc);
+          fs->chfmt.push_back(idx);
+          // 二进制格式需要原始参数,只有二进制格式时不必替换{}生成文本
+          if (fc->pattern().find(Data::BINARY) != std::string::npos)
+            fs->packargs = true;
+          if (fc->pattern() != Data::BINARY)
+            fs->needtext = true;
+        }
+        _fmtsets.push_back(std::move(fs));
+        _fmtset.store(_fmtsets.back().get(), std::memory_order_release);
+      }
+
+
+      // 是否有落地方向接收该等级,没有则连格式化都可以省去
+      bool Accepts(LogLevel::VALUE value) const
+      {
+        for (auto &ch : _channels)
+        {
+          if (value >= ch->sink()->GetLevel())
+            return true;
+        }
+        return false;
+      }
+
     private:
-      void msgFLog(int line, const LogLevel::VALUE &value,
-                   const std::string &filename, const std::string &con)
+      // 调用点第一次执行时登记;第一个执行它的日志器之后只有两次relaxed读取
+      int SiteState(CallSite &site)
+      {
+        Refresh();
+        int st = site.state.load(std::memory_order_relaxed);
+        if (st != CallSite::UNREGISTERED && site.logger.load(std::memory_order_relaxed) == _siteid)
+          return st;
+        return CallSites::getInstance().state(site, _siteid);
+      }
+
+      // 配置文件重新加载后,由第一个记录日志的线程应用新配置,平时只比较一次快照版本
+      void Refresh()
+      {
+        const ConfigManager::Snapshot *cur = ConfigManager::current();
+        if (cur && cur->version != _cfgversion.load(std::memory_order_relaxed))
+          ApplyConfig();
+      }
+      LogLevel::VALUE Level()
+      {
+        Refresh();
+        return _value.load(std::memory_order_relaxed);
+      }
+
+      // 只有仍与旧配置相同的设置跟随配置变化,在代码中单独设置过的保持不变
+      // 其他线程正在应用时直接返回,本条日志按旧配置记录
+      void ApplyConfig()
+      {
+        std::unique_lock<std::mutex> lock(_cfgmutex, std::try_to_lock);
+        if (!lock.owns_lock())
+          return;
+        const ConfigManager::Snapshot *cur = ConfigManager::current();
+        const ConfigManager::Snapshot &prev = *_cfgapplied;
+        if (!cur || cur == &prev)
+          return;
+        const ConfigManager::Snapshot &next = *cur;
+        // 等级
+        if (prev.DLEVEL != next.DLEVEL && _value.load() == prev.DLEVEL)
+          _value.store(next.DLEVEL);
+        // 日志器的默认格式,设置了单独格式的落地方向不受影响
+        std::shared_ptr<Formatctrl> def = std::dynamic_pointer_cast<Formatctrl>(_fptr);
+        if (prev.FORMAT != next.FORMAT && def && def->pattern() == prev.FORMAT)
+        {
+          _fptr = std::make_shared<Formatctrl>(next.FORMAT);
+          InitFormatters();
+        }
+        // 缓冲区写满时的处理方式和滚动文件的大小阈值
+        // 落地方向可能被多个日志器共用,每个通道按自己的设置判断,不受其他日志器先应用的影响
+        Data::OverflowPolicy oldpolicy = prev.OVERFLOW_POLICY;
+        Data::OverflowPolicy newpolicy = next.OVERFLOW_POLICY;
+        for (auto &ch : _channels)
+        {
+          const Sink::ptr &sink = ch->sink();
+          if (oldpolicy != newpolicy)
+          {
+            if (sink->GetOverflow() == oldpolicy)
+              sink->SetOverflow(newpolicy);
+            if (ch->ansyctrl() && ch->ansyctrl()->overflow() == oldpolicy)
+              ch->ansyctrl()->setOverflow(newpolicy);
+          }
+          std::shared_ptr<SinkWay::RollFileSink> roll = std::dynamic_pointer_cast<SinkWay::RollFileSink>(sink);
+          if (roll && prev.MAX_LOGFILE_SIZE != next.MAX_LOGFILE_SIZE && roll->GetMaxSize() == prev.MAX_LOGFILE_SIZE)
+            roll->SetMaxSize(next.MAX_LOGFILE_SIZE);
+        }
+        _cfgapplied = cur;
+        _cfgversion.store(next.version, std::memory_order_relaxed);
+      }
+
+      // 调用点被单独打开时直接通过,否则按模块等级规则,没有匹配的规则时按日志器等级
+      bool Passes(CallSite &site, int st)
+      {
+        if (st == CallSite::ON)
+          return true;
+        LogLevel::VALUE lv = _vmodule.level(site);
+        return site.level >= (lv != LogLevel::UNKNOW ? lv : _value.load(std::memory_order_relaxed));
+      }
+
+      // pass: 是否通过等级过滤
+      template <class... Args>
+      void Submit(bool pass, int line, LogLevel::VALUE value, const char *filename,
+                  StrView format, const Args &...args)
+      {
+        if (format.empty())
+          return;
+        BacktraceRing *bt = _backtrace.load(std::memory_order_acquire);
+        if (!pass || !Accepts(value))
+        {
+          _filtered.add();
+          // 被过滤的日志只打包参数放入回溯缓冲
+          if (bt)
+            bt->push(line, value, filename, format, args...);
+          return;
+        }
+        if (bt && value >= _bttrigger)
+          DumpBacktrace();
+        _accepted.add();
+        LOG_PROFILE_SCOPE(_profiler.get(), CALL);
+        uint64_t stamp = Sampled() ? Histogram::Now() : 0;
+        Record(line, value, filename, stamp, format, args...);
+        if (stamp)
+          _call_latency.record(Histogram::Now() - stamp);
+      }
+
+      // 每个线程按日志器分别计数:以日志器编号取线程内的计数槽,
+      // 前SampleSlots个日志器互不影响,更多日志器时编号同余的共用一个槽
+      enum
+      {
+        SampleSlots = 16
+      };
+      bool Sampled()
+      {
+        size_t n = _sample.load(std::memory_order_relaxed);
+        if (!n)
+          return false;
+        static thread_local size_t ticks[SampleSlots] = {};
+        size_t &tick = ticks[_siteid % SampleSlots];
+        if (++tick < n)
+          return false;
+        tick = 0;
+        return true;
+      }
+
+      // 参数中的kv字段作为结构化字段保持原始类型传给格式化器,其余参数替换{}
+      // 参数直接写入池中的记录,稳定后整个过程不分配内存
+      template <class... Args>
+      void Record(int line, LogLevel::VALUE value, const char *filename, uint64_t stamp,
+                  StrView format, const Args &...args)
+      {
+        Field fields[FieldCount<Args...>::value + 1];
+        size_t n = 0;
+        CollectFields(fields, n, args...);
+        // 记录取自记录池,同一线程反复复用;格式化中再次记录日志时取另一条
+        RecordPool::Lease lease;
+        PooledRecord &rec = lease.get();
+        Message &msg = rec.msg;
+        msg._time = tool::Date::GetTime();
+        msg._line = line;
+        msg._value = value;
+        msg._tid = std::this_thread::get_id();
+        msg._filename.assign(filename);
+        msg._loggertype = _loggertype;
+        msg._loggername.assign(_loggername);
+        msg._content.clear();
+        // 同一条日志始终使用同一组格式化器
+        const FormatSet &fs = *_fmtset.load(std::memory_order_acquire);
+        if (fs.needtext)
+        {
+          LOG_PROFILE_SCOPE(_profiler.get(), PARSE);
+          ParseFormat::Format(msg._content, format, args...);
+        }
+        msg._fields = FieldList(fields, n);
+        msg._rawformat = StrView();
+        msg._packed = nullptr;
+        msg._context = &MDC::Current();
+        msg._stamp = stamp;
+        if (fs.packargs)
+        {
+          // 参数按原始类型打包
+          rec.packed.clear();
+          Binary::Pack(rec.packed, args...);
+          msg._rawformat = format;
+          msg._packed = &rec.packed;
+        }
+        Dispatch(fs, msg, rec.out);
+      }
+
+      // force为true时忽略落地方向的等级(回溯缓冲输出)
+      // replay为回溯缓冲的输出,只有设置了SetBacktraceAll的落地方向接收低于其等级的日志
+      void Dispatch(const FormatSet &fs, const Message &msg, std::string &out, bool replay = false)
       {
-        Message msg(line, value, filename, _loggertype, _loggername, con);
-        std::stringstream ss;
-        Formatctrl fc;
-        log(fc.format(msg));
+        LogLevel::VALUE value = msg._value;
+        // 每种格式只格式化一次,再分发给使用该格式且接收该等级的落地方向
+        for (size_t f = 0; f < fs.formatters.size(); ++f)
+        {
+          bool formatted = false;
+          for (size_t i = 0; i < _channels.size(); ++i)
+          {
+            if (fs.chfmt[i] != f)
+              continue;
+            const Sink::ptr &sink = _channels[i]->sink();
+            if (value < sink->GetLevel() && !(replay && sink->GetBacktraceAll()))
+              continue;
+            if (!formatted)
+            {
+              out.clear();
+              LOG_PROFILE_SCOPE(_profiler.get(), FORMAT);
+              fs.formatters[f]->format(out, msg);
+              _formatted.add(out.size());
+              formatted = true;
+            }
+            LOG_PROFILE_SCOPE(_profiler.get(), PUSH);
+            _channels[i]->push(out, msg._stamp);
+          }
+        }
       }
 
     protected:
       std::atomic<LogLevel::VALUE> _value;
       Data::LogGerType _loggertype;
       std::string _loggername;
-      std::shared_ptr<ParseFormat> _parseformat;
       VSPtr _vsptr;
       FPtr _fptr;
-      std::mutex _mutex;
+      // 每个落地方向一个通道,互不阻塞
+      std::vector<SinkChannel::ptr> _channels;
+      // 当前使用的格式化器;替换下来的保留到日志器销毁,其他线程可能仍在使用
+      std::atomic<const FormatSet *> _fmtset{nullptr};
+      std::vector<std::unique_ptr<FormatSet>> _fmtsets;
+      // 回溯缓冲,为空表示关闭;替换下来的缓冲区保留到日志器销毁
+      std::atomic<BacktraceRing *> _backtrace;
+      std::atomic<LogLevel::VALUE> _bttrigger;
+      std::mutex _btmutex;
+      std::vector<std::unique_ptr<BacktraceRing>> _btrings;
+      VModule &_vmodule;
+      uint32_t _siteid; // 调用点状态按日志器编号区分(见callsite.hpp)
+      // 统计计数器,各占一个缓存行
+      Counter _accepted;
+      Counter _filtered;
+      Counter _formatted;
+      std::atomic<size_t> _sample;
+      Histogram _call_latency;
+      Profiler::ptr _profiler;
+      // 已经应用的配置快照(快照一直保留),用于与新快照比较;版本号供记录日志时比较
+      std::mutex _cfgmutex;
+      std::atomic<size_t> _cfgversion;
+      const ConfigManager::Snapshot *_cfgapplied;
     };
 
     class SyncLogger : public Logger
@@ -126,46 +582,35 @@ namespace Log
       SyncLogger(const LogLevel::VALUE &value, const Data::LogGerType &loggertype,
                  const VSPtr &vsptr, const FPtr &fptr,
                  const std::string &loggername)
-          : Logger(value, loggertype, vsptr, fptr, loggername) {}
-      void log(const std::string &str) override
+          : Logger(value, loggertype, vsptr, fptr, loggername)
       {
-        std::unique_lock<std::mutex> lock(_mutex);
+        // 每个通道各自加锁,不同落地方向可以被不同线程同时写入
         for (auto &sink : _vsptr)
-        {
-          sink->WriteFile(str);
-        }
+          _channels.push_back(std::make_shared<SinkChannel>(sink, nullptr, _profiler));
+        InitFormatters();
       }
     };
 
     class AnsyLogger : public Logger
     {
     public:
+      // creator为每个落地方向创建独立的线程控制器
+      // ansyctrl不为空时作为第一个落地方向的控制器使用
       AnsyLogger(const LogLevel::VALUE &value, const Data::LogGerType &loggertype,
                  const VSPtr &vsptr, const FPtr &fptr,
                  const std::string &loggername,
-                 const ACtrl::AnsyCtrl::ptr &ansyctrl)
-          : Logger(value, loggertype, vsptr, fptr, loggername),
-            _ansyctrl(ansyctrl)
-      {
-        _ansyctrl->bindcallbackf(
-            std::bind(&AnsyLogger::AnsySink, this, std::placeholders::_1));
-      }
-      ~AnsyLogger() override {}
-      void log(const std::string &str) override
-      {
-        _ansyctrl->push(str);
-      }
-      void AnsySink(const std::string &buf)
+                 const ACtrlFactory::Creator &creator,
+                 const ACtrl::AnsyCtrl::ptr &ansyctrl = nullptr)
+          : Logger(value, loggertype, vsptr, fptr, loggername)
       {
-        std::unique_lock<std::mutex> lock(_mutex);
-        for (auto &sink : _vsptr)
+        for (size_t i = 0; i < _vsptr.size(); ++i)
         {
-          sink->WriteFile(buf);
+          ACtrl::AnsyCtrl::ptr ctrl = (i == 0 && ansyctrl) ? ansyctrl : creator();
+          _channels.push_back(std::make_shared<SinkChannel>(_vsptr[i], ctrl, _profiler));
         }
+        InitFormatters();
       }
-
-    private:
-      ACtrl::AnsyCtrl::ptr _ansyctrl;
+      ~AnsyLogger() override {}
     };
 
     class LoggerBuilder
@@ -180,6 +625,7 @@ namespace Log
         _loggername = loggername;
       }
       void InitAnsyCtrlWay(ACtrl::AnsyCtrl::ptr ansyctrl) { _ansyctrl = ansyctrl; }
+      void InitAnsyCtrlCreator(const ACtrlFactory::Creator &creator) { _creator = creator; }
       void InitSinkWay(const Logger::VSPtr &vsptr) { _vsptr = vsptr; }
       void InitSinkWay(Sink::ptr sptr) { _vsptr.push_back(sptr); }
       void InitFormat(const std::string &format)
@@ -211,20 +657,16 @@ namespace Log
         if (!isTypeTrue())
           _loggertype = Data::ASYNLOGGER;
 
-        if (!_ansyctrl)
+        if (!_creator)
         {
-          if (_ACType == Data::AnsyCtrlType::THPOOL &&
-              _loggertype == Data::ASYNLOGGER)
-            _ansyctrl = ACtrlFactory::AnsyThpool();
-          else
-            _ansyctrl = ACtrlFactory::AnsyCommon();
+          _creator = ACtrlFactory::CreatorOf(_ACType);
         }
 
         if (_loggertype == Data::ASYNLOGGER)
         {
           _loggertype = Data::ASYNLOGGER;
           return std::make_shared<LogGer::AnsyLogger>(
-              _value, _loggertype, _vsptr, _fptr, _loggername, _ansyctrl);
+              _value, _loggertype, _vsptr, _fptr, _loggername, _creator, _ansyctrl);
         }
         else
         {
@@ -241,6 +683,7 @@ namespace Log
       Logger::VSPtr _vsptr;
       Logger::FPtr _fptr;
       ACtrl::AnsyCtrl::ptr _ansyctrl;
+      ACtrlFactory::Creator _creator;
     };
 
     class LocalLogder : public LoggerBuilder
@@ -254,8 +697,35 @@ namespace Log
       static SingleManage &getInstance()
       {
         static SingleManage ince;
+        // 第一次使用时创建配置文件中声明的日志器,其他线程等待创建完成
+        static size_t declared = ince.LoadDeclared(Data::config());
+        (void)declared;
         return ince;
       }
+
+      // 创建快照中声明的日志器并加入全局管理,已经存在的同名日志器不重复创建
+      // 返回新创建的日志器个数
+      size_t LoadDeclared(const ConfigManager::Snapshot &snap)
+      {
+        std::vector<std::string> errors;
+        std::vector<LoggerSpec> specs = Topology::Parse(snap, errors, [this](const std::string &name)
+                                                        { return hasLogger(name); });
+        for (auto &e : errors)
+          std::cout << "日志器配置: " << e << std::endl;
+        for (auto &spec : specs)
+        {
+          LogGer::LoggerBuilder::ptr bp = std::make_shared<LogGer::LocalLogder>();
+          bp->InitLevel(spec.level);
+          bp->InitLoggerType(spec.type);
+          bp->InitACType(spec.actrl);
+          bp->InitLoggername(spec.name);
+          bp->InitFormat(spec.format);
+          bp->InitSinkWay(spec.sinks);
+          bp->InitAnsyCtrlCreator(ACtrlFactory::CreatorOf(spec.actrl, spec.buffer_size));
+          addLogger(bp->InitLB());
+        }
+        return specs.size();
+      }
       void addLogger(LogGer::Logger::ptr logger)
       {
         const std::string &loggername = logger->GetLoggerName();
@@ -302,6 +772,16 @@ namespace Log
         return _logger_map[Data::SYNC];
       }
 
+      // 所有全局日志器
+      std::vector<LogGer::Logger::ptr> getLoggers()
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::vector<LogGer::Logger::ptr> loggers;
+        for (auto &it : _logger_map)
+          loggers.push_back(it.second);
+        return loggers;
+      }
+
       bool hasLogger(const std::string &name)
       {
         std::unique_lock<std::mutex> lock(_mutex);
@@ -312,7 +792,12 @@ namespace Log
       }
 
     private:
-      SingleManage() {}
+      SingleManage()
+      {
+        // 全局日志器析构时可能滚动文件,后台清理和压缩单例必须晚于本对象析构
+        LogCleaner::getInstance();
+        Compressor::getInstance();
+      }
 
       ~SingleManage() {}
       LogGer::Logger::ptr DefaultLogger(const std::string &loggername)
@@ -402,19 +887,20 @@ namespace Log
       return returnLogger(bp, loggertype, value, loggername, format, type);
     }
 
+    // 返回新建的落地方向,可继续设置其溢出策略等属性
     template <class SW, class... Args>
-    void AddSink(Args &&...args)
+    Sink::ptr AddSink(Args &&...args)
     {
       Sink::ptr sp = SinkFactory::SinkWay<SW>(std::forward<Args>(args)...);
       _vsptr.push_back(sp);
+      return sp;
     }
 
+    // 每个落地方向都会用相同的参数创建一个独立的AnsyWay
     template <class AnsyWay, class... Args>
     void AddAnsyWay(Args &&...args)
     {
-      ACtrl::AnsyCtrl::ptr apr =
-          ACtrlFactory::ACtrlWay<AnsyWay>(std::forward<Args>(args)...);
-      _ansyctrl = apr;
+      _creator = ACtrlFactory::ACtrlCreator<AnsyWay>(std::forward<Args>(args)...);
     }
 
   private:
@@ -432,13 +918,13 @@ namespace Log
       bp->InitLoggername(loggername);
       bp->InitFormat(format);
       bp->InitSinkWay(_vsptr);
-      bp->InitAnsyCtrlWay(_ansyctrl);
+      bp->InitAnsyCtrlCreator(_creator);
       return bp->InitLB();
     }
 
   private:
     LogGer::Logger::VSPtr _vsptr;
-    ACtrl::AnsyCtrl::ptr _ansyctrl;
+    ACtrlFactory::Creator _creator;
   };
 
 } // namespace Log
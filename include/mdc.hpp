@@ -0,0 +1,101 @@
+#pragma once
+#include <sstream>
+#include <string>
+#include <vector>
+/*
+    线程诊断上下文(MDC)
+    每个线程一个键值栈,用MDC::Scope在作用域内压入,离开作用域自动弹出:
+        Log::MDC::Scope req("req", id);
+    之后该线程的日志通过%X{req}输出,JSON格式中作为字段输出
+    Message只引用当前线程的上下文,不复制;弹出的条目保留字符串容量供下次复用
+*/
+namespace Log
+{
+    class MDC
+    {
+    public:
+        struct Entry
+        {
+            std::string key;
+            std::string value;
+        };
+
+        // 一个线程的上下文栈,只有前size个条目有效
+        class Context
+        {
+        public:
+            Context()
+                : _size(0)
+            {
+            }
+            const Entry *begin() const { return _entries.data(); }
+            const Entry *end() const { return _entries.data() + _size; }
+            size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
+
+            // 同名时内层的值优先
+            const std::string *find(const std::string &key) const
+            {
+                for (size_t i = _size; i > 0; --i)
+                {
+                    if (_entries[i - 1].key == key)
+                        return &_entries[i - 1].value;
+                }
+                return nullptr;
+            }
+
+            void push(const std::string &key, const std::string &value)
+            {
+                if (_size == _entries.size())
+                    _entries.emplace_back();
+                _entries[_size].key.assign(key);
+                _entries[_size].value.assign(value);
+                ++_size;
+            }
+            void pop()
+            {
+                if (_size)
+                    --_size;
+            }
+            // 复制另一个上下文,复用已有条目的字符串容量
+            void assign(const Context &other)
+            {
+                _size = 0;
+                for (auto &e : other)
+                    push(e.key, e.value);
+            }
+
+        private:
+            std::vector<Entry> _entries;
+            size_t _size;
+        };
+
+        // 当前线程的上下文
+        static Context &Current()
+        {
+            static thread_local Context context;
+            return context;
+        }
+
+        static void Push(const std::string &key, const std::string &value) { Current().push(key, value); }
+        static void Pop() { Current().pop(); }
+
+        // 作用域内有效的键值对
+        class Scope
+        {
+        public:
+            Scope(const std::string &key, const std::string &value) { Push(key, value); }
+            Scope(const std::string &key, const char *value) { Push(key, value ? value : ""); }
+            template <class T>
+            Scope(const std::string &key, const T &value)
+            {
+                std::stringstream ss;
+                ss << value;
+                Push(key, ss.str());
+            }
+            ~Scope() { Pop(); }
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+        };
+    };
+}
@@ -3,6 +3,9 @@
 #include "tool.hpp"
 #include "level.hpp"
 #include "logdata.hpp"
+#include "field.hpp"
+#include "mdc.hpp"
+#include "scratch.hpp"
 // 日志消息管理模块
 // 1.日志产生时间
 // 2.日志等级
@@ -11,6 +14,10 @@
 // 5.线程id
 // 6.错误行号
 // 7.日志器名称
+// 8.结构化字段
+// 9.原始格式串和打包参数(二进制格式使用)
+// 10.线程诊断上下文
+// 11.延迟采样时间戳
 
 namespace Log
 {
@@ -25,17 +32,28 @@ namespace Log
     Log::Data::LogGerType _loggertype;
     std::string _loggername;
     std::string _content;
+    FieldList _fields;
+    // 只在日志器存在二进制格式的落地方向时设置,只在一次日志调用期间有效
+    StrView _rawformat;
+    const std::string *_packed = nullptr;
+    // 产生日志的线程的上下文(MDC),只在格式化期间引用
+    const MDC::Context *_context = nullptr;
+    // 被采样统计延迟时为提交时间(Histogram::Now()),否则为0
+    uint64_t _stamp = 0;
+    // 解码二进制日志时为记录中的线程号,不为0时代替_tid输出
+    uint64_t _tidnum = 0;
 
     Message(int line, Log::LogLevel::VALUE value,
             const std::string &filename,
             const Log::Data::LogGerType &loggertype,
             const std::string &loggername,
-            const std::string &content)
+            const std::string &content,
+            const FieldList &fields = FieldList())
         : _time(Log::tool::Date::GetTime()),
           _line(line), _value(value),
           _tid(std::this_thread::get_id()),
           _filename(filename), _loggertype(loggertype),
-          _loggername(loggername),_content(content)
+          _loggername(loggername),_content(content), _fields(fields)
     {
     }
   };
@@ -0,0 +1,276 @@
+#pragma once
+#include "logger.hpp"
+#include "tool.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+/*
+    运行统计导出模块
+    1.把各日志器的stats()快照渲染成Prometheus文本格式,采样的延迟以summary输出p50/p90/p99/p999
+    2.后台线程按log.metrics_interval周期导出到log.metrics_target
+      目标为文件路径时整体替换文件内容(供node_exporter的textfile收集器读取)
+      目标以unix:开头时连接该unix套接字并写入一次完整文本
+    3.导出失败只跳过本次,不影响日志本身
+*/
+namespace Log
+{
+    class Metrics
+    {
+    public:
+        static std::string Render(const std::vector<LoggerStats> &loggers)
+        {
+            std::ostringstream out;
+            // 默认6位有效数字会把较大的计数输出成科学计数法
+            out.precision(15);
+            Family(out, loggers, "log_messages_accepted_total", "counter", "通过过滤交给落地方向的日志条数",
+                   [](const LoggerStats &st)
+                   { return static_cast<double>(st.accepted); });
+            Family(out, loggers, "log_messages_filtered_total", "counter", "被过滤的日志条数",
+                   [](const LoggerStats &st)
+                   { return static_cast<double>(st.filtered); });
+            Family(out, loggers, "log_formatted_bytes_total", "counter", "格式化产生的字节数",
+                   [](const LoggerStats &st)
+                   { return static_cast<double>(st.formatted_bytes); });
+            SinkFamily(out, loggers, "log_messages_dropped_total", "counter", "缓冲区写满丢弃的日志条数",
+                       [](const ChannelStats &st)
+                       { return static_cast<double>(st.dropped); });
+            SinkFamily(out, loggers, "log_written_bytes_total", "counter", "已写入落地方向的字节数",
+                       [](const ChannelStats &st)
+                       { return static_cast<double>(st.written); });
+            SinkFamily(out, loggers, "log_buffer_swaps_total", "counter", "异步缓冲区交换次数",
+                       [](const ChannelStats &st)
+                       { return static_cast<double>(st.swaps); });
+            SinkFamily(out, loggers, "log_producer_wait_seconds_total", "counter", "生产者等待缓冲区空间的累计时间",
+                       [](const ChannelStats &st)
+                       { return st.wait_ns / 1e9; });
+            SinkFamily(out, loggers, "log_backend_write_seconds_total", "counter", "后端写入落地方向的累计时间",
+                       [](const ChannelStats &st)
+                       { return st.write_ns / 1e9; });
+            SinkFamily(out, loggers, "log_rotations_total", "counter", "滚动文件的次数",
+                       [](const ChannelStats &st)
+                       { return static_cast<double>(st.rotations); });
+            SinkFamily(out, loggers, "log_sink_lag_bytes", "gauge", "已提交尚未写入的字节数",
+                       [](const ChannelStats &st)
+                       { return static_cast<double>(st.lag); });
+            SinkFamily(out, loggers, "log_buffer_bytes", "gauge", "异步缓冲区占用的内存",
+                       [](const ChannelStats &st)
+                       { return static_cast<double>(st.buffered); });
+
+            Header(out, "log_call_latency_seconds", "summary", "被采样日志调用本身的耗时");
+            for (auto &st : loggers)
+                Summary(out, "log_call_latency_seconds", "logger=\"" + Escape(st.name) + "\"", st.call);
+            Header(out, "log_e2e_latency_seconds", "summary", "被采样日志从提交到写入落地方向完成的延迟");
+            for (auto &st : loggers)
+                for (size_t i = 0; i < st.sinks.size(); ++i)
+                    Summary(out, "log_e2e_latency_seconds",
+                            "logger=\"" + Escape(st.name) + "\",sink=\"" + std::to_string(i) + "\"",
+                            st.sinks[i].latency);
+            return out.str();
+        }
+
+        // 标签值中的反斜杠、双引号和换行需要转义
+        static std::string Escape(const std::string &value)
+        {
+            std::string res;
+            res.reserve(value.size());
+            for (char c : value)
+            {
+                if (c == '\\' || c == '"')
+                    res.push_back('\\');
+                if (c == '\n')
+                {
+                    res += "\\n";
+                    continue;
+                }
+                res.push_back(c);
+            }
+            return res;
+        }
+
+    private:
+        template <class F>
+        static void Family(std::ostream &out, const std::vector<LoggerStats> &loggers,
+                           const char *name, const char *type, const char *help, F value)
+        {
+            Header(out, name, type, help);
+            for (auto &st : loggers)
+                out << name << "{logger=\"" << Escape(st.name) << "\"} " << value(st) << '\n';
+        }
+        template <class F>
+        static void SinkFamily(std::ostream &out, const std::vector<LoggerStats> &loggers,
+                               const char *name, const char *type, const char *help, F value)
+        {
+            Header(out, name, type, help);
+            for (auto &st : loggers)
+                for (size_t i = 0; i < st.sinks.size(); ++i)
+                    out << name << "{logger=\"" << Escape(st.name) << "\",sink=\"" << i << "\"} "
+                        << value(st.sinks[i]) << '\n';
+        }
+        // 没有采样时分位数为NaN
+        static void Summary(std::ostream &out, const char *name, const std::string &labels, const LatencyStats &st)
+        {
+            const char *quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+            uint64_t values[] = {st.p50_ns, st.p90_ns, st.p99_ns, st.p999_ns};
+            for (size_t i = 0; i < 4; ++i)
+            {
+                out << name << '{' << labels << ",quantile=\"" << quantiles[i] << "\"} ";
+                if (st.count)
+                    out << values[i] / 1e9 << '\n';
+                else
+                    out << "NaN\n";
+            }
+            out << name << "_sum{" << labels << "} " << st.sum_ns / 1e9 << '\n';
+            out << name << "_count{" << labels << "} " << st.count << '\n';
+        }
+        static void Header(std::ostream &out, const char *name, const char *type, const char *help)
+        {
+            out << "# HELP " << name << ' ' << help << '\n';
+            out << "# TYPE " << name << ' ' << type << '\n';
+        }
+    };
+
+    class MetricsExporter
+    {
+    public:
+        // target为空时不启动后台线程,仍可手动调用exportNow()
+        MetricsExporter(const std::string &target = Data::metricsTarget(),
+                        size_t interval = Data::metricsInterval())
+            : _target(target), _interval(interval ? interval : 1), _stop(false)
+        {
+            if (!_target.empty())
+                _th = std::thread(&MetricsExporter::Run, this);
+        }
+        ~MetricsExporter() { stop(); }
+        MetricsExporter(const MetricsExporter &) = delete;
+        MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+        // 只导出添加过的日志器;一个都没有添加时导出全局管理的所有日志器
+        void add(const LogGer::Logger::ptr &logger)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _loggers.push_back(logger);
+        }
+
+        std::string render()
+        {
+            std::vector<LoggerStats> stats;
+            for (auto &logger : Loggers())
+                stats.push_back(logger->stats());
+            return Metrics::Render(stats);
+        }
+
+        // 立即导出一次,成功返回true
+        bool exportNow()
+        {
+            if (_target.empty())
+                return false;
+            std::string text = render();
+            if (_target.compare(0, 5, "unix:") == 0)
+                return SendUnix(_target.substr(5), text);
+            return tool::File::WriteFileAtomic(_target, text);
+        }
+
+        void stop()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_stop)
+                    return;
+                _stop = true;
+            }
+            _cond.notify_all();
+            if (_th.joinable())
+                _th.join();
+        }
+
+        const std::string &target() const { return _target; }
+
+    private:
+        std::vector<LogGer::Logger::ptr> Loggers()
+        {
+            std::vector<LogGer::Logger::ptr> loggers;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!_loggers.empty())
+                {
+                    // 已经销毁的日志器不再导出
+                    for (auto &weak : _loggers)
+                        if (auto logger = weak.lock())
+                            loggers.push_back(logger);
+                    return loggers;
+                }
+            }
+            return LogGer::SingleManage::getInstance().getLoggers();
+        }
+
+        static bool SendUnix(const std::string &path, const std::string &text)
+        {
+#ifndef _WIN32
+            sockaddr_un addr;
+            if (path.empty() || path.size() >= sizeof(addr.sun_path))
+                return false;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            memcpy(addr.sun_path, path.c_str(), path.size());
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0)
+                return false;
+            bool ok = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+            size_t sent = 0;
+            while (ok && sent < text.size())
+            {
+#ifdef MSG_NOSIGNAL
+                ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+#else
+                ssize_t n = send(fd, text.data() + sent, text.size() - sent, 0);
+#endif
+                if (n <= 0)
+                    ok = false;
+                else
+                    sent += static_cast<size_t>(n);
+            }
+            close(fd);
+            return ok;
+#else
+            (void)path;
+            (void)text;
+            return false;
+#endif
+        }
+
+        void Run()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!_stop)
+            {
+                _cond.wait_for(lock, std::chrono::seconds(_interval), [this]()
+                               { return _stop; });
+                if (_stop)
+                    break;
+                lock.unlock();
+                exportNow();
+                lock.lock();
+            }
+        }
+
+    private:
+        std::string _target;
+        size_t _interval;
+        bool _stop;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::vector<std::weak_ptr<LogGer::Logger>> _loggers;
+        std::thread _th; // 最后构造,启动时其他成员已就绪
+    };
+}
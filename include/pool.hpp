@@ -0,0 +1,233 @@
+#pragma once
+#include "message.hpp"
+#include "mdc.hpp"
+#include "scratch.hpp"
+#include "logdata.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+/*
+    日志记录池
+    一条日志从产生到写入落地方向期间使用的消息、打包参数和输出文本放在一个PooledRecord中
+    PooledRecord按块(slab)预分配,总数不超过log.record_pool_size,块在进程结束前不释放
+    每个线程缓存少量空闲PooledRecord,取用和归还不加锁;线程缓存满或线程退出时批量归还到全局
+    池用完后临时从堆上分配,归还时直接释放,计入overflow
+*/
+namespace Log
+{
+    struct PooledRecord
+    {
+        PooledRecord()
+            : msg(0, LogLevel::DEBUG, "", Data::SYNCLOGGER, "", ""), next(nullptr), pooled(false)
+        {
+        }
+        Message msg;
+        std::string format;  // 需要保存原始格式串时使用(回溯缓冲)
+        std::string packed;  // 按类型打包的参数
+        std::string out;     // 格式化后的文本
+        MDC::Context context; // 需要保存上下文副本时使用(回溯缓冲)
+        std::vector<Field> fields; // 从packed还原的kv字段(回溯缓冲)
+        std::string keys;          // fields的键
+        PooledRecord *next;
+        bool pooled;
+    };
+
+    // 记录池的统计快照
+    struct PoolStats
+    {
+        size_t limit;    // 最多预分配的记录数
+        size_t capacity; // 已预分配的记录数
+        size_t slabs;    // 已分配的块数
+        size_t free;     // 全局空闲链表中的记录数(不含线程缓存)
+        size_t overflow; // 池用完后从堆上临时分配的次数
+    };
+
+    class RecordPool
+    {
+    public:
+        static RecordPool &getInstance()
+        {
+            static RecordPool instance;
+            return instance;
+        }
+
+        PooledRecord *acquire()
+        {
+            Cache &c = Local();
+            if (c.n == 0)
+                Refill(c);
+            if (c.n > 0)
+                return c.items[--c.n];
+            _overflow.fetch_add(1, std::memory_order_relaxed);
+            return new PooledRecord();
+        }
+
+        void release(PooledRecord *r)
+        {
+            if (!r->pooled)
+            {
+                delete r;
+                return;
+            }
+            Shrink(r);
+            Cache &c = Local();
+            if (c.n == CacheSize)
+                Spill(c, CacheSize / 2);
+            c.items[c.n++] = r;
+        }
+
+        // 一批记录处理完后一次归还,只加一次锁
+        void release(PooledRecord *const *recs, size_t n)
+        {
+            PooledRecord *head = nullptr;
+            size_t count = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                PooledRecord *r = recs[i];
+                if (!r->pooled)
+                {
+                    delete r;
+                    continue;
+                }
+                Shrink(r);
+                r->next = head;
+                head = r;
+                ++count;
+            }
+            if (head)
+                Push(head, count);
+        }
+
+        PoolStats stats()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            PoolStats st;
+            st.limit = _limit;
+            st.capacity = _capacity;
+            st.slabs = _slabs.size();
+            st.free = _nfree;
+            st.overflow = _overflow.load(std::memory_order_relaxed);
+            return st;
+        }
+
+        // 作用域内持有一条记录
+        class Lease
+        {
+        public:
+            Lease()
+                : _pool(RecordPool::getInstance()), _r(_pool.acquire())
+            {
+            }
+            ~Lease() { _pool.release(_r); }
+            Lease(const Lease &) = delete;
+            Lease &operator=(const Lease &) = delete;
+            PooledRecord &get() { return *_r; }
+
+        private:
+            RecordPool &_pool;
+            PooledRecord *_r;
+        };
+
+    private:
+        enum
+        {
+            CacheSize = 16,
+            SlabSize = 32
+        };
+
+        // 线程缓存,线程退出时归还全部记录
+        struct Cache
+        {
+            Cache()
+                : n(0)
+            {
+            }
+            ~Cache()
+            {
+                if (n)
+                    RecordPool::getInstance().Spill(*this, n);
+            }
+            PooledRecord *items[CacheSize];
+            size_t n;
+        };
+        static Cache &Local()
+        {
+            static thread_local Cache cache;
+            return cache;
+        }
+
+        RecordPool()
+            : _limit(Data::recordPoolSize()), _capacity(0), _free(nullptr), _nfree(0), _overflow(0)
+        {
+        }
+
+        // 超过log.scratch_size的缓冲区缩回,池占用的内存有上限
+        static void Shrink(PooledRecord *r)
+        {
+            ScratchStream::Trim(r->msg._content);
+            ScratchStream::Trim(r->format);
+            ScratchStream::Trim(r->packed);
+            ScratchStream::Trim(r->out);
+        }
+
+        // 从全局取半个线程缓存,全局为空时分配新块
+        void Refill(Cache &c)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_free && _capacity < _limit)
+            {
+                size_t n = std::min<size_t>(SlabSize, _limit - _capacity);
+                std::unique_ptr<PooledRecord[]> slab(new PooledRecord[n]);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    slab[i].pooled = true;
+                    slab[i].next = _free;
+                    _free = &slab[i];
+                }
+                _slabs.push_back(std::move(slab));
+                _capacity += n;
+                _nfree += n;
+            }
+            while (_free && c.n < CacheSize / 2)
+            {
+                c.items[c.n++] = _free;
+                _free = _free->next;
+                --_nfree;
+            }
+        }
+
+        void Spill(Cache &c, size_t n)
+        {
+            PooledRecord *head = nullptr;
+            for (size_t i = 0; i < n; ++i)
+            {
+                PooledRecord *r = c.items[--c.n];
+                r->next = head;
+                head = r;
+            }
+            Push(head, n);
+        }
+
+        void Push(PooledRecord *head, size_t n)
+        {
+            PooledRecord *tail = head;
+            while (tail->next)
+                tail = tail->next;
+            std::unique_lock<std::mutex> lock(_mutex);
+            tail->next = _free;
+            _free = head;
+            _nfree += n;
+        }
+
+    private:
+        std::mutex _mutex;
+        size_t _limit;
+        size_t _capacity;
+        std::vector<std::unique_ptr<PooledRecord[]>> _slabs;
+        PooledRecord *_free;
+        size_t _nfree;
+        std::atomic<size_t> _overflow;
+    };
+}
@@ -0,0 +1,333 @@
+#pragma once
+#include "histogram.hpp"
+#include "logdata.hpp"
+#include "tool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <time.h>
+#endif
+/*
+    流水线分阶段性能剖析
+    1.定义LOG_PROFILE编译时开启,否则LOG_PROFILE_SCOPE展开为空,日志路径没有任何额外开销
+    2.各阶段用CLOCK_MONOTONIC_RAW计时,按日志器汇总到每个阶段一个延迟直方图
+      CALL   一次日志调用(通过过滤后)的全部耗时
+      PARSE  {}参数替换(ParseFormat)
+      FORMAT 按输出格式格式化(Formatctrl)
+      PUSH   交给落地通道:同步时包含写入,异步时包含等待缓冲区空间
+      WRITE  落地方向写入(异步时在后台线程)
+    3.Profiler::table()输出分阶段统计表
+    4.log.profile_trace不为空时同时记录Chrome trace-event事件,各线程记录到自己的缓冲区,
+      停止或进程退出时合并写成JSON文件,可在chrome://tracing或Perfetto中打开
+*/
+namespace Log
+{
+    struct Profile
+    {
+        enum Stage
+        {
+            CALL,
+            PARSE,
+            FORMAT,
+            PUSH,
+            WRITE,
+            STAGES
+        };
+
+        static const char *Name(Stage stage)
+        {
+            static const char *names[] = {"CALL", "PARSE", "FORMAT", "PUSH", "WRITE"};
+            return stage < STAGES ? names[stage] : "UNKNOW";
+        }
+
+        // 不受NTP调整影响的单调时钟,单位纳秒
+        static uint64_t Now()
+        {
+#if !defined(_WIN32) && defined(CLOCK_MONOTONIC_RAW)
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+#endif
+        }
+    };
+
+    // Chrome trace-event记录,所有日志器共用
+    // 每个线程记录到自己的缓冲区,只在第一次记录时登记一次;stop()时合并各线程的事件并按时间排序
+    // 事件数达到上限后不再记录,文件中只保留开始后的前max个事件
+    class TraceRecorder
+    {
+    public:
+        static TraceRecorder &getInstance()
+        {
+            static TraceRecorder instance;
+            return instance;
+        }
+        ~TraceRecorder() { stop(); }
+
+        // 开始记录,之前未写出的事件被丢弃
+        void start(const std::string &path, size_t max = Data::profileTraceEvents())
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _path = path;
+            _max.store(max, std::memory_order_relaxed);
+            _count.store(0, std::memory_order_relaxed);
+            _origin.store(Profile::Now(), std::memory_order_relaxed);
+            // 各线程发现编号变化时丢弃旧事件
+            _session.fetch_add(1, std::memory_order_release);
+            // 线程已经退出的缓冲区不再需要
+            _locals.erase(std::remove_if(_locals.begin(), _locals.end(),
+                                         [](const std::shared_ptr<Local> &l)
+                                         { return l.use_count() == 1; }),
+                          _locals.end());
+            _enabled.store(!path.empty(), std::memory_order_release);
+        }
+
+        // 停止记录并写出文件,没有开始记录或写入失败时返回false
+        bool stop()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_enabled.exchange(false))
+                return false;
+            uint64_t session = _session.load(std::memory_order_relaxed);
+            std::vector<Event> events;
+            for (auto &l : _locals)
+            {
+                std::unique_lock<std::mutex> llock(l->mutex);
+                if (l->session == session)
+                    events.insert(events.end(), l->events.begin(), l->events.end());
+                l->events.clear();
+            }
+            std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b)
+                             { return a.ts < b.ts; });
+            return tool::File::WriteFileAtomic(_path, Render(events));
+        }
+
+        bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+        // 日志器名称登记一次,事件中只保存编号
+        size_t category(const std::string &name)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _categories.push_back(name);
+            return _categories.size() - 1;
+        }
+
+        // 只锁本线程的缓冲区,只有stop()会与之竞争
+        void add(Profile::Stage stage, size_t category, uint64_t begin, uint64_t end)
+        {
+            if (!_enabled.load(std::memory_order_acquire))
+                return;
+            size_t max = _max.load(std::memory_order_relaxed);
+            if (_count.load(std::memory_order_relaxed) >= max)
+                return;
+            Local &l = local();
+            std::unique_lock<std::mutex> lock(l.mutex);
+            uint64_t session = _session.load(std::memory_order_acquire);
+            uint64_t origin = _origin.load(std::memory_order_relaxed);
+            if (begin < origin || _count.fetch_add(1, std::memory_order_relaxed) >= max)
+                return;
+            if (l.session != session)
+            {
+                l.events.clear();
+                l.session = session;
+            }
+            l.events.push_back(Event{stage, l.tid, category, begin - origin, end - begin});
+        }
+
+        // 本次记录的事件数
+        size_t size() const
+        {
+            return std::min(_count.load(std::memory_order_relaxed), _max.load(std::memory_order_relaxed));
+        }
+
+    private:
+        struct Event
+        {
+            Profile::Stage stage;
+            uint32_t tid;
+            size_t category;
+            uint64_t ts;  // 相对开始记录的时间
+            uint64_t dur;
+        };
+
+        // 一个线程的事件
+        struct Local
+        {
+            std::mutex mutex;
+            uint32_t tid = 0;
+            uint64_t session = 0;
+            std::vector<Event> events;
+        };
+
+        TraceRecorder()
+            : _max(0), _count(0), _origin(0), _session(0), _enabled(false)
+        {
+            if (*Data::profileTrace())
+                start(Data::profileTrace());
+        }
+
+        // 线程第一次记录时创建并登记,线程退出后缓冲区由登记表保留到下一次start()
+        Local &local()
+        {
+            static thread_local std::shared_ptr<Local> l;
+            if (!l)
+            {
+                std::shared_ptr<Local> created = std::make_shared<Local>();
+                std::unique_lock<std::mutex> lock(_mutex);
+                created->tid = ++_tids;
+                _locals.push_back(created);
+                l = created;
+            }
+            return *l;
+        }
+
+        std::string Render(const std::vector<Event> &events) const
+        {
+            std::ostringstream out;
+            out << "{\"traceEvents\":[";
+            char buf[64];
+            for (size_t i = 0; i < events.size(); ++i)
+            {
+                const Event &e = events[i];
+                if (i)
+                    out << ',';
+                out << "\n{\"name\":\"" << Profile::Name(e.stage) << "\",\"cat\":\"";
+                Escape(out, e.category < _categories.size() ? _categories[e.category] : std::string());
+                // 时间单位为微秒
+                snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", e.ts / 1e3, e.dur / 1e3);
+                out << buf << ",\"pid\":1,\"tid\":" << e.tid << '}';
+            }
+            out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+            return out.str();
+        }
+        static void Escape(std::ostream &out, const std::string &s)
+        {
+            for (char c : s)
+            {
+                if (c == '"' || c == '\\')
+                    out << '\\' << c;
+                else if (static_cast<unsigned char>(c) < 0x20)
+                    out << ' ';
+                else
+                    out << c;
+            }
+        }
+
+    private:
+        std::mutex _mutex; // 保护登记表、路径和日志器名称
+        std::string _path;
+        std::atomic<size_t> _max;
+        std::atomic<size_t> _count; // 本次已接受的事件数
+        std::atomic<uint64_t> _origin;
+        std::atomic<uint64_t> _session;
+        std::vector<std::shared_ptr<Local>> _locals;
+        uint32_t _tids = 0; // 已分配的线程编号
+        std::vector<std::string> _categories;
+        std::atomic<bool> _enabled;
+    };
+
+    // 一个日志器各阶段的耗时
+    class Profiler
+    {
+    public:
+        typedef std::shared_ptr<Profiler> ptr;
+
+        Profiler(const std::string &name)
+            : _name(name), _category(TraceRecorder::getInstance().category(name))
+        {
+        }
+        Profiler(const Profiler &) = delete;
+        Profiler &operator=(const Profiler &) = delete;
+
+        void record(Profile::Stage stage, uint64_t begin, uint64_t end)
+        {
+            _stages[stage].record(end - begin);
+            TraceRecorder &tr = TraceRecorder::getInstance();
+            if (tr.enabled())
+                tr.add(stage, _category, begin, end);
+        }
+
+        LatencyStats stats(Profile::Stage stage) const { return _stages[stage].stats(); }
+        const std::string &name() const { return _name; }
+
+        void reset()
+        {
+            for (auto &h : _stages)
+                h.reset();
+        }
+
+        // 分阶段统计表,占比相对CALL的总耗时(WRITE不在调用线程中,不计占比)
+        std::string table() const
+        {
+            LatencyStats st[Profile::STAGES];
+            for (int i = 0; i < Profile::STAGES; ++i)
+                st[i] = _stages[i].stats();
+            std::string res = "日志器 " + _name + "\n";
+            char line[160];
+            snprintf(line, sizeof(line), "%-8s %10s %12s %10s %10s %10s %10s %7s\n",
+                     "stage", "count", "total_ms", "avg_ns", "p50_ns", "p99_ns", "max_ns", "share");
+            res += line;
+            for (int i = 0; i < Profile::STAGES; ++i)
+            {
+                const LatencyStats &s = st[i];
+                char share[16] = "-";
+                if (i != Profile::WRITE && st[Profile::CALL].sum_ns)
+                    snprintf(share, sizeof(share), "%.1f%%", 100.0 * s.sum_ns / st[Profile::CALL].sum_ns);
+                snprintf(line, sizeof(line), "%-8s %10llu %12.3f %10llu %10llu %10llu %10llu %7s\n",
+                         Profile::Name(static_cast<Profile::Stage>(i)), (unsigned long long)s.count, s.sum_ns / 1e6,
+                         (unsigned long long)(s.count ? s.sum_ns / s.count : 0), (unsigned long long)s.p50_ns,
+                         (unsigned long long)s.p99_ns, (unsigned long long)s.max_ns, share);
+                res += line;
+            }
+            return res;
+        }
+
+    private:
+        std::string _name;
+        size_t _category;
+        Histogram _stages[Profile::STAGES];
+    };
+
+    // 作用域计时,profiler为空时不计时
+    class ProfileScope
+    {
+    public:
+        ProfileScope(Profiler *profiler, Profile::Stage stage)
+            : _profiler(profiler), _stage(stage), _begin(profiler ? Profile::Now() : 0)
+        {
+        }
+        ~ProfileScope()
+        {
+            if (_profiler)
+                _profiler->record(_stage, _begin, Profile::Now());
+        }
+        ProfileScope(const ProfileScope &) = delete;
+        ProfileScope &operator=(const ProfileScope &) = delete;
+
+    private:
+        Profiler *_profiler;
+        Profile::Stage _stage;
+        uint64_t _begin;
+    };
+}
+
+#define LOG_PROFILE_CONCAT_(a, b) a##b
+#define LOG_PROFILE_CONCAT(a, b) LOG_PROFILE_CONCAT_(a, b)
+#ifdef LOG_PROFILE
+#define LOG_PROFILE_SCOPE(profiler, stage) \
+    Log::ProfileScope LOG_PROFILE_CONCAT(_log_profile_, __LINE__)((profiler), Log::Profile::stage)
+#else
+#define LOG_PROFILE_SCOPE(profiler, stage) ((void)0)
+#endif
@@ -0,0 +1,186 @@
+#pragma once
+#include "ConfigManager.hpp"
+#include "tool.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+/*
+    配置文件热加载
+    1.后台线程监视配置文件,变化后调用ConfigManager::reload()发布新的配置快照
+    2.Linux上用inotify监视配置文件所在目录(编辑器通常写临时文件再改名,直接监视文件会丢失),
+      收到事件后等待片刻合并连续的写入再重新加载
+    3.同时按interval秒比较文件的修改时间和大小,inotify不可用时仍然生效
+    4.日志器在下一次记录日志时比较配置版本号,应用新的等级、格式、溢出策略和滚动大小(见logger.hpp)
+*/
+namespace Log
+{
+    class ConfigWatcher
+    {
+    public:
+        static ConfigWatcher &getInstance()
+        {
+            static ConfigWatcher instance;
+            return instance;
+        }
+        ~ConfigWatcher() { stop(); }
+
+        // 开始监视配置文件,interval为比较修改时间的间隔(秒);已经在监视时只修改间隔
+        // 返回前已经开始监视,之后对文件的修改不会遗漏
+        void start(size_t interval)
+        {
+            _interval.store(interval ? interval : 1, std::memory_order_relaxed);
+            if (_running.exchange(true))
+                return;
+            _stop = false;
+            std::string path = ConfigManager::getInstance().filename();
+            int fd = Watch(path);
+            _th = std::thread(&ConfigWatcher::Run, this, path, fd, StampOf(path));
+        }
+
+        void stop()
+        {
+            if (!_running.exchange(false))
+                return;
+            _stop = true;
+            if (_th.joinable())
+                _th.join();
+        }
+
+        bool running() const { return _running.load(std::memory_order_relaxed); }
+        // 因文件变化重新加载的次数
+        size_t reloads() const { return _reloads.load(std::memory_order_relaxed); }
+
+    private:
+        enum
+        {
+            SliceMs = 100,   // 检查停止标志的间隔
+            SettleMs = 50    // 收到事件后等待连续写入结束
+        };
+
+        ConfigWatcher()
+            : _interval(1), _running(false), _stop(false), _reloads(0)
+        {
+        }
+        ConfigWatcher(const ConfigWatcher &) = delete;
+        ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+        struct Stamp
+        {
+            bool exist = false;
+            size_t size = 0;
+            time_t mtime = 0;
+            long mtime_ns = 0;
+            bool operator!=(const Stamp &o) const
+            {
+                return exist != o.exist || size != o.size || mtime != o.mtime || mtime_ns != o.mtime_ns;
+            }
+        };
+        static Stamp StampOf(const std::string &path)
+        {
+            Stamp st;
+            tool::File::FileInfo info;
+            if (tool::File::GetFileInfo(path, info))
+            {
+                st.exist = true;
+                st.size = info.size;
+                st.mtime = info.mtime;
+                st.mtime_ns = info.mtime_ns;
+            }
+            return st;
+        }
+
+        // 监视配置文件所在目录,不可用时返回-1
+        static int Watch(const std::string &path)
+        {
+            int fd = -1;
+#ifdef __linux__
+            fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (fd >= 0 && inotify_add_watch(fd, tool::File::GetFilepath(path).c_str(),
+                                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+#else
+            (void)path;
+#endif
+            return fd;
+        }
+
+        // fd和last在start()中取得,线程启动前的修改同样能发现
+        void Run(std::string path, int fd, Stamp last)
+        {
+            size_t slash = path.find_last_of("/\\");
+            std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+            auto next = std::chrono::steady_clock::now() + std::chrono::seconds(_interval.load());
+            while (!_stop)
+            {
+                bool changed = Wait(fd, name);
+                if (!changed && std::chrono::steady_clock::now() >= next)
+                {
+                    changed = StampOf(path) != last;
+                    next = std::chrono::steady_clock::now() + std::chrono::seconds(_interval.load());
+                }
+                if (!changed)
+                    continue;
+                std::this_thread::sleep_for(std::chrono::milliseconds(SettleMs));
+                Wait(fd, name, 0);
+                last = StampOf(path);
+                // 文件被删除时保留当前配置
+                if (last.exist && ConfigManager::getInstance().reload())
+                    _reloads.fetch_add(1, std::memory_order_relaxed);
+            }
+#ifdef __linux__
+            if (fd >= 0)
+                close(fd);
+#endif
+        }
+
+        // 等待最多timeout毫秒,返回是否收到配置文件的inotify事件
+        bool Wait(int fd, const std::string &name, int timeout = SliceMs)
+        {
+#ifdef __linux__
+            if (fd >= 0)
+            {
+                pollfd pfd;
+                pfd.fd = fd;
+                pfd.events = POLLIN;
+                if (poll(&pfd, 1, timeout) <= 0)
+                    return false;
+                bool hit = false;
+                alignas(inotify_event) char buf[4096];
+                ssize_t n;
+                while ((n = read(fd, buf, sizeof(buf))) > 0)
+                {
+                    for (char *p = buf; p < buf + n;)
+                    {
+                        const inotify_event *ev = reinterpret_cast<const inotify_event *>(p);
+                        if (ev->len && name == ev->name)
+                            hit = true;
+                        p += sizeof(inotify_event) + ev->len;
+                    }
+                }
+                return hit;
+            }
+#endif
+            (void)fd;
+            (void)name;
+            if (timeout > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+            return false;
+        }
+
+    private:
+        std::atomic<size_t> _interval;
+        std::atomic<bool> _running;
+        std::atomic<bool> _stop;
+        std::atomic<size_t> _reloads;
+        std::thread _th;
+    };
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "logdata.hpp"
+#include <cstring>
+#include <ostream>
+#include <streambuf>
+#include <string>
+/*
+    线程本地缓冲区模块
+    日志路径上的文本都写入线程本地、反复复用的std::string,稳定后不再分配内存
+    StrView:      不持有内存的字符串引用
+    ScratchStream: 线程本地的ostream,输出追加到指定的std::string
+    超过log.scratch_size的缓冲区在使用后缩回该大小,避免偶尔的超长日志长期占用内存
+*/
+namespace Log
+{
+    struct StrView
+    {
+        const char *data;
+        size_t size;
+
+        StrView()
+            : data(nullptr), size(0)
+        {
+        }
+        StrView(const char *s)
+            : data(s), size(s ? strlen(s) : 0)
+        {
+        }
+        StrView(const char *s, size_t n)
+            : data(s), size(n)
+        {
+        }
+        StrView(const std::string &s)
+            : data(s.data()), size(s.size())
+        {
+        }
+        bool empty() const { return size == 0; }
+        std::string str() const { return data ? std::string(data, size) : std::string(); }
+        bool operator==(const std::string &s) const
+        {
+            return s.size() == size && (size == 0 || memcmp(s.data(), data, size) == 0);
+        }
+    };
+
+    // 追加写入std::string的streambuf
+    class StringBuf : public std::streambuf
+    {
+    public:
+        StringBuf()
+            : _out(nullptr)
+        {
+        }
+        std::string *target() const { return _out; }
+        void bind(std::string *out) { _out = out; }
+
+    protected:
+        int_type overflow(int_type ch) override
+        {
+            if (ch != traits_type::eof() && _out)
+                _out->push_back(static_cast<char>(ch));
+            return ch;
+        }
+        std::streamsize xsputn(const char *s, std::streamsize n) override
+        {
+            if (_out)
+                _out->append(s, static_cast<size_t>(n));
+            return n;
+        }
+
+    private:
+        std::string *_out;
+    };
+
+    // 线程本地ostream的使用期,结束时恢复之前的目标,允许嵌套使用
+    class ScratchStream
+    {
+    public:
+        ScratchStream(std::string &target)
+            : _local(Local()), _prev(_local.buf.target()),
+              _flags(_local.os.flags()), _precision(_local.os.precision()), _fill(_local.os.fill())
+        {
+            _local.buf.bind(&target);
+            // 用户类型的operator<<可能修改过格式状态
+            _local.os.flags(std::ios_base::dec | std::ios_base::skipws);
+            _local.os.precision(6);
+            _local.os.width(0);
+            _local.os.fill(' ');
+            _local.os.clear();
+        }
+        // 嵌套使用时恢复外层的格式状态
+        ~ScratchStream()
+        {
+            _local.buf.bind(_prev);
+            _local.os.flags(_flags);
+            _local.os.precision(_precision);
+            _local.os.fill(_fill);
+        }
+        ScratchStream(const ScratchStream &) = delete;
+        ScratchStream &operator=(const ScratchStream &) = delete;
+
+        std::ostream &get() { return _local.os; }
+
+        // 缓冲区超过log.scratch_size后缩回该大小
+        static void Trim(std::string &s)
+        {
+            static const size_t limit = Data::scratchSize();
+            if (s.capacity() > limit)
+            {
+                std::string().swap(s);
+                s.reserve(limit);
+            }
+        }
+
+    private:
+        struct Stream
+        {
+            Stream()
+                : os(&buf)
+            {
+            }
+            StringBuf buf;
+            std::ostream os;
+        };
+        static Stream &Local()
+        {
+            static thread_local Stream stream;
+            return stream;
+        }
+
+    private:
+        Stream &_local;
+        std::string *_prev;
+        std::ios_base::fmtflags _flags;
+        std::streamsize _precision;
+        char _fill;
+    };
+}
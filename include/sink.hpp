@@ -1,6 +1,12 @@
 #pragma once
 #include "logdata.hpp"
 #include "tool.hpp"
+#include "cleaner.hpp"
+#include "compress.hpp"
+#include "blockfile.hpp"
+#include "binary.hpp"
+#include "counter.hpp"
+#include <algorithm>
 #include <memory>
 #include <fstream>
 #include <atomic>
@@ -15,6 +21,7 @@ namespace Log
     {
     public:
         Sink()
+            : _overflow(Data::overflowPolicy()), _level(LogLevel::UNKNOW), _btall(false)
         {
         }
         typedef std::shared_ptr<Sink> ptr;
@@ -22,6 +29,56 @@ namespace Log
         {
         }
         virtual void WriteFile(const std::string &) = 0;
+        // 异步缓冲区整块写入时调用,默认复制为std::string交给WriteFile
+        // 内置的落地方向直接写入,不复制
+        virtual void WriteData(const char *data, size_t len) { WriteFile(std::string(data, len)); }
+
+        // 异步日志器中该落地方向的缓冲区写满时的处理方式,
+        // 每个落地方向有独立的缓冲区,互不影响;创建日志器之后修改需要通过日志器应用(配置热加载)
+        Sink &SetOverflow(Data::OverflowPolicy policy)
+        {
+            _overflow = policy;
+            return *this;
+        }
+        Data::OverflowPolicy GetOverflow() const { return _overflow; }
+
+        // 该落地方向只接收不低于level的日志,可在运行时修改
+        Sink &SetLevel(LogLevel::VALUE level)
+        {
+            _level = level;
+            return *this;
+        }
+        LogLevel::VALUE GetLevel() const { return _level; }
+
+        // 回溯缓冲输出时是否接收低于本落地方向等级的日志,默认仍按等级过滤
+        Sink &SetBacktraceAll(bool all)
+        {
+            _btall = all;
+            return *this;
+        }
+        bool GetBacktraceAll() const { return _btall; }
+
+        // 该落地方向的输出格式,为空时使用日志器的格式
+        // 格式在创建日志器时确定,需要在创建日志器之前设置
+        Sink &SetPattern(const std::string &pattern)
+        {
+            _pattern = pattern;
+            return *this;
+        }
+        const std::string &GetPattern() const { return _pattern; }
+
+        // 滚动(切换到新文件)的次数
+        uint64_t GetRotations() const { return _rotations; }
+
+    protected:
+        void CountRotation() { _rotations.add(); }
+
+    private:
+        Counter _rotations;
+        std::atomic<Data::OverflowPolicy> _overflow;
+        std::atomic<LogLevel::VALUE> _level;
+        std::atomic<bool> _btall;
+        std::string _pattern;
     };
     namespace SinkWay
     {
@@ -32,6 +89,10 @@ namespace Log
             {
                 std::cout << str;
             }
+            void WriteData(const char *data, size_t len) override
+            {
+                std::cout.write(data, len);
+            }
         };
         class FiletSink : public Sink
         {
@@ -56,6 +117,10 @@ namespace Log
             {
                 _ofs.write(str.c_str(), str.size());
             }
+            void WriteData(const char *data, size_t len) override
+            {
+                _ofs.write(data, len);
+            }
 
         private:
             std::string _filepath;
@@ -65,12 +130,26 @@ namespace Log
         class RollFileSink : public Sink
         {
         public:
-            RollFileSink(size_t maxsize = Data::max_logfile_size(), const std::string &basefile = Data::defaultBFile())
-                : _size(0), _num(1), _maxsize(maxsize), _basefile(basefile)
+            // maxsize: 按大小滚动的阈值
+            // interval: 按时间滚动的周期,可与大小滚动同时生效
+            // retain: 历史文件保留策略,在每次滚动后由后台线程清理
+            // compress: 滚动后旧文件的压缩方式,由后台低优先级线程完成
+            RollFileSink(size_t maxsize = Data::max_logfile_size(), const std::string &basefile = Data::defaultBFile(),
+                         Data::RollInterval interval = Data::rollInterval(),
+                         const RetainPolicy &retain = RetainPolicy::Default(),
+                         Data::CompressType compress = Data::compressType())
+                : _size(0), _num(1), _maxsize(maxsize), _basefile(basefile),
+                  _interval(interval), _nextroll(0), _retain(retain), _compress(compress)
             {
-                if (_basefile.empty() || _basefile == Data::defaultBFile())
+                // 后台单例先于本对象构造完成,析构也就晚于本对象
+                if (_retain.enabled())
+                    LogCleaner::getInstance();
+                if (_compress != Data::NOCOMPRESS)
+                    Compressor::getInstance();
+                // 优先从状态文件恢复当前文件,避免启动时扫描整个日志目录;自定义基础文件名同样适用
+                if (!LoadState() && (_basefile.empty() || _basefile == Data::defaultBFile()))
                 {
-                    // 搜索默认日志目录下的最新文件进行写入
+                    // 状态文件缺失或过期时,搜索默认日志目录下的最新文件进行写入
                     Init(); // 初始化查找最新文件
                 }
                 if (_filepath.empty())
@@ -80,8 +159,13 @@ namespace Log
                 }
                 else
                 {
+                    // 最新文件属于已经结束的时间周期时同样需要滚动
+                    tool::File::FileInfo info;
+                    if (_interval != Data::NONE && tool::File::GetFileInfo(_filepath, info))
+                        _nextroll = tool::Date::NextBoundary(info.mtime, _interval);
+
                     // 检查最新文件大小是否超过默认大小
-                    if (_size >= _maxsize)
+                    if (_size >= _maxsize || (_interval != Data::NONE && tool::Date::GetTime() >= _nextroll))
                     {
                         // 如果超过则创建新文件
                         openNewFile();
@@ -98,25 +182,120 @@ namespace Log
                         }
                     }
                 }
+                // 删除上次崩溃时遗留的压缩临时文件,未压缩完的旧文件重新压缩
+                if (_compress != Data::NOCOMPRESS || _retain.enabled())
+                    Compressor::getInstance().recover(_basefile + "[0-9]*_*" + Data::defaultFix() + "*.tmp", _filepath, _compress);
             }
             ~RollFileSink() override
             {
+                if (_ofs.is_open())
+                    _ofs.flush();
+                SaveState();
             }
+
+            // 按大小滚动的阈值,可在运行时修改,下一次写入时生效
+            void SetMaxSize(size_t maxsize) { _maxsize.store(maxsize ? maxsize : 1); }
+            size_t GetMaxSize() const { return _maxsize.load(); }
+            // 下一次按时间滚动的时间点,设为已经过去的时间时下一次写入即滚动
+            time_t GetNextRoll() const { return _nextroll.load(); }
+            void SetNextRoll(time_t t) { _nextroll.store(t); }
             void WriteFile(const std::string &str) override
             {
+                WriteData(str.data(), str.size());
+            }
+            void WriteData(const char *data, size_t len) override
+            {
+                if (_interval != Data::NONE && tool::Date::GetTime() >= _nextroll)
+                {
+                    CountRotation();
+                    openNewFile();
+                }
 
-                _size += str.size();
-                if (_size < _maxsize)
+                _size += len;
+                // 阈值可能被其他线程修改,本次写入只读取一次
+                size_t maxsize = _maxsize.load();
+                if (_size < maxsize)
                 {
-                    _ofs.write(str.c_str(), str.size());
+                    _ofs.write(data, len);
                 }
                 else
                 {
-                    Write(str);
+                    Write(data, len, maxsize);
                 }
             }
 
         private:
+            // 状态文件与日志文件放在同一目录,记录当前文件、序号和大小
+            std::string StatePath() const
+            {
+                return _basefile + ".state";
+            }
+
+            bool LoadState()
+            {
+                std::ifstream ifs(StatePath());
+                if (!ifs.is_open())
+                    return false;
+                std::string line, file;
+                size_t serial = 0, size = 0;
+                uint64_t inode = 0;
+                bool hasSerial = false, hasSize = false;
+                while (std::getline(ifs, line))
+                {
+                    size_t pos = line.find('=');
+                    if (pos == std::string::npos)
+                        continue;
+                    std::string key = line.substr(0, pos);
+                    std::string value = line.substr(pos + 1);
+                    try
+                    {
+                        if (key == "file")
+                            file = value;
+                        else if (key == "serial")
+                            serial = std::stoull(value), hasSerial = true;
+                        else if (key == "size")
+                            size = std::stoull(value), hasSize = true;
+                        else if (key == "inode")
+                            inode = std::stoull(value);
+                    }
+                    catch (...)
+                    {
+                        return false;
+                    }
+                }
+                // 记录的文件必须属于本组且仍然存在
+                if (file.empty() || !hasSerial || !hasSize || file.compare(0, _basefile.size(), _basefile) != 0)
+                    return false;
+                tool::File::FileInfo info;
+                if (!tool::File::GetFileInfo(file, info))
+                    return false;
+                // 状态只在滚动和析构时更新,实际大小只会更大;变小说明文件被替换或截断
+                // 同名文件被删除后重新创建时inode不同(旧版本的状态文件没有inode,只比较大小)
+                if (info.size < size || (inode && info.inode && inode != info.inode))
+                {
+                    // 序号继续递增,新文件不与已有文件重名
+                    _num = serial;
+                    return false;
+                }
+                _filepath = file;
+                _num = serial;
+                _size = info.size;
+                return true;
+            }
+
+            void SaveState()
+            {
+                if (_filepath.empty())
+                    return;
+                std::string content = "file=" + _filepath + "\n" +
+                                      "serial=" + std::to_string(_num.load()) + "\n" +
+                                      "size=" + std::to_string(_size.load()) + "\n";
+                tool::File::FileInfo info;
+                if (tool::File::GetFileInfo(_filepath, info) && info.inode)
+                    content += "inode=" + std::to_string(info.inode) + "\n";
+                tool::File::WriteFileAtomic(StatePath(), content);
+            }
+
             void Init()
             {
                 // 默认路径下查找最新的日志文件
@@ -141,35 +320,42 @@ namespace Log
                 }
             }
 
-            void Write(const std::string &str)
+            void Write(const char *data, size_t total, size_t maxsize)
             {
 
-                size_t size = _size - _maxsize;
+                size_t size = _size - maxsize;
                 if (size < Data::Exceed_size())
                 {
                     //将包含超过部分写入当前文件
-                    _ofs.write(str.c_str(), str.size());
+                    _ofs.write(data, total);
+                    CountRotation();
                     openNewFile();
                 }
                 else
                 {
                     
-                    size_t len = str.size() - size;
-                    _ofs.write(str.c_str(), len);
+                    // 阈值调小后当前文件可能已经超过阈值,此时全部写入新文件
+                    size_t len = size < total ? total - size : 0;
+                    _ofs.write(data, len);
                     //将超过部分写入新文件
+                    CountRotation();
                     openNewFile();
-                    std::string s = str.substr(len);
-                    WriteFile(s);
+                    WriteData(data + len, total - len);
                 }
             }
 
             void openNewFile()
             {
 
-                if (_ofs.good())
+                if (_ofs.is_open())
                 {
                     _ofs.close();
                 }
+                // 关闭的旧文件交给后台压缩
+                if (_compress != Data::NOCOMPRESS && !_filepath.empty() && tool::File::FileisExist(_filepath))
+                {
+                    Compressor::getInstance().submit(_filepath, _compress);
+                }
                 _size = 0;
                 createFilepath();
                 std::unique_lock<std::mutex> lock(_mutex);
@@ -179,6 +365,20 @@ namespace Log
                     std::cout << "RollFileSink 文件打开失败" << std::endl;
                     _basefile = Data::defaultBFile();
                     openNewFile();
+                    return;
+                }
+                if (_interval != Data::NONE)
+                    _nextroll = tool::Date::NextBoundary(tool::Date::GetTime(), _interval);
+                SaveState();
+                // 只在滚动时提交清理任务,不影响每次写入
+                if (_retain.enabled())
+                {
+                    LogCleaner::Job job;
+                    // 压缩后的文件带有额外后缀,同样计入保留策略
+                    job.pattern = _basefile + "[0-9]*_*" + Data::defaultFix() + "*";
+                    job.keep = _filepath;
+                    job.policy = _retain;
+                    LogCleaner::getInstance().submit(job);
                 }
             }
             void createFilepath()
@@ -187,10 +387,9 @@ namespace Log
                 std::string str = Data::GetFormatTime(tool::Date::GetTime(), Data::defaultFileTF());
                 if (!str.empty())
                 {
+                    // 序号单调递增不回绕,恢复状态、查找最新文件和按序拼接都依赖序号顺序与写入顺序一致
                     _num++;
                     _filepath = _basefile + std::to_string(_num) + Data::BoundSymbol() + str + Data::defaultFix();
-                    if (_num >= Data::MaxFileSerial())
-                        _num = 0;
                 }
                 else
                 {
@@ -207,8 +406,224 @@ namespace Log
             std::string _filepath;
             std::ofstream _ofs;
             std::mutex _mutex;
+            Data::RollInterval _interval;
+            std::atomic<time_t> _nextroll;
+            RetainPolicy _retain;
+            Data::CompressType _compress;
         };
 
+
+        // 块压缩日志文件:每次写入(异步时即后端的一个批次)压缩为一个独立的块,
+        // 关闭时在文件尾写入块索引,可用tools/logblock按时间范围定位读取
+        // 可能被多个日志器的通道同时写入,块头、块数据和索引在_mutex下写出
+        class BlockFileSink : public Sink
+        {
+        public:
+            // minblock: 数据累积到该大小才生成一个块,0表示每次写入单独成块
+            BlockFileSink(const std::string &filepath, size_t minblock = 0)
+                : _filepath(filepath), _minblock(minblock), _fp(nullptr), _rawoffset(0),
+                  _lastts(tool::Date::GetTime())
+            {
+                tool::File::createFilePath(tool::File::GetFilepath(filepath));
+                Open();
+            }
+            ~BlockFileSink() override
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!_fp)
+                    return;
+                Flush();
+                // 写入索引和文件尾
+                int64_t indexoffset = Block::Tell(_fp);
+                std::string index = Block::EncodeIndex(_blocks, static_cast<uint64_t>(indexoffset));
+                fwrite(index.data(), 1, index.size(), _fp);
+                fclose(_fp);
+            }
+            void WriteFile(const std::string &str) override
+            {
+                WriteData(str.data(), str.size());
+            }
+            void WriteData(const char *data, size_t len) override
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!_fp)
+                    return;
+                _pending.append(data, len);
+                if (_pending.size() >= _minblock)
+                    Flush();
+            }
+
+        private:
+            void Open()
+            {
+                Block::Reader reader;
+                if (reader.open(_filepath))
+                {
+                    // 已有文件:去掉旧索引(或崩溃留下的半个块)后继续追加
+                    _blocks = reader.blocks();
+                    uint64_t end = reader.dataEnd();
+                    reader.close();
+                    if (!_blocks.empty())
+                        _rawoffset = _blocks.back().rawoffset + _blocks.back().rawlen;
+                    tool::File::Truncate(_filepath, static_cast<size_t>(end));
+                    _fp = fopen(_filepath.c_str(), "r+b");
+                    if (_fp && !Block::Seek(_fp, static_cast<int64_t>(end)))
+                    {
+                        fclose(_fp);
+                        _fp = nullptr;
+                    }
+                }
+                else
+                {
+                    tool::File::FileInfo info;
+                    if (tool::File::GetFileInfo(_filepath, info) && info.size > 0)
+                    {
+                        // 无法识别的文件不覆盖,移到一边保留
+                        std::cout << "BlockFileSink 文件格式无法识别,已重命名为 " << _filepath << ".corrupt" << std::endl;
+                        std::rename(_filepath.c_str(), (_filepath + ".corrupt").c_str());
+                    }
+                    _fp = fopen(_filepath.c_str(), "wb");
+                    if (_fp)
+                    {
+                        std::string head(Block::FileMagic, 4);
+                        Block::PutU32(head, Block::Version);
+                        fwrite(head.data(), 1, head.size(), _fp);
+                    }
+                }
+                if (!_fp)
+                    std::cout << "BlockFileSink 文件打开失败" << std::endl;
+            }
+
+            // 调用时持有_mutex
+            void Flush()
+            {
+                if (_pending.empty())
+                    return;
+                _comp.resize(Codec::FastLZ::Bound(_pending.size()));
+                size_t c = Codec::FastLZ::Compress(_pending.data(), _pending.size(), &_comp[0]);
+                const char *data = _comp.data();
+                if (c >= _pending.size())
+                {
+                    c = _pending.size();
+                    data = _pending.data();
+                }
+
+                Block::BlockInfo b;
+                b.fileoffset = static_cast<uint64_t>(Block::Tell(_fp));
+                b.rawlen = static_cast<uint32_t>(_pending.size());
+                b.complen = static_cast<uint32_t>(c);
+                b.records = static_cast<uint32_t>(std::count(_pending.begin(), _pending.end(), '\n'));
+                // 时间范围取上一块写入到本块写入之间,本块记录均不晚于写入时间
+                b.tsmax = static_cast<uint64_t>(tool::Date::GetTime());
+                b.tsmin = std::min<uint64_t>(_lastts, b.tsmax);
+                b.rawoffset = _rawoffset;
+
+                std::string head = Block::EncodeBlockHeader(b);
+                fwrite(head.data(), 1, head.size(), _fp);
+                fwrite(data, 1, c, _fp);
+                fflush(_fp);
+
+                _blocks.push_back(b);
+                _rawoffset += b.rawlen;
+                _lastts = static_cast<time_t>(b.tsmax);
+                _pending.clear();
+            }
+
+        private:
+            std::string _filepath;
+            size_t _minblock;
+            FILE *_fp;
+            uint64_t _rawoffset;
+            time_t _lastts;
+            std::string _pending;
+            std::string _comp;
+            std::vector<Block::BlockInfo> _blocks;
+            std::mutex _mutex;
+        };
+
+        // 二进制日志文件,默认使用二进制格式(%B),用tools/logdecode还原为文本
+        // 每次打开写入会话记录,记录中的时间差以会话起始时间为基准
+        // 调用点字典由本落地方向在写入时补上,%B格式的输出只有经过它才能解码
+        class BinaryFileSink : public Sink
+        {
+        public:
+            BinaryFileSink(const std::string &filepath)
+                : _filepath(filepath), _fp(nullptr)
+            {
+                SetPattern(Data::BINARY);
+                tool::File::createFilePath(tool::File::GetFilepath(filepath));
+                Open();
+            }
+            ~BinaryFileSink() override
+            {
+                if (_fp)
+                    fclose(_fp);
+            }
+            void WriteFile(const std::string &str) override
+            {
+                WriteData(str.data(), str.size());
+            }
+            // data为若干完整的二进制日志记录,本会话第一次引用的调用点先写出字典记录
+            // 多个日志器可能共用该落地方向,加锁保护字典状态
+            void WriteData(const char *data, size_t len) override
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!_fp)
+                    return;
+                _out.clear();
+                if (_dict.annotate(data, len, _out))
+                    fwrite(_out.data(), 1, _out.size(), _fp);
+                else
+                    fwrite(data, 1, len, _fp);
+            }
+
+        private:
+            void Open()
+            {
+                tool::File::FileInfo info;
+                bool exists = tool::File::GetFileInfo(_filepath, info) && info.size > 0;
+                if (exists && !IsBinaryFile())
+                {
+                    // 无法识别的文件保留下来,重新开始
+                    std::rename(_filepath.c_str(), (_filepath + ".corrupt").c_str());
+                    exists = false;
+                }
+                _fp = fopen(_filepath.c_str(), "ab");
+                if (!_fp)
+                {
+                    std::cout << "BinaryFileSink 文件打开失败: " << _filepath << std::endl;
+                    return;
+                }
+                std::string head;
+                if (!exists)
+                {
+                    head.append(Binary::Magic, 4);
+                    Block::PutU32(head, Binary::Version);
+                }
+                head += Binary::SessionRecord();
+                _dict.reset();
+                fwrite(head.data(), 1, head.size(), _fp);
+                fflush(_fp);
+            }
+            bool IsBinaryFile()
+            {
+                char head[8];
+                FILE *fp = fopen(_filepath.c_str(), "rb");
+                if (!fp)
+                    return false;
+                bool ok = fread(head, 1, 8, fp) == 8 && memcmp(head, Binary::Magic, 4) == 0 &&
+                          Block::GetU32(head + 4) == Binary::Version;
+                fclose(fp);
+                return ok;
+            }
+
+        private:
+            std::string _filepath;
+            FILE *_fp;
+            std::mutex _mutex;
+            Binary::Dictionary _dict; // 本会话已经写出的字典
+            std::string _out;         // 补上字典后的内容,复用容量
+        };
     }
 
     class SinkFactory
@@ -228,9 +643,20 @@ namespace Log
         {
             return std::make_shared<SinkWay::FiletSink>(filepath);
         }
-        static Sink::ptr RollFileSink(size_t maxsize = Data::max_logfile_size(), const std::string &basefile = Data::defaultBFile())
+        static Sink::ptr RollFileSink(size_t maxsize = Data::max_logfile_size(), const std::string &basefile = Data::defaultBFile(),
+                                      Data::RollInterval interval = Data::rollInterval(),
+                                      const RetainPolicy &retain = RetainPolicy::Default(),
+                                      Data::CompressType compress = Data::compressType())
+        {
+            return std::make_shared<SinkWay::RollFileSink>(maxsize, basefile, interval, retain, compress);
+        }
+        static Sink::ptr BlockFileSink(const std::string &filepath, size_t minblock = 0)
+        {
+            return std::make_shared<SinkWay::BlockFileSink>(filepath, minblock);
+        }
+        static Sink::ptr BinaryFileSink(const std::string &filepath)
         {
-            return std::make_shared<SinkWay::RollFileSink>(maxsize, basefile);
+            return std::make_shared<SinkWay::BinaryFileSink>(filepath);
         }
     };
 }
\ No newline at end of file
@@ -4,11 +4,15 @@
 #include <ctime>
 #include <cstddef>
 #include <cstdio>
+#include <cstdint>
 #include <atomic>
+#include <vector>
+#include <fstream>
 // 跨平台头文件和宏定义
 #ifdef _WIN32
 #include <windows.h>
 #include <direct.h>
+#include <io.h>
 #define stat _stat
 #define mkdir _mkdir
 #else
@@ -34,13 +38,53 @@ namespace Log
             {
                 return time(nullptr);
             }
-           
+
+            // 计算nowt之后下一个整点(interval = 3600)或零点(interval = 86400)的时间
+            // 以本地时间为准,interval为其他值时直接返回nowt + interval
+            static time_t NextBoundary(time_t nowt, time_t interval)
+            {
+                struct tm t;
+#ifdef _WIN32
+                localtime_s(&t, &nowt);
+#else
+                localtime_r(&nowt, &t);
+#endif
+                if (interval == 3600)
+                {
+                    t.tm_min = 0;
+                    t.tm_sec = 0;
+                    t.tm_hour += 1;
+                }
+                else if (interval == 86400)
+                {
+                    t.tm_hour = 0;
+                    t.tm_min = 0;
+                    t.tm_sec = 0;
+                    t.tm_mday += 1;
+                }
+                else
+                {
+                    return nowt + interval;
+                }
+                t.tm_isdst = -1;
+                return mktime(&t);
+            }
         };
 
         class File
         {
 
         public:
+            // 目录扫描得到的文件信息
+            struct FileInfo
+            {
+                std::string path;
+                size_t size;
+                time_t mtime;
+                long mtime_ns; // 修改时间的纳秒部分,用于区分同一秒内滚动的文件
+                uint64_t inode; // 文件被替换后改变;不支持的平台上为0
+            };
+
             // 查看文件目录或普通文件是否存在
             static bool FileisExist(const std::string &filename)
             {
@@ -83,6 +127,159 @@ namespace Log
                 }
             }
 
+            static long MtimeNs(const struct stat &st)
+            {
+#if defined(_WIN32)
+                return 0;
+#elif defined(__APPLE__)
+                return st.st_mtimespec.tv_nsec;
+#else
+                return st.st_mtim.tv_nsec;
+#endif
+            }
+
+            // 获取单个文件的大小和修改时间,文件不存在时返回false
+            static bool GetFileInfo(const std::string &filename, FileInfo &info)
+            {
+                struct stat st;
+                if (stat(filename.c_str(), &st) != 0)
+                    return false;
+                info.path = filename;
+                info.size = static_cast<size_t>(st.st_size);
+                info.mtime = st.st_mtime;
+                info.mtime_ns = MtimeNs(st);
+                info.inode = static_cast<uint64_t>(st.st_ino);
+                return true;
+            }
+
+            // 先写入临时文件再重命名,保证读者看到的要么是旧内容要么是完整的新内容
+            static bool WriteFileAtomic(const std::string &filename, const std::string &content)
+            {
+                std::string tmp = filename + ".tmp";
+                {
+                    std::ofstream ofs(tmp, std::ofstream::trunc | std::ofstream::binary);
+                    if (!ofs.is_open())
+                        return false;
+                    ofs.write(content.c_str(), content.size());
+                    ofs.flush();
+                    if (!ofs.good())
+                        return false;
+                }
+#ifdef _WIN32
+                std::remove(filename.c_str());
+#endif
+                return std::rename(tmp.c_str(), filename.c_str()) == 0;
+            }
+
+            // 将文件截断到指定长度
+            static bool Truncate(const std::string &filename, size_t len)
+            {
+#ifdef _WIN32
+                FILE *f = fopen(filename.c_str(), "r+b");
+                if (!f)
+                    return false;
+                bool ok = _chsize_s(_fileno(f), static_cast<__int64>(len)) == 0;
+                fclose(f);
+                return ok;
+#else
+                return truncate(filename.c_str(), static_cast<off_t>(len)) == 0;
+#endif
+            }
+
+            // 通配符匹配:*匹配除'/'以外的任意字符,?匹配单个字符
+            static bool Glob(const char *pat, const char *str)
+            {
+                const char *star = nullptr, *back = nullptr;
+                while (*str)
+                {
+                    if (*pat == '*')
+                    {
+                        star = pat++;
+                        back = str;
+                    }
+                    else if (*pat == *str || (*pat == '?' && *str != '/'))
+                    {
+                        ++pat;
+                        ++str;
+                    }
+                    else if (star && *back != '/')
+                    {
+                        pat = star + 1;
+                        str = ++back;
+                    }
+                    else
+                        return false;
+                }
+                while (*pat == '*')
+                    ++pat;
+                return *pat == '\0';
+            }
+            // 路径匹配:pattern匹配完整路径或任意以'/'开始的后缀,
+            // 例如 "net/*" 匹配 "/src/net/conn.cpp","*.cpp" 匹配任意cpp文件
+            static bool MatchPath(const std::string &pattern, const std::string &path)
+            {
+                if (pattern.empty())
+                    return true;
+                if (Glob(pattern.c_str(), path.c_str()))
+                    return true;
+                for (size_t pos = path.find('/'); pos != std::string::npos; pos = path.find('/', pos + 1))
+                {
+                    if (Glob(pattern.c_str(), path.c_str() + pos + 1))
+                        return true;
+                }
+                return false;
+            }
+
+            // 按通配符列出匹配的普通文件及其大小和修改时间
+            static std::vector<FileInfo> ListFiles(const std::string &pattern)
+            {
+                std::vector<FileInfo> files;
+#ifdef _WIN32
+                std::string dir = GetFilepath(pattern);
+                WIN32_FIND_DATAA findData;
+                HANDLE hFind = FindFirstFileA(pattern.c_str(), &findData);
+                if (hFind == INVALID_HANDLE_VALUE)
+                    return files;
+                do
+                {
+                    if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                        continue;
+                    FileInfo info;
+                    info.path = dir + findData.cFileName;
+                    struct stat st;
+                    if (stat(info.path.c_str(), &st) != 0)
+                        continue;
+                    info.size = static_cast<size_t>(st.st_size);
+                    info.mtime = st.st_mtime;
+                    info.mtime_ns = 0;
+                    info.inode = static_cast<uint64_t>(st.st_ino);
+                    files.push_back(info);
+                } while (FindNextFileA(hFind, &findData));
+                FindClose(hFind);
+#else
+                glob_t glob_result;
+                if (glob(pattern.c_str(), GLOB_TILDE, nullptr, &glob_result) == 0)
+                {
+                    files.reserve(glob_result.gl_pathc);
+                    for (size_t i = 0; i < glob_result.gl_pathc; ++i)
+                    {
+                        struct stat st;
+                        if (stat(glob_result.gl_pathv[i], &st) != 0 || !S_ISREG(st.st_mode))
+                            continue;
+                        FileInfo info;
+                        info.path = glob_result.gl_pathv[i];
+                        info.size = static_cast<size_t>(st.st_size);
+                        info.mtime = st.st_mtime;
+                        info.mtime_ns = MtimeNs(st);
+                        info.inode = static_cast<uint64_t>(st.st_ino);
+                        files.push_back(info);
+                    }
+                }
+                globfree(&glob_result);
+#endif
+                return files;
+            }
+
             // 查找指定目录下的最新日志文件
             // baseDir: 日志文件所在目录
             // baseName: 日志文件基础名称
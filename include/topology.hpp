@@ -0,0 +1,241 @@
+#pragma once
+#include "sink.hpp"
+#include "logdata.hpp"
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+/*
+    配置文件中声明的日志器
+    1.log.logger.<日志器名称>.<属性> 声明日志器,log.sink.<落地方向名称>.<属性> 声明落地方向
+    2.日志器属性:
+        type        ASYNLOGGER/SYNCLOGGER,默认log.DLoggerType
+        ansy_ctrl   COMMON/THPOOL,默认log.DAnsyCtrlType
+        level       日志器等级,默认log.DLevel
+        format      日志器格式,默认log.format
+        sinks       逗号分隔的落地方向名称,为空时使用默认的滚动文件
+        buffer_size 每个落地方向的异步缓冲区大小(字节),默认log.max_buffer_size
+        overflow    缓冲区写满时的处理 BLOCK/DROP,作为各落地方向的默认值
+    3.落地方向属性:
+        type        STDOUT/FILE/ROLL/BLOCK/BINARY,必须设置
+        path        文件路径;ROLL为基础文件名,默认log.BaseFileName
+        level       只接收不低于该等级的日志
+        format      单独的输出格式
+        overflow    BLOCK/DROP,默认使用日志器的设置
+        max_size/roll_interval/compress/retain_count/retain_bytes/retain_seconds  ROLL的滚动与保留
+        min_block   BLOCK的最小块大小
+    4.一个落地方向只能属于一个日志器;无效的属性使用默认值,无效的落地方向被跳过,都输出提示
+    5.SingleManage第一次使用时按此创建所有声明的日志器(见logger.hpp)
+*/
+namespace Log
+{
+    // 一个声明的日志器,落地方向已经创建
+    struct LoggerSpec
+    {
+        std::string name;
+        Data::LogGerType type;
+        Data::AnsyCtrlType actrl;
+        LogLevel::VALUE level;
+        std::string format;
+        size_t buffer_size;
+        std::vector<Sink::ptr> sinks;
+    };
+
+    class Topology
+    {
+    public:
+        typedef std::map<std::string, std::string> Attrs;
+
+        // 按名称顺序返回快照中声明的日志器,错误信息追加到errors
+        // exists返回true的日志器已经存在,跳过且不创建其落地方向
+        static std::vector<LoggerSpec> Parse(const ConfigManager::Snapshot &snap, std::vector<std::string> &errors,
+                                             const std::function<bool(const std::string &)> &exists = nullptr)
+        {
+            std::map<std::string, Attrs> loggers, sinks;
+            for (auto &kv : snap.values)
+            {
+                if (!Group(kv.first, kv.second, "log.logger.", loggers, errors))
+                    Group(kv.first, kv.second, "log.sink.", sinks, errors);
+            }
+
+            std::vector<LoggerSpec> specs;
+            std::set<std::string> used;
+            for (auto &lg : loggers)
+            {
+                if (exists && exists(lg.first))
+                {
+                    for (const std::string &name : Split(lg.second["sinks"]))
+                        used.insert(name);
+                    continue;
+                }
+                const std::string where = "log.logger." + lg.first + ".";
+                Attrs attrs = lg.second;
+                LoggerSpec spec;
+                spec.name = lg.first;
+                spec.type = Data::StoLogGerType(Take(attrs, where, "type", Data::toString(Data::DLoggerType()),
+                                                     ConfigCheck::OneOf("ASYNLOGGER|SYNCLOGGER"), errors));
+                spec.actrl = Data::StoAnsyCtrlType(Take(attrs, where, "ansy_ctrl", Data::DAnsyCtrlType() == Data::THPOOL ? "THPOOL" : "COMMON",
+                                                        ConfigCheck::OneOf("COMMON|THPOOL"), errors));
+                spec.level = LogLevel::StoLevel(Take(attrs, where, "level", LogLevel::toString(Data::DLevel()),
+                                                     ConfigCheck::Level(), errors));
+                spec.format = Take(attrs, where, "format", Data::defaultformat(), ConfigCheck::NonEmpty(), errors);
+                spec.buffer_size = std::stoull(Take(attrs, where, "buffer_size", std::to_string(Data::max_buffer_size()),
+                                                    ConfigCheck::Range(1), errors));
+                Data::OverflowPolicy overflow = Data::StoOverflowPolicy(
+                    Take(attrs, where, "overflow", Data::overflowPolicy() == Data::DROP ? "DROP" : "BLOCK",
+                         ConfigCheck::OneOf("BLOCK|DROP"), errors));
+                std::string names = Take(attrs, where, "sinks", "", nullptr, errors);
+                Unknown(attrs, where, errors);
+
+                for (const std::string &name : Split(names))
+                {
+                    auto it = sinks.find(name);
+                    if (it == sinks.end())
+                    {
+                        errors.push_back(where + "sinks 中的落地方向 " + name + " 没有声明");
+                        continue;
+                    }
+                    if (!used.insert(name).second)
+                    {
+                        errors.push_back(where + "sinks 中的落地方向 " + name + " 已经属于其他日志器");
+                        continue;
+                    }
+                    Sink::ptr sink = CreateSink(name, it->second, overflow, errors);
+                    if (sink)
+                        spec.sinks.push_back(sink);
+                }
+                specs.push_back(spec);
+            }
+            for (auto &sk : sinks)
+            {
+                if (!used.count(sk.first))
+                    errors.push_back("log.sink." + sk.first + " 没有被任何日志器使用");
+            }
+            return specs;
+        }
+
+        // 逗号分隔的名称,去掉空白和空项
+        static std::vector<std::string> Split(const std::string &list)
+        {
+            std::vector<std::string> res;
+            size_t pos = 0;
+            while (pos <= list.size())
+            {
+                size_t end = list.find(',', pos);
+                if (end == std::string::npos)
+                    end = list.size();
+                std::string item = list.substr(pos, end - pos);
+                pos = end + 1;
+                size_t b = item.find_first_not_of(" \t");
+                if (b == std::string::npos)
+                    continue;
+                size_t e = item.find_last_not_of(" \t");
+                res.push_back(item.substr(b, e - b + 1));
+            }
+            return res;
+        }
+
+    private:
+        // 按前缀分组 前缀<名称>.<属性>,不是该前缀时返回false
+        static bool Group(const std::string &key, const std::string &value, const std::string &prefix,
+                          std::map<std::string, Attrs> &groups, std::vector<std::string> &errors)
+        {
+            if (key.compare(0, prefix.size(), prefix) != 0)
+                return false;
+            size_t dot = key.find('.', prefix.size());
+            if (dot == std::string::npos || dot == prefix.size() || dot + 1 == key.size())
+                errors.push_back(key + " 格式应为 " + prefix + "<名称>.<属性>");
+            else
+                groups[key.substr(prefix.size(), dot - prefix.size())][key.substr(dot + 1)] = value;
+            return true;
+        }
+
+        // 取出一个属性,没有设置或无效时返回默认值
+        static std::string Take(Attrs &attrs, const std::string &where, const std::string &attr,
+                                const std::string &def, const ConfigValidator &check, std::vector<std::string> &errors)
+        {
+            auto it = attrs.find(attr);
+            if (it == attrs.end())
+                return def;
+            std::string value = it->second;
+            attrs.erase(it);
+            if (check && !check(value))
+            {
+                errors.push_back(where + attr + "=" + value + " 无效,使用默认值 " + def);
+                return def;
+            }
+            return value;
+        }
+
+        // 剩下的属性都是不认识的
+        static void Unknown(const Attrs &attrs, const std::string &where, std::vector<std::string> &errors)
+        {
+            for (auto &a : attrs)
+                errors.push_back(where + a.first + " 不是可以设置的属性");
+        }
+
+        static Sink::ptr CreateSink(const std::string &name, Attrs attrs, Data::OverflowPolicy overflow,
+                                    std::vector<std::string> &errors)
+        {
+            const std::string where = "log.sink." + name + ".";
+            std::string type = Take(attrs, where, "type", "", ConfigCheck::OneOf("STDOUT|FILE|ROLL|BLOCK|BINARY"), errors);
+            std::string path = Take(attrs, where, "path", "", ConfigCheck::NonEmpty(), errors);
+            std::string level = Take(attrs, where, "level", "", ConfigCheck::Level(), errors);
+            std::string format = Take(attrs, where, "format", "", ConfigCheck::NonEmpty(), errors);
+            std::string policy = Take(attrs, where, "overflow", overflow == Data::DROP ? "DROP" : "BLOCK",
+                                      ConfigCheck::OneOf("BLOCK|DROP"), errors);
+
+            Sink::ptr sink;
+            if (type == "STDOUT")
+            {
+                sink = SinkFactory::StdoutSink();
+            }
+            else if (type == "ROLL")
+            {
+                size_t maxsize = std::stoull(Take(attrs, where, "max_size", std::to_string(Data::max_logfile_size()),
+                                                  ConfigCheck::Range(1), errors));
+                std::string interval = Take(attrs, where, "roll_interval", "", ConfigCheck::OneOf("NONE|HOURLY|DAILY"), errors);
+                std::string compress = Take(attrs, where, "compress", "", ConfigCheck::OneOf("NONE|GZIP|FAST"), errors);
+                RetainPolicy retain = RetainPolicy::Default();
+                retain.count = std::stoull(Take(attrs, where, "retain_count", std::to_string(retain.count), ConfigCheck::Range(0), errors));
+                retain.bytes = std::stoull(Take(attrs, where, "retain_bytes", std::to_string(retain.bytes), ConfigCheck::Range(0), errors));
+                retain.seconds = std::stoull(Take(attrs, where, "retain_seconds", std::to_string(retain.seconds), ConfigCheck::Range(0), errors));
+                sink = SinkFactory::RollFileSink(maxsize, path.empty() ? Data::defaultBFile() : path,
+                                                 interval.empty() ? Data::rollInterval() : Data::StoRollInterval(interval),
+                                                 retain, compress.empty() ? Data::compressType() : Data::StoCompressType(compress));
+            }
+            else if (path.empty() && !type.empty())
+            {
+                errors.push_back(where + "path 没有设置,跳过该落地方向");
+                return nullptr;
+            }
+            else if (type == "FILE")
+            {
+                sink = SinkFactory::FiletSink(path);
+            }
+            else if (type == "BLOCK")
+            {
+                size_t minblock = std::stoull(Take(attrs, where, "min_block", "0", ConfigCheck::Range(0), errors));
+                sink = SinkFactory::BlockFileSink(path, minblock);
+            }
+            else if (type == "BINARY")
+            {
+                sink = SinkFactory::BinaryFileSink(path);
+            }
+            else
+            {
+                errors.push_back(where + "type 没有设置或无效,跳过该落地方向");
+                return nullptr;
+            }
+            Unknown(attrs, where, errors);
+
+            if (!level.empty())
+                sink->SetLevel(LogLevel::StoLevel(level));
+            if (!format.empty())
+                sink->SetPattern(format);
+            sink->SetOverflow(Data::StoOverflowPolicy(policy));
+            return sink;
+        }
+    };
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "callsite.hpp"
+#include "logdata.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+/*
+    按模块设置日志等级(vmodule)
+    规则形如 "db/pool.cpp=WARNING,*.cpp=DEBUG",按顺序匹配__FILE__,第一条匹配的规则生效
+    匹配结果缓存在调用点中,规则变化时版本号加一,调用点下次执行时重新匹配
+    稳定状态下每次日志只比较一次版本号
+*/
+namespace Log
+{
+    class VModule
+    {
+    public:
+        static VModule &getInstance()
+        {
+            static VModule instance;
+            return instance;
+        }
+
+        // 设置规则,格式错误的条目被忽略,全部有效时返回true
+        bool set(const std::string &spec)
+        {
+            std::vector<Rule> rules;
+            bool ok = Parse(spec, rules);
+            std::unique_lock<std::mutex> lock(_mutex);
+            _spec = spec;
+            _rules.swap(rules);
+            _gen.fetch_add(1, std::memory_order_release);
+            return ok;
+        }
+        std::string spec()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _spec;
+        }
+
+        // 调用点适用的等级,没有规则匹配时返回UNKNOW(使用日志器等级)
+        LogLevel::VALUE level(CallSite &site)
+        {
+            uint64_t cache = site.vcache.load(std::memory_order_relaxed);
+            uint32_t gen = _gen.load(std::memory_order_acquire);
+            if (static_cast<uint32_t>(cache >> 32) == gen)
+                return static_cast<LogLevel::VALUE>(cache & 0xffffffff);
+            return Resolve(site);
+        }
+
+    private:
+        struct Rule
+        {
+            std::string pattern;
+            LogLevel::VALUE level;
+        };
+
+        // 版本号从1开始,调用点的初始缓存(0)一定失效
+        VModule()
+            : _gen(1)
+        {
+            Parse(Data::vmodule(), _rules);
+            _spec = Data::vmodule();
+        }
+
+        LogLevel::VALUE Resolve(CallSite &site)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            uint32_t gen = _gen.load(std::memory_order_relaxed);
+            LogLevel::VALUE lv = LogLevel::UNKNOW;
+            for (auto &r : _rules)
+            {
+                if (tool::File::MatchPath(r.pattern, site.file))
+                {
+                    lv = r.level;
+                    break;
+                }
+            }
+            site.vcache.store((uint64_t(gen) << 32) | uint32_t(lv), std::memory_order_relaxed);
+            return lv;
+        }
+
+        static std::string Trim(const std::string &s)
+        {
+            size_t b = s.find_first_not_of(" \t");
+            if (b == std::string::npos)
+                return "";
+            size_t e = s.find_last_not_of(" \t");
+            return s.substr(b, e - b + 1);
+        }
+        static bool Parse(const std::string &spec, std::vector<Rule> &rules)
+        {
+            bool ok = true;
+            size_t pos = 0;
+            while (pos <= spec.size())
+            {
+                size_t end = spec.find(',', pos);
+                if (end == std::string::npos)
+                    end = spec.size();
+                std::string item = Trim(spec.substr(pos, end - pos));
+                pos = end + 1;
+                if (item.empty())
+                    continue;
+                size_t eq = item.rfind('=');
+                LogLevel::VALUE lv = eq == std::string::npos ? LogLevel::UNKNOW
+                                                             : LogLevel::StoLevel(Trim(item.substr(eq + 1)));
+                std::string pattern = eq == std::string::npos ? "" : Trim(item.substr(0, eq));
+                if (lv == LogLevel::UNKNOW || pattern.empty())
+                {
+                    ok = false;
+                    continue;
+                }
+                rules.push_back(Rule{pattern, lv});
+            }
+            return ok;
+        }
+
+    private:
+        std::mutex _mutex;
+        std::atomic<uint32_t> _gen;
+        std::string _spec;
+        std::vector<Rule> _rules;
+    };
+}
@@ -0,0 +1,160 @@
+// free释放operator new返回的指针是这里有意为之
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+#include "../include/log.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+/*
+    日志路径内存分配测试
+    替换全局operator new统计调用线程上的分配次数,
+    预热之后的日志调用(格式化、结构化字段、上下文、写入通道)不应再分配内存
+    全局operator new被替换,因此单独作为一个测试程序
+*/
+
+static thread_local bool g_counting = false;
+static std::atomic<size_t> g_allocs(0);
+
+void *operator new(size_t size)
+{
+    if (g_counting)
+        ++g_allocs;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// 只统计调用线程在func执行期间的分配次数
+template <class F>
+size_t CountAllocs(F func)
+{
+    g_allocs = 0;
+    g_counting = true;
+    func();
+    g_counting = false;
+    return g_allocs;
+}
+
+class NullSink : public Log::Sink
+{
+public:
+    void WriteFile(const std::string &str) override { _bytes += str.size(); }
+    size_t _bytes = 0;
+};
+
+struct Point
+{
+    int x, y;
+};
+std::ostream &operator<<(std::ostream &out, const Point &p)
+{
+    return out << '(' << p.x << ',' << p.y << ')';
+}
+
+void LogOnce(Log::LogGer::Logger::ptr &logger, int i)
+{
+    std::string name = "订单";
+    logger->INFO("整数{} 浮点{} 字符串{} 指针{} 自定义{}", i, i * 0.5, name, "常量", Point{i, -i},
+                 mylog::kv("id", i), mylog::kv("ok", true));
+    logger->DEBUG("调试{}", i);
+    logger->WARNING("没有参数");
+}
+
+// 测试1：同步日志器稳定后不分配内存
+void test_sync_no_alloc()
+{
+    std::cout << "=== 测试1：同步日志器内存分配测试 ===" << std::endl;
+
+    Log::Director d;
+    auto sink = d.AddSink<NullSink>();
+    auto logger = d.LocalLogder("同步分配测试", Log::Data::LogGerType::SYNCLOGGER, Log::LogLevel::DEBUG,
+                                "[%L][%N][{%Y-%m-%d %H:%M:%S}][%f:%l][%t] %X{req} %c %F%n",
+                                Log::Data::AnsyCtrlType::COMMON);
+    Log::MDC::Scope req("req", "r-42");
+
+    for (int i = 0; i < 100; ++i)
+        LogOnce(logger, i);
+    size_t n = CountAllocs([&]()
+                           {
+        for (int i = 0; i < 1000; ++i)
+            LogOnce(logger, i); });
+    std::cout << "1000次调用分配次数: " << n << std::endl;
+    assert(n == 0);
+    assert(std::static_pointer_cast<NullSink>(sink)->_bytes > 0);
+}
+
+// 测试2：JSON格式同样不分配内存
+void test_json_no_alloc()
+{
+    std::cout << "\n=== 测试2：JSON格式内存分配测试 ===" << std::endl;
+
+    Log::Director d;
+    d.AddSink<NullSink>();
+    auto logger = d.LocalLogder("JSON分配测试", Log::Data::LogGerType::SYNCLOGGER, Log::LogLevel::DEBUG,
+                                Log::Data::JSONLINES, Log::Data::AnsyCtrlType::COMMON);
+    for (int i = 0; i < 100; ++i)
+        LogOnce(logger, i);
+    size_t n = CountAllocs([&]()
+                           {
+        for (int i = 0; i < 1000; ++i)
+            LogOnce(logger, i); });
+    std::cout << "1000次调用分配次数: " << n << std::endl;
+    assert(n == 0);
+}
+
+// 测试3：异步日志器的调用线程不分配内存
+void test_async_no_alloc()
+{
+    std::cout << "\n=== 测试3：异步日志器内存分配测试 ===" << std::endl;
+
+    Log::Director d;
+    d.AddSink<NullSink>();
+    auto logger = d.LocalLogder("异步分配测试", Log::Data::LogGerType::ASYNLOGGER, Log::LogLevel::DEBUG,
+                                Log::Data::defaultformat(), Log::Data::AnsyCtrlType::COMMON);
+    // 延迟采样同样不分配内存
+    logger->SetLatencySample(7);
+    for (int i = 0; i < 100; ++i)
+        LogOnce(logger, i);
+    size_t n = CountAllocs([&]()
+                           {
+        for (int i = 0; i < 1000; ++i)
+            LogOnce(logger, i); });
+    std::cout << "1000次调用分配次数: " << n << std::endl;
+    assert(n == 0);
+}
+
+// 测试4：被过滤的日志不分配内存
+void test_filtered_no_alloc()
+{
+    std::cout << "\n=== 测试4：过滤日志内存分配测试 ===" << std::endl;
+
+    Log::Director d;
+    d.AddSink<NullSink>();
+    auto logger = d.LocalLogder("过滤分配测试", Log::Data::LogGerType::SYNCLOGGER, Log::LogLevel::FATAL,
+                                Log::Data::defaultformat(), Log::Data::AnsyCtrlType::COMMON);
+    LogOnce(logger, 0);
+    size_t n = CountAllocs([&]()
+                           {
+        for (int i = 0; i < 1000; ++i)
+            LogOnce(logger, i); });
+    std::cout << "1000次调用分配次数: " << n << std::endl;
+    assert(n == 0);
+}
+
+int main()
+{
+    // 统计本身有效
+    assert(CountAllocs([]()
+                       { std::string s(100, 'x'); }) == 1);
+    test_sync_no_alloc();
+    test_json_no_alloc();
+    test_async_no_alloc();
+    test_filtered_no_alloc();
+    std::cout << "\n=== 所有测试完成 ===" << std::endl;
+    return 0;
+}
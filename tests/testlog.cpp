@@ -3,6 +3,13 @@
 #include <vector>
 #include <chrono>
 #include <cassert>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 // 测试1：基本功能测试
 void test_basic_functionality() {
@@ -300,6 +307,1472 @@ void test_logger_management() {
     default_sync->Info(__LINE__, __FILE__, "通过管理器获取的默认同步日志器");
 }
 
+// 测试11：滚动文件保留策略
+void test_roll_retention() {
+    std::cout << "\n=== 测试11：滚动文件保留策略测试 ===" << std::endl;
+
+    Log::Director d;
+    // 每个文件约1000字节,按小时滚动,最多保留3个文件
+    d.AddSink<Log::SinkWay::RollFileSink>(1000, "./test_logs/retain/retain_log",
+                                          Log::Data::HOURLY, Log::RetainPolicy(3));
+    auto logger = d.LocalLogder(
+        "保留策略日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::INFO,
+        "[%L] %c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+
+    for (int i = 0; i < 200; ++i) {
+        logger->Info(__LINE__, __FILE__, "保留策略测试日志 {} 这是一条用于触发滚动的较长日志消息", i);
+    }
+
+    // 清理在后台线程进行,等待已提交的任务完成
+    Log::LogCleaner::getInstance().drain();
+    auto files = Log::tool::File::ListFiles("./test_logs/retain/retain_log[0-9]*_*.txt");
+    assert(files.size() <= 3 && "滚动后历史文件个数应不超过保留上限");
+}
+
+// 测试12：滚动文件状态恢复
+void test_roll_state() {
+    std::cout << "\n=== 测试12：滚动文件状态恢复测试 ===" << std::endl;
+
+    system("rm -rf ./test_logs/state");
+    {
+        Log::SinkWay::RollFileSink sink(100000, "./test_logs/state/state_log");
+        sink.WriteFile("第一次启动写入的日志\n");
+    }
+    {
+        // 再次启动时应通过状态文件继续写入同一个文件
+        Log::SinkWay::RollFileSink sink(100000, "./test_logs/state/state_log");
+        sink.WriteFile("第二次启动写入的日志\n");
+    }
+    auto files = Log::tool::File::ListFiles("./test_logs/state/state_log[0-9]*_*.txt");
+    assert(files.size() == 1 && "重启后应继续写入状态文件记录的文件");
+    assert(Log::tool::File::FileisExist("./test_logs/state/state_log.state") && "应生成状态文件");
+
+    // 记录的文件被另一个更大的同名文件替换(inode不同),状态过期,应创建新文件
+    std::string current = files[0].path;
+    {
+        std::ofstream out(current + ".new");
+        out << std::string(4096, 'x') << "\n";
+    }
+    std::rename((current + ".new").c_str(), current.c_str());
+    {
+        Log::SinkWay::RollFileSink sink(100000, "./test_logs/state/state_log");
+        sink.WriteFile("文件被替换后写入的日志\n");
+    }
+    files = Log::tool::File::ListFiles("./test_logs/state/state_log[0-9]*_*.txt");
+    assert(files.size() == 2 && "被替换的文件不应继续写入");
+
+    // 序号超过旧版本的回绕上限(默认50)后仍应递增,序号顺序与写入顺序一致
+    system("rm -rf ./test_logs/serial");
+    {
+        Log::SinkWay::RollFileSink sink(100, "./test_logs/serial/serial_log");
+        for (int i = 0; i < 80; ++i)
+            sink.WriteFile("序号测试 " + std::to_string(i) + " " + std::string(100, 's') + "\n");
+    }
+    {
+        // 重启后从状态文件记录的最大序号继续
+        Log::SinkWay::RollFileSink sink(100, "./test_logs/serial/serial_log");
+        sink.WriteFile("序号测试 80 " + std::string(100, 's') + "\n");
+    }
+    files = Log::tool::File::ListFiles("./test_logs/serial/serial_log[0-9]*_*.txt");
+    const size_t prefix = std::string("./test_logs/serial/serial_log").size();
+    std::sort(files.begin(), files.end(), [&](const Log::tool::File::FileInfo &a, const Log::tool::File::FileInfo &b)
+              { return std::stoul(a.path.substr(prefix)) < std::stoul(b.path.substr(prefix)); });
+    // 每次写入超过阈值都会滚动,最后一次滚动新建的文件为空
+    assert(files.size() == 82 && files.back().size == 0 && "序号回绕会导致新记录追加到旧文件");
+    assert(std::stoul(files.back().path.substr(prefix)) > 80 && "序号不应回绕");
+    for (size_t i = 0; i + 1 < files.size(); ++i) {
+        std::ifstream ifs(files[i].path);
+        std::string line;
+        std::getline(ifs, line);
+        assert(line.find("序号测试 " + std::to_string(i) + " ") == 0 && "按序号排列的文件应与写入顺序一致");
+    }
+}
+
+// 测试13：滚动后压缩
+void test_roll_compress() {
+    std::cout << "\n=== 测试13：滚动后压缩测试 ===" << std::endl;
+
+    system("rm -rf ./test_logs/compress");
+    {
+        Log::SinkWay::RollFileSink sink(4000, "./test_logs/compress/zip_log", Log::Data::NONE,
+                                        Log::RetainPolicy(), Log::Data::FAST);
+        for (int i = 0; i < 100; ++i) {
+            sink.WriteFile("压缩测试日志 " + std::to_string(i) + " 重复的内容重复的内容重复的内容\n");
+        }
+    }
+    Log::Compressor::getInstance().drain();
+
+    auto zipped = Log::tool::File::ListFiles("./test_logs/compress/zip_log[0-9]*_*.txt.flz");
+    assert(!zipped.empty() && "滚动后的旧文件应被压缩");
+    auto tmps = Log::tool::File::ListFiles("./test_logs/compress/*.tmp");
+    assert(tmps.empty() && "压缩完成后不应残留临时文件");
+
+    // 解压后内容应与原始日志一致
+    FILE *in = fopen(zipped[0].path.c_str(), "rb");
+    FILE *out = fopen("./test_logs/compress/unzip.txt", "wb");
+    bool ok = Log::Codec::FastLZ::DecompressStream(in, out);
+    fclose(in);
+    fclose(out);
+    assert(ok && "压缩文件应能正确解压");
+    std::ifstream ifs("./test_logs/compress/unzip.txt");
+    std::string first;
+    std::getline(ifs, first);
+    assert(first.find("压缩测试日志 0 ") == 0 && "解压内容应与原始日志一致");
+
+    // 模拟压缩过程中崩溃:原文件和不完整的临时文件都在
+    const std::string crashed = "./test_logs/compress/zip_log900_20200101000000.txt";
+    {
+        std::ofstream(crashed) << "崩溃前没有压缩完的日志\n";
+        std::ofstream(crashed + ".flz.tmp") << "不完整";
+    }
+    {
+        // 启动时删除临时文件并重新压缩原文件
+        Log::SinkWay::RollFileSink sink(4000, "./test_logs/compress/zip_log", Log::Data::NONE,
+                                        Log::RetainPolicy(), Log::Data::FAST);
+    }
+    Log::Compressor::getInstance().drain();
+    assert(Log::tool::File::ListFiles("./test_logs/compress/*.tmp").empty() && "遗留的临时文件应被删除");
+    assert(!Log::tool::File::FileisExist(crashed) && Log::tool::File::FileisExist(crashed + ".flz"));
+
+#ifdef LOG_USE_ZLIB
+    // gzip输出标准gzip流,用zlib读回
+    const std::string plain = "./test_logs/compress/gzip_src.txt";
+    std::string content;
+    for (int i = 0; i < 1000; ++i)
+        content += "gzip压缩测试 " + std::to_string(i) + "\n";
+    std::ofstream(plain) << content;
+    assert(Log::Compressor::CompressFile(plain, Log::Data::GZIP));
+    assert(!Log::tool::File::FileisExist(plain) && Log::tool::File::FileisExist(plain + ".gz"));
+    gzFile gz = gzopen((plain + ".gz").c_str(), "rb");
+    assert(gz);
+    std::string unzipped;
+    char buf[4096];
+    int n;
+    while ((n = gzread(gz, buf, sizeof(buf))) > 0)
+        unzipped.append(buf, n);
+    gzclose(gz);
+    assert(unzipped == content && "gzip解压内容应与原文件一致");
+    std::cout << "gzip压缩" << content.size() << "字节" << std::endl;
+#endif
+}
+
+// 测试14：块压缩日志文件
+void test_block_file() {
+    std::cout << "\n=== 测试14：块压缩日志文件测试 ===" << std::endl;
+
+    system("rm -rf ./test_logs/block");
+    std::string expect;
+    {
+        Log::SinkWay::BlockFileSink sink("./test_logs/block/block.lblk");
+        for (int i = 0; i < 10; ++i) {
+            std::string batch;
+            for (int j = 0; j < 50; ++j)
+                batch += "块压缩测试 批次" + std::to_string(i) + " 记录" + std::to_string(j) + "\n";
+            expect += batch;
+            sink.WriteFile(batch);
+        }
+    }
+    {
+        // 重新打开后继续追加
+        Log::SinkWay::BlockFileSink sink("./test_logs/block/block.lblk");
+        sink.WriteFile("重新打开后追加的记录\n");
+        expect += "重新打开后追加的记录\n";
+    }
+
+    Log::Block::Reader reader;
+    assert(reader.open("./test_logs/block/block.lblk") && "块文件应能打开");
+    assert(reader.indexed() && "正常关闭的块文件应带有索引");
+    assert(reader.blocks().size() == 11 && "每次写入应生成一个块");
+    assert(reader.blocks()[0].records == 50 && "块头应记录记录数");
+
+    std::string all, data;
+    for (size_t i = reader.seek(0); i < reader.blocks().size(); ++i) {
+        assert(reader.read(i, data) && "块应能独立解压");
+        all += data;
+    }
+    assert(all == expect && "解压内容应与写入内容一致");
+
+    // 多个线程同时写入同一个块文件(如两个同步日志器共用),块头和索引不交错
+    {
+        Log::SinkWay::BlockFileSink shared("./test_logs/block/shared.lblk");
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 4; ++t)
+            writers.emplace_back([&shared, t]() {
+                for (int i = 0; i < 200; ++i)
+                    shared.WriteFile("线程" + std::to_string(t) + " 批次" + std::to_string(i) + "\n");
+            });
+        for (auto &w : writers)
+            w.join();
+    }
+    Log::Block::Reader sr;
+    assert(sr.open("./test_logs/block/shared.lblk") && sr.indexed() && sr.blocks().size() == 800);
+    size_t lines = 0;
+    for (size_t i = 0; i < sr.blocks().size(); ++i) {
+        assert(sr.read(i, data) && "并发写入的块应能独立解压");
+        assert(data.find("线程") == 0 && data.back() == '\n');
+        lines += std::count(data.begin(), data.end(), '\n');
+    }
+    assert(lines == 800);
+}
+
+// 测试15：落地方向相互独立
+class SlowSink : public Log::Sink {
+public:
+    void WriteFile(const std::string &) override {
+        // 模拟被堵住的终端
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+};
+// 记录同时进入WriteFile的最大线程数
+class SerialSink : public Log::Sink {
+public:
+    void WriteFile(const std::string &str) override {
+        int n = ++_inside;
+        int m = _max;
+        while (n > m && !_max.compare_exchange_weak(m, n)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        _bytes += str.size();
+        --_inside;
+    }
+    std::atomic<int> _inside{0};
+    std::atomic<int> _max{0};
+    std::atomic<size_t> _bytes{0};
+};
+class CountSink : public Log::Sink {
+public:
+    void WriteFile(const std::string &str) override { _bytes += str.size(); }
+    std::atomic<size_t> _bytes{0};
+};
+
+void test_independent_sinks() {
+    std::cout << "\n=== 测试15：落地方向独立分发测试 ===" << std::endl;
+
+    Log::Director d;
+    d.AddSink<SlowSink>()->SetOverflow(Log::Data::DROP);
+    auto fast = std::static_pointer_cast<CountSink>(d.AddSink<CountSink>());
+    auto logger = d.LocalLogder(
+        "独立分发日志器",
+        Log::Data::LogGerType::ASYNLOGGER,
+        Log::LogLevel::INFO,
+        "[%L] %c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 30000; ++i) {
+        logger->Info(__LINE__, __FILE__, "独立分发测试消息 {} 这是一条用于填满缓冲区的较长日志消息", i);
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "写入耗时: " << cost.count() << "ms" << std::endl;
+
+    // 快速落地方向应很快追上,不受慢速落地方向影响
+    for (int i = 0; i < 100 && logger->getSinkStats()[1].lag > 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto stats = logger->getSinkStats();
+    assert(stats[0].dropped > 0 && "慢速落地方向应按DROP策略丢弃日志");
+    assert(stats[1].dropped == 0 && stats[1].lag == 0 && "快速落地方向不应丢失或积压日志");
+    assert(fast->_bytes == stats[1].pushed && "快速落地方向应收到全部日志");
+
+    // 线程池控制器:同一落地方向的写出不并发,BLOCK策略下写满时等待而不丢弃
+    Log::Director td;
+    auto serial = std::static_pointer_cast<SerialSink>(td.AddSink<SerialSink>());
+    auto thpool = td.LocalLogder(
+        "线程池分发日志器",
+        Log::Data::LogGerType::ASYNLOGGER,
+        Log::LogLevel::INFO,
+        "%c%n",
+        Log::Data::AnsyCtrlType::THPOOL
+    );
+    assert(thpool->getSinkStats()[0].overflow == Log::Data::BLOCK);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t)
+        producers.emplace_back([&thpool]() {
+            std::string line(200, 's');
+            for (int i = 0; i < 5000; ++i)
+                thpool->INFO(line);
+        });
+    for (auto &p : producers)
+        p.join();
+    // 没有写满的缓冲区留到下次写满或停止时写出
+    for (int i = 0; i < 200 && thpool->getSinkStats()[0].lag >= Log::Data::max_buffer_size(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto ts = thpool->getSinkStats()[0];
+    assert(serial->_max == 1 && "同一落地方向不应被并发写入");
+    assert(ts.dropped == 0 && ts.pushed == 4 * 5000 * 201 && "BLOCK策略不应丢弃");
+    assert(ts.written > 0 && serial->_bytes == ts.written && ts.lag < Log::Data::max_buffer_size());
+    std::cout << "线程池控制器交换" << ts.swaps << "次, 写入" << serial->_bytes << "字节" << std::endl;
+}
+
+// 测试16：落地方向级别过滤与独立格式
+class CaptureSink : public Log::Sink {
+public:
+    void WriteFile(const std::string &str) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _lines.push_back(str);
+    }
+    std::mutex _mutex;
+    std::vector<std::string> _lines;
+};
+
+void test_sink_level_pattern() {
+    std::cout << "\n=== 测试16：落地方向级别过滤与格式测试 ===" << std::endl;
+
+    Log::Director d;
+    auto console = d.AddSink<CaptureSink>();
+    console->SetLevel(Log::LogLevel::WARNING).SetPattern("[%L] %c%n");
+    auto file = d.AddSink<CaptureSink>();
+    auto logger = d.LocalLogder(
+        "落地级别日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::DEBUG,
+        "[%L][%N][%f:%l] %c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+
+    logger->Debug(__LINE__, __FILE__, "调试信息");
+    logger->Warning(__LINE__, __FILE__, "警告信息");
+
+    auto &c = std::static_pointer_cast<CaptureSink>(console)->_lines;
+    auto &f = std::static_pointer_cast<CaptureSink>(file)->_lines;
+    assert(c.size() == 1 && c[0] == "[WARNING] 警告信息\n" && "终端只接收WARNING及以上的短格式日志");
+    assert(f.size() == 2 && f[0].find("[DEBUG][落地级别日志器_SYNCLOGGER][") == 0 && "文件接收全部完整格式日志");
+
+    // 所有落地方向都不接收时直接丢弃
+    file->SetLevel(Log::LogLevel::ERRNO);
+    logger->Info(__LINE__, __FILE__, "不会被任何落地方向接收");
+    assert(c.size() == 1 && f.size() == 2 && "没有落地方向接收的日志不应输出");
+}
+
+// 测试17：结构化字段与JSON lines
+void test_structured_fields() {
+    std::cout << "\n=== 测试17：结构化字段与JSON输出测试 ===" << std::endl;
+
+    Log::Director d;
+    auto json = d.AddSink<CaptureSink>();
+    json->SetPattern(Log::Data::JSONLINES);
+    auto text = d.AddSink<CaptureSink>();
+    text->SetPattern("%c%n");
+    auto logger = d.LocalLogder(
+        "结构化日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::DEBUG,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+
+    std::string name = "引号\"与反斜杠\\以及换行\n和制表\t超过十六字节的字符串";
+    logger->Info(__LINE__, __FILE__, "order placed {}", Log::kv("id", 42), "ok",
+                 Log::kv("ms", 1.5), Log::kv("paid", true), Log::kv("name", name));
+
+    auto &j = std::static_pointer_cast<CaptureSink>(json)->_lines;
+    auto &t = std::static_pointer_cast<CaptureSink>(text)->_lines;
+    assert(j.size() == 1 && t.size() == 1);
+    assert(j[0].find("\"msg\":\"order placed ok\"") != std::string::npos && "占位符参数不受字段影响");
+    assert(j[0].find("\"id\":42,\"ms\":1.5,\"paid\":true") != std::string::npos && "字段保持原始类型");
+    assert(j[0].find("\"name\":\"引号\\\"与反斜杠\\\\以及换行\\n和制表\\t超过十六字节的字符串\"}") != std::string::npos && "字符串应正确转义");
+    assert(j[0].back() == '\n' && "每条日志占一行");
+    assert(t[0].find("order placed ok id=42 ms=1.5 paid=true name=") == 0 && "文本格式中字段跟随内容输出");
+}
+
+// 测试18：二进制日志格式
+void test_binary_format() {
+    std::cout << "\n=== 测试18：二进制日志格式测试 ===" << std::endl;
+
+    system("rm -rf ./test_logs/binary");
+    const std::string path = "./test_logs/binary/app.blog";
+    std::vector<std::string> expect;
+    for (int session = 0; session < 2; ++session) {
+        // 每次创建新的落地方向都会在文件中开始一个新会话
+        Log::Director d;
+        d.AddSink<Log::SinkWay::BinaryFileSink>(path);
+        auto text = d.AddSink<CaptureSink>();
+        text->SetPattern("%c%n");
+        auto logger = d.LocalLogder(
+            "二进制日志器" + std::to_string(session),
+            Log::Data::LogGerType::SYNCLOGGER,
+            Log::LogLevel::DEBUG,
+            "%c%n",
+            Log::Data::AnsyCtrlType::COMMON
+        );
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; ++t) {
+            threads.emplace_back([&logger, t]() {
+                for (int i = 0; i < 100; ++i) {
+                    logger->Info(__LINE__, __FILE__, "线程{} 第{}条 {} {}", t, i, -i * 1000, std::string("文本"));
+                    logger->Warning(__LINE__, __FILE__, "比例{} 标记{} 字符{}", 0.25 * i, i % 2 == 0, 'x',
+                                    Log::kv("user", "alice"), Log::kv("n", i), Log::kv("even", i % 2 == 0));
+                }
+            });
+        }
+        for (auto &th : threads) th.join();
+        auto &lines = std::static_pointer_cast<CaptureSink>(text)->_lines;
+        expect.insert(expect.end(), lines.begin(), lines.end());
+    }
+
+    std::ifstream ifs(path, std::ios::binary);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    std::vector<std::string> decoded;
+    size_t warnings = 0;
+    bool ok = Log::Binary::Decode(ss.str(), [&](const Log::Binary::Entry &e) {
+        decoded.push_back(e.content + "\n");
+        if (e.level == Log::LogLevel::WARNING) ++warnings;
+    });
+    assert(ok && "完整的二进制文件应能全部解码");
+    assert(decoded.size() == 800 && warnings == 400);
+    std::sort(expect.begin(), expect.end());
+    std::sort(decoded.begin(), decoded.end());
+    assert(decoded == expect && "解码内容应与文本格式一致");
+    assert(ss.str().size() < 800 * 45 && "调用点信息只应写入一次");
+
+    // 写了一半的记录不影响之前的内容
+    std::string torn = ss.str().substr(0, ss.str().size() - 3);
+    size_t count = 0;
+    ok = Log::Binary::Decode(torn, [&](const Log::Binary::Entry &) { ++count; });
+    assert(!ok && count == 799 && "截断的文件应还原截断点之前的日志");
+
+    // 找不到字典的日志记录被跳过,不影响其他记录
+    std::string orphan = ss.str();
+    orphan += 'R';
+    Log::Binary::PutVar(orphan, 999999);
+    Log::Binary::PutVar(orphan, 1);
+    Log::Binary::PutVar(orphan, 1);
+    Log::Binary::PutVar(orphan, 0);
+    size_t skipped = 0;
+    count = 0;
+    ok = Log::Binary::Decode(orphan, [&](const Log::Binary::Entry &) { ++count; }, &skipped);
+    assert(ok && count == 800 && skipped == 1);
+
+    // 调用点第一次的日志被丢弃时,后面的日志仍然带有字典
+    const std::string dropped_path = "./test_logs/binary/drop.blog";
+    size_t dropped = 0;
+    {
+        Log::Sink::ptr sink = Log::SinkFactory::BinaryFileSink(dropped_path);
+        sink->SetOverflow(Log::Data::DROP);
+        Log::LogGer::LoggerBuilder::ptr bp = std::make_shared<Log::LogGer::LocalLogder>();
+        bp->InitLevel(Log::LogLevel::DEBUG);
+        bp->InitLoggerType(Log::Data::ASYNLOGGER);
+        bp->InitLoggername("二进制丢弃日志器");
+        bp->InitFormat("%c%n");
+        bp->InitSinkWay(std::vector<Log::Sink::ptr>{sink});
+        // 缓冲区放不下第一条日志
+        bp->InitAnsyCtrlCreator(Log::ACtrlFactory::CreatorOf(Log::Data::COMMON, 64));
+        auto logger = bp->InitLB();
+        for (int i = 0; i < 5; ++i) {
+            logger->Info(__LINE__, __FILE__, "丢弃测试{}", i == 0 ? std::string(100000, 'x') : std::to_string(i));
+            // 等待后台写完再写下一条,只有第一条被丢弃
+            for (int n = 0; n < 1000 && logger->getSinkStats()[0].lag; ++n)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        dropped = logger->getSinkStats()[0].dropped;
+    }
+    std::ifstream dfs(dropped_path, std::ios::binary);
+    std::stringstream dss;
+    dss << dfs.rdbuf();
+    std::ostringstream tid;
+    tid << std::this_thread::get_id();
+    std::vector<std::string> contents;
+    skipped = 0;
+    ok = Log::Binary::Decode(dss.str(), [&](const Log::Binary::Entry &e) {
+        contents.push_back(e.content);
+        // 线程号与文本格式的%t一致
+        assert(std::to_string(e.tid) == tid.str());
+    }, &skipped);
+    assert(dropped == 1 && ok && skipped == 0);
+    assert(contents.size() == 4 && contents[0] == "丢弃测试1" && contents[3] == "丢弃测试4");
+    std::cout << "丢弃" << dropped << "条后解码" << contents.size() << "条" << std::endl;
+}
+
+// 测试19：回溯缓冲
+void test_backtrace() {
+    std::cout << "\n=== 测试19：回溯缓冲测试 ===" << std::endl;
+
+    Log::Director d;
+    auto cap = d.AddSink<CaptureSink>();
+    // 只接收WARNING以上的落地方向不接收回溯的DEBUG日志,除非设置SetBacktraceAll
+    auto warn = d.AddSink<CaptureSink>();
+    warn->SetLevel(Log::LogLevel::WARNING);
+    auto warnall = d.AddSink<CaptureSink>();
+    warnall->SetLevel(Log::LogLevel::WARNING).SetBacktraceAll(true);
+    warnall->SetPattern("%J%n");
+    auto logger = d.LocalLogder(
+        "回溯日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::INFO,
+        "[%L]%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    logger->EnableBacktrace(5);
+    auto &lines = std::static_pointer_cast<CaptureSink>(cap)->_lines;
+
+    for (int i = 0; i < 10; ++i)
+        logger->Debug(__LINE__, __FILE__, "调试{}", i, Log::kv("step", i));
+    logger->Info(__LINE__, __FILE__, "普通日志");
+    assert(lines.size() == 1 && "被过滤的日志不应写入落地方向");
+
+    logger->Errno(__LINE__, __FILE__, "出错了");
+    assert(lines.size() == 7 && "出错前应输出最近5条被过滤的日志");
+    assert(lines[1] == "[DEBUG]调试5 step=5\n" && lines[5] == "[DEBUG]调试9 step=9\n");
+    assert(lines[6] == "[ERRNO]出错了\n" && "回溯日志应先于触发日志输出");
+    auto &warnlines = std::static_pointer_cast<CaptureSink>(warn)->_lines;
+    auto &jsonlines = std::static_pointer_cast<CaptureSink>(warnall)->_lines;
+    assert(warnlines.size() == 1 && warnlines[0] == "[ERRNO]出错了\n" && "回溯输出应遵守落地方向的等级");
+    assert(jsonlines.size() == 6 && "SetBacktraceAll的落地方向接收全部回溯日志");
+    // 回溯的kv字段与实时输出一样是JSON字段
+    assert(jsonlines[0].find("\"msg\":\"调试5\"") != std::string::npos);
+    assert(jsonlines[0].find("\"step\":5") != std::string::npos);
+
+    // 输出后缓冲清空,也可以手动输出
+    logger->Errno(__LINE__, __FILE__, "再次出错");
+    assert(lines.size() == 8);
+    logger->Debug(__LINE__, __FILE__, "手动输出");
+    logger->DumpBacktrace();
+    assert(lines.size() == 9 && lines[8] == "[DEBUG]手动输出\n");
+
+    logger->DisableBacktrace();
+    logger->Debug(__LINE__, __FILE__, "关闭后不再保留");
+    logger->DumpBacktrace();
+    assert(lines.size() == 9);
+}
+
+// 测试20：限流与采样宏
+void test_rate_limited() {
+    std::cout << "\n=== 测试20：限流与采样宏测试 ===" << std::endl;
+
+    Log::Director d;
+    auto cap = d.AddSink<CaptureSink>();
+    auto logger = d.LocalLogder(
+        "限流日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::DEBUG,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    auto &lines = std::static_pointer_cast<CaptureSink>(cap)->_lines;
+
+    for (int i = 0; i < 10; ++i)
+        logger->INFO_EVERY_N(3, "每3条 {}", i);
+    assert(lines.size() == 4 && lines[0] == "每3条 0\n" && lines[1] == "每3条 3 suppressed=2\n");
+
+    lines.clear();
+    for (int i = 0; i < 5; ++i)
+        logger->WARNING_FIRST_N(2, "前2条 {}", i);
+    assert(lines.size() == 2 && lines[1] == "前2条 1\n");
+
+    lines.clear();
+    for (int i = 0; i <= 100; ++i) {
+        if (i == 100)
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        logger->ERRNO_EVERY_MS(200, "限时 {}", i);
+    }
+    assert(lines.size() == 2 && lines[1] == "限时 100 suppressed=99\n" && "抑制条数应出现在下一条输出中");
+
+    lines.clear();
+    for (int i = 0; i < 20; ++i)
+        logger->INFO_RATE(1, 5, "令牌桶 {}", i);
+    assert(lines.size() == 5 && "令牌桶应允许连续burst条");
+
+    // 每个调用点独立计数,多线程下不丢不重
+    lines.clear();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&logger]() {
+            for (int i = 0; i < 1000; ++i)
+                logger->DEBUG_EVERY_N(10, "并发 {}", i);
+        });
+    }
+    for (auto &th : threads) th.join();
+    assert(lines.size() == 400);
+}
+
+// 测试21：调用点动态开关
+void test_dynamic_sites() {
+    std::cout << "\n=== 测试21：调用点动态开关测试 ===" << std::endl;
+
+    Log::Director d;
+    auto cap = d.AddSink<CaptureSink>();
+    auto logger = d.LocalLogder(
+        "动态调试日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::WARNING,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    auto &lines = std::static_pointer_cast<CaptureSink>(cap)->_lines;
+    int debugline = 0, warnline = 0;
+    auto run = [&]() {
+        debugline = __LINE__ + 1;
+        logger->DEBUG("调试信息");
+        warnline = __LINE__ + 1;
+        logger->WARNING("警告信息");
+    };
+
+    run();
+    assert(lines.size() == 1 && lines[0] == "警告信息\n");
+
+    // 只打开一行,日志器等级不变;通配符取本文件所在目录,与__FILE__的写法无关
+    std::string self = __FILE__;
+    size_t slash = self.find_last_of('/');
+    std::string glob = (slash == std::string::npos ? std::string() : self.substr(0, slash + 1)) + "*.cpp";
+    lines.clear();
+    assert(mylog::EnableSites(glob, debugline, debugline) == 1);
+    run();
+    assert(lines.size() == 2 && lines[0] == "调试信息\n");
+
+    // 按日志器名称关闭
+    lines.clear();
+    assert(mylog::DisableSites("", 0, INT_MAX, "动态调试日志器") == 2);
+    uint64_t filtered = logger->stats().filtered;
+    run();
+    assert(lines.empty() && "关闭的调用点不应输出");
+    assert(logger->stats().filtered == filtered + 2 && "关闭的调用点计入过滤数");
+    logger->INFO_EVERY_N(1, "限流调用点");
+    assert(logger->stats().filtered == filtered + 3);
+
+    mylog::ResetSites();
+    lines.clear();
+    run();
+    assert(lines.size() == 1 && lines[0] == "警告信息\n");
+
+    bool found = false;
+    for (auto &site : Log::CallSites::getInstance().list())
+        if (site.line == warnline && site.logger == "动态调试日志器" && site.level == Log::LogLevel::WARNING)
+            found = true;
+    assert(found && "调用点应登记文件、行号、等级和日志器");
+
+    // 规则对之后才执行的调用点同样生效
+    mylog::EnableSites("*testlog.cpp", 0, INT_MAX, "动态调试日志器");
+    lines.clear();
+    logger->DEBUG("新的调用点");
+    assert(lines.size() == 1);
+    mylog::ResetSites();
+
+    // 同一个宏调用点经过两个日志器,按日志器名称的开关互不影响
+    auto other = d.LocalLogder(
+        "动态调试日志器2",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::WARNING,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    int sharedline = 0;
+    auto both = [&](Log::LogGer::Logger::ptr &lg) {
+        sharedline = __LINE__ + 1;
+        lg->WARNING("共用调用点");
+    };
+    lines.clear();
+    both(logger);
+    both(other);
+    assert(lines.size() == 2);
+    assert(mylog::DisableSites("", 0, INT_MAX, "动态调试日志器2") == 1);
+    lines.clear();
+    both(logger);
+    both(other);
+    assert(lines.size() == 1 && "只关闭第二个日志器的调用点");
+    size_t entries = 0;
+    for (auto &site : Log::CallSites::getInstance().list())
+        if (site.line == sharedline)
+            ++entries;
+    assert(entries == 2 && "每个日志器分别登记");
+    mylog::ResetSites();
+    lines.clear();
+    both(other);
+    assert(lines.size() == 1);
+}
+
+// 测试22：按模块设置等级
+void test_vmodule() {
+    std::cout << "\n=== 测试22：按模块设置等级测试 ===" << std::endl;
+
+    Log::Director d;
+    auto cap = d.AddSink<CaptureSink>();
+    auto logger = d.LocalLogder(
+        "模块等级日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::WARNING,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    auto &lines = std::static_pointer_cast<CaptureSink>(cap)->_lines;
+    auto run = [&]() {
+        lines.clear();
+        logger->DEBUG("调试");
+        logger->WARNING("警告");
+    };
+
+    run();
+    assert(lines.size() == 1);
+
+    // 规则由__FILE__得到,与编译时的路径写法无关
+    std::string self = __FILE__;
+    size_t slash = self.find_last_of('/');
+    std::string dir = slash == std::string::npos ? std::string() : self.substr(0, slash + 1);
+    std::string name = self.substr(dir.size());
+
+    // 本文件降到DEBUG,其他规则不匹配
+    assert(mylog::SetVModule("net/*=ERRNO, " + name + "=DEBUG"));
+    run();
+    assert(lines.size() == 2 && lines[0] == "调试\n");
+
+    // 第一条匹配的规则生效,修改后调用点重新匹配
+    assert(mylog::SetVModule(dir + "*=ERRNO,*.cpp=DEBUG"));
+    uint64_t filtered = logger->stats().filtered;
+    run();
+    assert(lines.empty() && "模块等级高于日志器等级时同样生效");
+    assert(logger->stats().filtered == filtered + 2 && "按模块等级过滤的日志计入过滤数");
+    logger->WARNING_EVERY_N(1, "限流");
+    assert(lines.empty() && logger->stats().filtered == filtered + 3);
+
+    assert(!mylog::SetVModule("tests/*=NOPE,*testlog.cpp=INFO") && "无效条目应报告");
+    assert(Log::VModule::getInstance().spec() == "tests/*=NOPE,*testlog.cpp=INFO");
+    run();
+    assert(lines.size() == 1 && lines[0] == "警告\n");
+
+    mylog::SetVModule("");
+    run();
+    assert(lines.size() == 1);
+}
+
+// 测试23：线程诊断上下文
+void test_mdc() {
+    std::cout << "\n=== 测试23：线程诊断上下文测试 ===" << std::endl;
+
+    Log::Director d;
+    auto text = d.AddSink<CaptureSink>();
+    text->SetPattern("[%X{req}]%c|%X%n");
+    auto json = d.AddSink<CaptureSink>();
+    json->SetPattern(Log::Data::JSONLINES);
+    auto logger = d.LocalLogder(
+        "上下文日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::INFO,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    auto &t = std::static_pointer_cast<CaptureSink>(text)->_lines;
+    auto &j = std::static_pointer_cast<CaptureSink>(json)->_lines;
+
+    logger->INFO("没有上下文");
+    {
+        Log::MDC::Scope req("req", 1001);
+        logger->INFO("外层");
+        {
+            Log::MDC::Scope user("user", "alice");
+            Log::MDC::Scope inner("req", "1001-a");
+            logger->INFO("内层");
+        }
+        logger->INFO("回到外层");
+    }
+    logger->INFO("离开作用域");
+    assert(t.size() == 5);
+    assert(t[0] == "[]没有上下文|\n");
+    assert(t[1] == "[1001]外层|req=1001\n");
+    assert(t[2] == "[1001-a]内层|req=1001 user=alice req=1001-a\n" && "同名时内层优先");
+    assert(t[3] == "[1001]回到外层|req=1001\n");
+    assert(t[4] == "[]离开作用域|\n");
+    assert(j[2].find("\"msg\":\"内层\",\"req\":\"1001\",\"user\":\"alice\",\"req\":\"1001-a\"}") != std::string::npos);
+
+    // 上下文属于各自的线程
+    t.clear();
+    std::thread other([&logger]() {
+        Log::MDC::Scope req("req", "other");
+        logger->INFO("其他线程");
+    });
+    Log::MDC::Scope req("req", "main");
+    other.join();
+    logger->INFO("主线程");
+    assert(t.size() == 2 && t[0] == "[other]其他线程|req=other\n" && t[1] == "[main]主线程|req=main\n");
+
+    // 回溯缓冲保存记录时的上下文
+    t.clear();
+    logger->EnableBacktrace(4);
+    {
+        Log::MDC::Scope step("step", 7);
+        logger->DEBUG("被过滤");
+    }
+    logger->DumpBacktrace();
+    assert(t.size() == 1 && t[0] == "[main]被过滤|req=main step=7\n");
+}
+
+// 测试24：日志记录池
+struct NestedValue {
+    Log::LogGer::Logger::ptr logger;
+};
+std::ostream &operator<<(std::ostream &out, const NestedValue &v) {
+    // 格式化参数时再次记录日志,使用池中的另一条记录
+    v.logger->INFO("内层{}", 2);
+    return out << "值";
+}
+
+void test_record_pool() {
+    std::cout << "\n=== 测试24：日志记录池测试 ===" << std::endl;
+
+    Log::Director d;
+    auto sink = d.AddSink<CaptureSink>();
+    auto logger = d.LocalLogder(
+        "记录池日志器",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::INFO,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    auto &lines = std::static_pointer_cast<CaptureSink>(sink)->_lines;
+
+    logger->INFO("外层{} {}", 1, NestedValue{logger});
+    assert(lines.size() == 2);
+    assert(lines[0] == "内层2\n" && lines[1] == "外层1 值\n");
+
+    // 多个线程同时使用,线程退出后缓存的记录归还到全局
+    lines.clear();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&logger, t]() {
+            for (int i = 0; i < 200; ++i)
+                logger->INFO("线程{} 第{}条", t, i);
+        });
+    }
+    for (auto &th : threads)
+        th.join();
+    assert(lines.size() == 800);
+
+    // 回溯缓冲输出整批使用池中的记录
+    lines.clear();
+    logger->EnableBacktrace(8);
+    for (int i = 0; i < 8; ++i)
+        logger->DEBUG("回溯{}", i);
+    logger->DumpBacktrace();
+    assert(lines.size() == 8 && lines[7] == "回溯7\n");
+
+    // 池用完后临时从堆上分配,总数不超过上限
+    Log::RecordPool &pool = Log::RecordPool::getInstance();
+    Log::PoolStats before = logger->getPoolStats();
+    std::vector<Log::PooledRecord *> recs;
+    for (size_t i = 0; i < before.limit + 4; ++i)
+        recs.push_back(pool.acquire());
+    Log::PoolStats full = pool.stats();
+    assert(full.capacity == full.limit);
+    assert(full.overflow >= before.overflow + 4);
+    size_t pooled = std::count_if(recs.begin(), recs.end(), [](Log::PooledRecord *r) { return r->pooled; });
+    pool.release(recs.data(), recs.size());
+    Log::PoolStats after = pool.stats();
+    assert(after.free == full.free + pooled);
+    std::cout << "记录池: 上限" << after.limit << " 已分配" << after.capacity
+              << " 空闲" << after.free << " 堆分配" << after.overflow << std::endl;
+}
+
+// 测试25：定长缓冲区
+void test_fixed_buffer() {
+    std::cout << "\n=== 测试25：定长缓冲区测试 ===" << std::endl;
+
+    Log::Buffer a(16, Log::Data::NORMALPAGE, false), b(16, Log::Data::NORMALPAGE, false);
+    assert(a.empty() && a.capacity() == 16 && a.WriteBSize() == 16);
+    a.push(std::string("hello "));
+    a.push("world", 5);
+    assert(a.size() == 11 && a.WriteBSize() == 5);
+    assert(std::string(a.data(), a.size()) == "hello world");
+
+    // 交换只交换内存区域
+    const char *region = a.data();
+    a.swap(b);
+    assert(a.empty() && b.size() == 11 && b.data() == region);
+    b.clear();
+    assert(b.empty() && b.data() == region);
+
+    // 超出容量的部分被丢弃,不会越界
+    a.push(std::string(20, 'x'));
+    assert(a.size() == 16 && a.WriteBSize() == 0);
+
+    // 大页和锁定都是尽力而为,失败时仍是可用的缓冲区
+    Log::Buffer huge(1000, Log::Data::HUGETLB, true);
+    huge.push(std::string(1000, 'y'));
+    assert(huge.size() == 1000 && huge.data()[999] == 'y');
+    Log::Buffer thp(1000, Log::Data::THP, false);
+    thp.push("z", 1);
+    assert(thp.size() == 1);
+    std::cout << "大页缓冲区锁定: " << (huge.locked() ? "成功" : "失败(超出RLIMIT_MEMLOCK)") << std::endl;
+}
+
+// 测试26：全局缓冲区预算
+void test_buffer_budget() {
+    std::cout << "\n=== 测试26：全局缓冲区预算测试 ===" << std::endl;
+
+    const size_t chunk = 64 * 1024;
+    Log::BufferBudget &budget = Log::BufferBudget::getInstance();
+    size_t base = budget.used();
+
+    // 第一块在构造时借用,并计入所属的统计
+    std::atomic<size_t> account(0);
+    {
+        Log::Buffer buf(1024 * 1024, Log::Data::NORMALPAGE, false, &account);
+        assert(buf.capacity() == chunk && account == chunk && budget.used() == base + chunk);
+
+        // 预算只够再借一块
+        budget.setLimit(base + 2 * chunk);
+        assert(buf.fits(100 * 1024) && buf.capacity() == 2 * chunk);
+        assert(!buf.fits(200 * 1024) && "预算用完");
+        buf.push(std::string(100 * 1024, 'a'));
+        assert(!buf.fits(chunk) && buf.fits(chunk - 100 * 1024 + chunk - 1024));
+
+        // 清空时保留上一轮用到的块,再清空一次才归还
+        buf.clear();
+        assert(buf.capacity() == 2 * chunk && account == 2 * chunk);
+        buf.clear();
+        assert(buf.capacity() == chunk && account == chunk && budget.used() == base + chunk);
+        budget.setLimit(0);
+        assert(buf.fits(1000 * 1024) && buf.capacity() == 1024 * 1024);
+
+        // 预算不紧张时清空不归还,下一轮写入不再借用和触碰内存页
+        buf.clear();
+        buf.clear();
+        assert(buf.capacity() == 1024 * 1024 && account == 1024 * 1024);
+        budget.setLimit(budget.used());
+        buf.clear();
+        assert(buf.capacity() == chunk && account == chunk && "预算紧张时归还");
+        budget.setLimit(0);
+    }
+    assert(account == 0 && budget.used() == base && "析构时全部归还");
+
+    // 异步日志器的用量按落地方向统计
+    Log::Director d;
+    d.AddSink<CaptureSink>();
+    d.AddSink<CaptureSink>();
+    auto logger = d.LocalLogder(
+        "预算日志器",
+        Log::Data::LogGerType::ASYNLOGGER,
+        Log::LogLevel::DEBUG,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    size_t per = 2 * std::min(chunk, Log::Data::max_buffer_size());
+    assert(logger->getBufferBytes() == 2 * per);
+    for (auto &st : logger->getSinkStats())
+        assert(st.buffered == per);
+    std::cout << "预算已用" << budget.used() << "字节, 日志器" << logger->getBufferBytes() << "字节" << std::endl;
+
+    // 线程池控制器在预算用完时同样交给线程池写出,之后的日志可以继续写入
+    Log::Director td;
+    td.AddSink<CaptureSink>();
+    auto thpool = td.LocalLogder(
+        "预算线程池日志器",
+        Log::Data::LogGerType::ASYNLOGGER,
+        Log::LogLevel::DEBUG,
+        "%c%n",
+        Log::Data::AnsyCtrlType::THPOOL
+    );
+    budget.setLimit(budget.used());
+    std::string line(100, 'p');
+    for (int i = 0; i < 2000; ++i)
+    {
+        thpool->INFO(line);
+        if (i % 100 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    for (int i = 0; i < 200 && thpool->getSinkStats()[0].lag; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    Log::ChannelStats ts = thpool->getSinkStats()[0];
+    budget.setLimit(0);
+    assert(ts.written > chunk && "超过一块的内容已经写出");
+    assert(ts.dropped < 2000 - chunk / 101);
+    std::cout << "线程池控制器写出" << ts.written << "字节, 丢弃" << ts.dropped << "条" << std::endl;
+}
+
+// 测试27：运行统计与Prometheus导出测试
+void test_metrics() {
+    std::cout << "\n=== 测试27：运行统计与导出测试 ===" << std::endl;
+
+    system("rm -rf ./test_logs/metrics && mkdir -p ./test_logs/metrics");
+    Log::Director d;
+    d.AddSink<CaptureSink>();
+    auto roll = d.AddSink<Log::SinkWay::RollFileSink>(1000, "./test_logs/metrics/metrics_log",
+                                                      Log::Data::NONE, Log::RetainPolicy());
+    auto logger = d.LocalLogder(
+        "统计\"日志器\"",
+        Log::Data::LogGerType::SYNCLOGGER,
+        Log::LogLevel::INFO,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    for (int i = 0; i < 100; ++i)
+        logger->INFO("统计第{}条日志", i);
+    for (int i = 0; i < 10; ++i)
+        logger->DEBUG("被过滤{}", i);
+
+    Log::LoggerStats st = logger->stats();
+    assert(st.accepted == 100 && st.filtered == 10 && st.dropped == 0);
+    assert(st.formatted_bytes > 0 && st.sinks.size() == 2);
+    assert(st.sinks[0].written == st.formatted_bytes);
+    assert(st.sinks[1].rotations > 0 && roll->GetRotations() == st.sinks[1].rotations);
+    std::cout << "接收" << st.accepted << "条, 过滤" << st.filtered << "条, 滚动" << st.sinks[1].rotations << "次" << std::endl;
+
+    std::string text = Log::Metrics::Render({st});
+    assert(text.find("# TYPE log_messages_accepted_total counter") != std::string::npos);
+    assert(text.find("log_messages_accepted_total{logger=\"统计\\\"日志器\\\"\"} 100\n") != std::string::npos);
+    assert(text.find("log_rotations_total{logger=\"统计\\\"日志器\\\"\",sink=\"1\"} ") != std::string::npos);
+    assert(text.find("# TYPE log_sink_lag_bytes gauge") != std::string::npos);
+
+    // 异步日志器统计缓冲区交换次数
+    Log::Director ad;
+    ad.AddSink<CaptureSink>();
+    auto async = ad.LocalLogder(
+        "统计异步日志器",
+        Log::Data::LogGerType::ASYNLOGGER,
+        Log::LogLevel::DEBUG,
+        "%c%n",
+        Log::Data::AnsyCtrlType::COMMON
+    );
+    for (int i = 0; i < 100; ++i)
+        async->INFO("异步{}", i);
+    for (int i = 0; i < 200 && async->getSinkStats()[0].lag; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    assert(async->stats().sinks[0].swaps > 0);
+
+    // 导出到文件
+    {
+        Log::MetricsExporter exporter("./test_logs/metrics/log.prom", 3600);
+        exporter.add(logger);
+        exporter.add(async);
+        assert(exporter.exportNow());
+    }
+    std::ifstream prom("./test_logs/metrics/log.prom");
+    std::string content((std::istreambuf_iterator<char>(prom)), std::istreambuf_iterator<char>());
+    assert(content.find("logger=\"统计异步日志器\"") != std::string::npos);
+    assert(content.find("log_buffer_swaps_total") != std::string::npos);
+
+    // 导出到unix套接字
+    std::string path = "./test_logs/metrics/log.sock";
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    assert(fd >= 0 && bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0 && listen(fd, 1) == 0);
+    std::string received;
+    std::thread server([&]() {
+        int c = accept(fd, nullptr, nullptr);
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(c, buf, sizeof(buf))) > 0)
+            received.append(buf, n);
+        close(c);
+    });
+    Log::MetricsExporter sock("unix:" + path, 3600);
+    sock.add(logger);
+    assert(sock.exportNow());
+    server.join();
+    close(fd);
+    assert(received == sock.render());
+    std::cout << "导出" << content.size() << "字节到文件, " << received.size() << "字节到套接字" << std::endl;
+}
+
+// 测试28：延迟直方图测试
+void test_latency_histogram() {
+    std::cout << "\n=== 测试28：延迟直方图测试 ===" << std::endl;
+
+    // 分桶的相对误差不超过1/16
+    Log::Histogram h;
+    assert(h.percentile(0.5) == 0 && h.stats().count == 0);
+    for (uint64_t v = 1; v <= 10000; ++v)
+        h.record(v * 1000);
+    Log::LatencyStats st = h.stats();
+    assert(st.count == 10000 && st.max_ns == 10000000);
+    assert(st.p50_ns >= 5000000 && st.p50_ns <= 5000000 + 5000000 / 16);
+    assert(st.p99_ns >= 9900000 && st.p99_ns <= 9900000 + 9900000 / 16);
+    assert(st.p999_ns <= st.max_ns && st.p90_ns <= st.p99_ns);
+    for (uint64_t v = 1; v < (uint64_t(1) << 41); v = v * 3 + 1)
+        assert(Log::Histogram::Upper(Log::Histogram::Index(v)) >= v || v >= (uint64_t(1) << 40));
+    std::cout << "p50=" << st.p50_ns << "ns p99=" << st.p99_ns << "ns" << std::endl;
+
+    // 同步日志器每10条采样一条
+    Log::Director d;
+    d.AddSink<CaptureSink>();
+    auto sync = d.LocalLogder("延迟同步日志器", Log::Data::LogGerType::SYNCLOGGER, Log::LogLevel::DEBUG,
+                              "%c%n", Log::Data::AnsyCtrlType::COMMON);
+    assert(sync->GetLatencySample() == Log::Data::latencySample());
+    sync->SetLatencySample(10);
+    for (int i = 0; i < 1000; ++i)
+        sync->INFO("同步{}", i);
+    assert(sync->getCallLatency().count == 100);
+    assert(sync->getSinkStats()[0].latency.count == 100);
+    assert(sync->getCallLatency().p50_ns > 0);
+
+    // 同一线程交替使用两个日志器,采样计数按日志器分开
+    auto other = d.LocalLogder("延迟同步日志器2", Log::Data::LogGerType::SYNCLOGGER, Log::LogLevel::DEBUG,
+                               "%c%n", Log::Data::AnsyCtrlType::COMMON);
+    other->SetLatencySample(10);
+    for (int i = 0; i < 1000; ++i)
+    {
+        sync->INFO("交替{}", i);
+        other->INFO("交替{}", i);
+    }
+    assert(sync->getCallLatency().count == 200 && other->getCallLatency().count == 100);
+
+    // 异步日志器的端到端延迟在写入落地方向后记录
+    Log::Director ad;
+    ad.AddSink<CaptureSink>();
+    auto async = ad.LocalLogder("延迟异步日志器", Log::Data::LogGerType::ASYNLOGGER, Log::LogLevel::DEBUG,
+                                "%c%n", Log::Data::AnsyCtrlType::COMMON);
+    async->SetLatencySample(1);
+    for (int i = 0; i < 200; ++i)
+    {
+        async->INFO("异步{}", i);
+        if (i % 20 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int i = 0; i < 200 && async->getSinkStats()[0].lag; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Log::LoggerStats ls = async->stats();
+    assert(ls.call.count == 200);
+    assert(ls.sinks[0].latency.count > 0 && ls.sinks[0].latency.count <= 200);
+    std::cout << "异步调用p99=" << ls.call.p99_ns << "ns, 端到端p50=" << ls.sinks[0].latency.p50_ns
+              << "ns p99=" << ls.sinks[0].latency.p99_ns << "ns" << std::endl;
+
+    std::string text = Log::Metrics::Render({ls, sync->stats()});
+    assert(text.find("# TYPE log_e2e_latency_seconds summary") != std::string::npos);
+    assert(text.find("log_e2e_latency_seconds{logger=\"延迟异步日志器\",sink=\"0\",quantile=\"0.99\"} ") != std::string::npos);
+    assert(text.find("log_call_latency_seconds_count{logger=\"延迟同步日志器\"} 200\n") != std::string::npos);
+}
+
+// 测试29：分阶段性能剖析测试(定义LOG_PROFILE编译时检查日志器的统计)
+void test_profile() {
+    std::cout << "\n=== 测试29：分阶段性能剖析测试 ===" << std::endl;
+
+    system("rm -rf ./test_logs/profile && mkdir -p ./test_logs/profile");
+    Log::TraceRecorder &tr = Log::TraceRecorder::getInstance();
+    tr.start("./test_logs/profile/trace.json", 1000);
+
+    // 手动计时的阶段同样进入统计表和trace
+    Log::Profiler prof("剖析\"测试\"");
+    for (int i = 0; i < 10; ++i)
+    {
+        Log::ProfileScope call(&prof, Log::Profile::CALL);
+        Log::ProfileScope parse(&prof, Log::Profile::PARSE);
+    }
+    assert(prof.stats(Log::Profile::CALL).count == 10 && prof.stats(Log::Profile::WRITE).count == 0);
+    std::string table = prof.table();
+    assert(table.find("PARSE") != std::string::npos && table.find("WRITE") != std::string::npos);
+
+    // 多个线程同时记录,各自写入自己的缓冲区,停止时合并
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t)
+        workers.emplace_back([&prof]() {
+            for (int i = 0; i < 25; ++i)
+                Log::ProfileScope write(&prof, Log::Profile::WRITE);
+        });
+    for (auto &w : workers)
+        w.join();
+    assert(prof.stats(Log::Profile::WRITE).count == 100);
+
+    Log::Director d;
+    d.AddSink<CaptureSink>();
+    auto logger = d.LocalLogder("剖析日志器", Log::Data::LogGerType::SYNCLOGGER, Log::LogLevel::INFO,
+                                "[%L] %c%n", Log::Data::AnsyCtrlType::COMMON);
+    for (int i = 0; i < 100; ++i)
+        logger->INFO("剖析{}", i);
+    logger->DEBUG("被过滤");
+#ifdef LOG_PROFILE
+    const Log::Profiler::ptr &p = logger->getProfiler();
+    assert(p && p->name() == "剖析日志器");
+    for (int s = 0; s < Log::Profile::STAGES; ++s)
+        assert(p->stats(static_cast<Log::Profile::Stage>(s)).count == 100);
+    std::cout << p->table();
+#else
+    assert(!logger->getProfiler());
+#endif
+    std::cout << prof.table();
+
+    size_t events = tr.size();
+    assert(events > 0 && tr.stop() && !tr.stop());
+    std::ifstream in("./test_logs/profile/trace.json");
+    std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t written = 0, writes = 0;
+    for (size_t pos = trace.find("\"ph\":\"X\""); pos != std::string::npos; pos = trace.find("\"ph\":\"X\"", pos + 1))
+        ++written;
+    for (size_t pos = trace.find("\"name\":\"WRITE\",\"cat\":\"剖析"); pos != std::string::npos;
+         pos = trace.find("\"name\":\"WRITE\",\"cat\":\"剖析", pos + 1))
+        ++writes;
+    assert(written == events && writes >= 100 && "各线程的事件都被合并写出");
+    assert(trace.find("{\"traceEvents\":[") == 0);
+    assert(trace.find("\"name\":\"PARSE\",\"cat\":\"剖析\\\"测试\\\"\",\"ph\":\"X\"") != std::string::npos);
+    std::cout << "trace事件写入" << trace.size() << "字节" << std::endl;
+}
+
+// 测试30：配置文件热加载
+void test_config_reload() {
+    std::cout << "\n=== 测试30：配置文件热加载测试 ===" << std::endl;
+
+    Log::ConfigManager &cm = Log::ConfigManager::getInstance();
+    const std::string path = cm.filename();
+    std::string original;
+    {
+        std::ifstream in(path);
+        original.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+    auto write_config = [&](const std::string &extra) {
+        std::ofstream out(path, std::ios::trunc);
+        out << original << "\n" << extra;
+    };
+
+    system("rm -rf ./test_logs/reload && mkdir -p ./test_logs/reload");
+    // 使用配置中的等级和格式,跟随配置变化
+    Log::Director d;
+    auto follow_sink = d.AddSink<CaptureSink>();
+    auto &lines = std::static_pointer_cast<CaptureSink>(follow_sink)->_lines;
+    Log::Sink::ptr roll = d.AddSink<Log::SinkWay::RollFileSink>(Log::Data::max_logfile_size(), "./test_logs/reload/roll");
+    auto logger = d.LocalLogder("热加载日志器", Log::Data::LogGerType::SYNCLOGGER);
+    // 在代码中单独设置了等级和格式,不受配置影响
+    Log::Director d2;
+    auto &fixed = std::static_pointer_cast<CaptureSink>(d2.AddSink<CaptureSink>())->_lines;
+    auto fixed_logger = d2.LocalLogder("固定配置日志器", Log::Data::LogGerType::SYNCLOGGER,
+                                       Log::LogLevel::ERRNO, "固定 %c%n");
+    // 两个异步日志器共用一个落地方向,各自的通道都跟随配置
+    Log::Director ad;
+    ad.AddSink<CaptureSink>();
+    auto async1 = ad.LocalLogder("热加载异步日志器1", Log::Data::LogGerType::ASYNLOGGER, Log::LogLevel::ERRNO,
+                                 "%c%n", Log::Data::AnsyCtrlType::COMMON);
+    auto async2 = ad.LocalLogder("热加载异步日志器2", Log::Data::LogGerType::ASYNLOGGER, Log::LogLevel::ERRNO,
+                                 "%c%n", Log::Data::AnsyCtrlType::COMMON);
+    assert(async2->getSinkStats()[0].overflow == Log::Data::overflowPolicy());
+
+    const char *old_format = Log::Data::defaultformat();
+    size_t version = cm.version();
+    write_config("log.DLevel=WARNING\nlog.format=热加载 %c%n\nlog.max_logfile_size=4096\nlog.overflow_policy=DROP\n");
+    assert(cm.reload() && cm.version() == version + 1);
+    // 内容没有变化时不发布新版本
+    assert(cm.reload() && cm.version() == version + 1);
+    assert(std::string(Log::Data::defaultformat()) == "热加载 %c%n");
+    assert(Log::Data::DLevel() == Log::LogLevel::WARNING);
+    // 旧快照仍然有效
+    assert(std::string(old_format) != Log::Data::defaultformat() && strlen(old_format) > 0);
+
+    logger->INFO("被新等级过滤");
+    logger->WARNING("新格式{}", 1);
+    fixed_logger->ERRNO("不变");
+    assert(lines.size() == 1 && lines[0] == "热加载 新格式1\n");
+    assert(fixed.size() == 1 && fixed[0] == "固定 不变\n");
+    assert(std::static_pointer_cast<Log::SinkWay::RollFileSink>(roll)->GetMaxSize() == 4096);
+    assert(roll->GetOverflow() == Log::Data::DROP && follow_sink->GetOverflow() == Log::Data::DROP);
+    for (int i = 0; i < 100; ++i)
+        logger->WARNING("滚动{}", std::string(100, 'x'));
+    assert(roll->GetRotations() >= 2);
+    async1->ERRNO("异步1");
+    async2->ERRNO("异步2");
+    assert(async1->getSinkStats()[0].overflow == Log::Data::DROP);
+    assert(async2->getSinkStats()[0].overflow == Log::Data::DROP && "先应用的日志器不影响后应用的");
+
+    // 多次发布后之前取得的快照和字符串仍然有效,长时间未记录日志的日志器也能正确应用
+    const Log::ConfigManager::Snapshot &held = cm.snapshot();
+    size_t heldversion = held.version;
+    const char *heldformat = Log::Data::defaultformat();
+    for (int i = 0; i < 20; ++i)
+    {
+        write_config("log.DLevel=WARNING\nlog.format=热加载 %c%n\nlog.max_logfile_size=4096\n"
+                     "log.overflow_policy=DROP\ntest.reload_cycle=" + std::to_string(i) + "\n");
+        assert(cm.reload());
+    }
+    assert(cm.version() == heldversion + 20);
+    assert(held.version == heldversion && held.FORMAT == "热加载 %c%n");
+    assert(std::string(heldformat) == "热加载 %c%n");
+    fixed_logger->ERRNO("多次发布后");
+    assert(fixed.size() == 2 && fixed[1] == "固定 多次发布后\n");
+    async2->ERRNO("多次发布后");
+    assert(async2->getSinkStats()[0].overflow == Log::Data::DROP);
+
+    // 后台线程发现文件变化后自动加载
+    Log::ConfigWatcher &watcher = Log::ConfigWatcher::getInstance();
+    watcher.start(1);
+    version = cm.version();
+    write_config("log.DLevel=INFO\n");
+    for (int i = 0; i < 50 && cm.version() == version; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    assert(cm.version() > version && watcher.reloads() > 0);
+    logger->INFO("自动加载");
+    assert(lines.size() == 102 && lines.back().find("自动加载") != std::string::npos);
+    assert(std::string(Log::Data::defaultformat()) == old_format);
+    assert(lines.back() != "热加载 自动加载\n");
+    std::cout << "当前配置版本" << cm.version() << ",后台加载" << watcher.reloads() << "次" << std::endl;
+    watcher.stop();
+
+    // 恢复原来的配置
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << original;
+    }
+    assert(cm.reload());
+}
+
+// 测试31：类型化配置快照与校验
+void test_config_snapshot() {
+    std::cout << "\n=== 测试31：类型化配置快照与校验测试 ===" << std::endl;
+
+    // 校验器
+    assert(Log::ConfigCheck::Range(1)("4096") && !Log::ConfigCheck::Range(1)("0"));
+    assert(!Log::ConfigCheck::Range(0)("12a") && !Log::ConfigCheck::Range(0)("-1"));
+    assert(!Log::ConfigCheck::Range(0)("99999999999999999999999"));
+    assert(Log::ConfigCheck::Range(0, 19)("19") && !Log::ConfigCheck::Range(0, 19)("20"));
+    assert(Log::ConfigCheck::OneOf("BLOCK|DROP")("DROP") && !Log::ConfigCheck::OneOf("BLOCK|DROP")("BLOCK|DROP"));
+    assert(!Log::ConfigCheck::OneOf("BLOCK|DROP")("drop") && !Log::ConfigCheck::OneOf("BLOCK|DROP")(""));
+    assert(Log::ConfigCheck::Level()("OFF") && !Log::ConfigCheck::Level()("LOUD"));
+    assert(Log::ConfigCheck::VModule()("net/*=DEBUG, db/pool.cpp = WARNING,"));
+    assert(!Log::ConfigCheck::VModule()("net/*") && !Log::ConfigCheck::VModule()("=DEBUG"));
+    assert(Log::ConfigCheck::Symbol()("-") && !Log::ConfigCheck::Symbol()("/") && !Log::ConfigCheck::Symbol()("__"));
+
+    // 读取直接返回快照中的字段
+    Log::ConfigManager &cm = Log::ConfigManager::getInstance();
+    const Log::ConfigManager::Snapshot &snap = Log::Data::config();
+    assert(&snap == Log::ConfigManager::current() && &snap == &cm.snapshot());
+    assert(snap.MAX_BUFFER_SIZE == Log::Data::max_buffer_size() && snap.BOUND_SYMBOL == Log::Data::BoundSymbol());
+    assert(Log::Data::defaultformat() == snap.FORMAT.c_str());
+    assert(cm.getMAX_LOGFILE_SIZE() == snap.MAX_LOGFILE_SIZE);
+    // 枚举值的配置项在加载时转换,读取时不再解析字符串
+    assert(snap.OVERFLOW_POLICY == Log::Data::overflowPolicy() && cm.getOVERFLOW_POLICY() == snap.OVERFLOW_POLICY);
+    assert(snap.DLEVEL == Log::Data::DLevel() && snap.DLEVEL != Log::LogLevel::UNKNOW);
+    assert(snap.BUFFER_PAGES == Log::Data::bufferPages() && snap.ROLL_INTERVAL == Log::Data::rollInterval());
+    size_t threads = snap.THREAD_COUNT;
+
+    // 无效的配置项使用默认值,有效的正常生效
+    const std::string path = cm.filename();
+    std::string original;
+    {
+        std::ifstream in(path);
+        original.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream out(path, std::ios::trunc);
+        out << original << "\nlog.max_buffer_size=abc\nlog.DLevel=LOUD\nlog.threadCount=4\n";
+    }
+    assert(cm.reload());
+    const Log::ConfigManager::Snapshot &bad = cm.snapshot();
+    assert(bad.version == snap.version + 1 && bad.invalid.size() == 2);
+    assert(bad.MAX_BUFFER_SIZE == 1048567 && bad.DLEVEL == Log::LogLevel::DEBUG && bad.THREAD_COUNT == 4);
+    assert(cm.getString("log.max_buffer_size", "无") == "无");
+    // 内容不变时重新加载不产生新版本
+    assert(cm.reload() && cm.version() == bad.version);
+    // 旧快照仍然可以读取
+    assert(snap.THREAD_COUNT == threads);
+
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << original;
+    }
+    assert(cm.reload() && cm.snapshot().invalid.empty());
+    std::cout << "配置版本" << cm.version() << std::endl;
+}
+
+void test_logger_topology() {
+    std::cout << "\n=== 测试32：配置文件声明日志器测试 ===" << std::endl;
+
+    // 名称列表
+    std::vector<std::string> names = Log::Topology::Split(" a, b ,,c ");
+    assert(names.size() == 3 && names[0] == "a" && names[2] == "c");
+
+    // 错误检查:未声明、重复使用、未使用、无效属性和格式错误的键
+    Log::ConfigManager::Snapshot check;
+    check.values = {
+        {"log.logger.topo_a.sinks", "out, missing"},
+        {"log.logger.topo_a.level", "LOUD"},
+        {"log.logger.topo_a.colour", "red"},
+        {"log.logger.topo_b.sinks", "out"},
+        {"log.logger.topo_b", "x"},
+        {"log.sink.out.type", "STDOUT"},
+        {"log.sink.spare.type", "STDOUT"},
+    };
+    std::vector<std::string> errors;
+    std::vector<Log::LoggerSpec> specs = Log::Topology::Parse(check, errors);
+    assert(specs.size() == 2 && errors.size() == 6);
+    assert(specs[0].name == "topo_a" && specs[0].sinks.size() == 1 && specs[0].level == Log::Data::DLevel());
+    assert(specs[1].name == "topo_b" && specs[1].sinks.empty());
+    for (auto &e : errors)
+        std::cout << "  " << e << std::endl;
+
+    system("rm -rf ./test_logs/topology && mkdir -p ./test_logs/topology");
+    Log::ConfigManager::Snapshot snap;
+    snap.values = {
+        {"log.logger.topo_sync.type", "SYNCLOGGER"},
+        {"log.logger.topo_sync.level", "INFO"},
+        {"log.logger.topo_sync.format", "[%L] %c%n"},
+        {"log.logger.topo_sync.sinks", "topo_all, topo_warn"},
+        {"log.sink.topo_all.type", "FILE"},
+        {"log.sink.topo_all.path", "./test_logs/topology/all.log"},
+        {"log.sink.topo_warn.type", "FILE"},
+        {"log.sink.topo_warn.path", "./test_logs/topology/warn.log"},
+        {"log.sink.topo_warn.level", "WARNING"},
+        {"log.sink.topo_warn.format", "W %c%n"},
+        {"log.logger.topo_async.type", "ASYNLOGGER"},
+        {"log.logger.topo_async.ansy_ctrl", "THPOOL"},
+        {"log.logger.topo_async.buffer_size", "65536"},
+        {"log.logger.topo_async.overflow", "DROP"},
+        {"log.logger.topo_async.sinks", "topo_roll"},
+        {"log.sink.topo_roll.type", "ROLL"},
+        {"log.sink.topo_roll.path", "./test_logs/topology/roll"},
+        {"log.sink.topo_roll.max_size", "4096"},
+    };
+    Log::LogGer::SingleManage &sm = Log::LogGer::SingleManage::getInstance();
+    assert(sm.LoadDeclared(snap) == 2);
+    // 已经存在的日志器不再创建
+    assert(sm.LoadDeclared(snap) == 0);
+
+    Log::LogGer::Logger::ptr sync = sm.getLoger("topo_sync");
+    assert(sync && sync->getSink().size() == 2);
+    sync->DEBUG("不输出 {}", 1);
+    sync->INFO("普通 {}", 2);
+    sync->WARNING("警告 {}", 3);
+
+    Log::LogGer::Logger::ptr async = sm.getLoger("topo_async");
+    assert(async && async->getSink().size() == 1);
+    Log::Sink::ptr roll = async->getSink()[0];
+    assert(roll->GetOverflow() == Log::Data::DROP);
+    assert(std::static_pointer_cast<Log::SinkWay::RollFileSink>(roll)->GetMaxSize() == 4096);
+
+    // 文件在日志器销毁前不一定写出,用写入统计检查各落地方向的等级和格式
+    std::vector<Log::ChannelStats> st = sync->getSinkStats();
+    assert(st.size() == 2 && st[0].writes == 2 && st[1].writes == 1);
+    assert(st[1].written == std::string("W 警告 3\n").size());
+    // DEBUG低于日志器等级INFO
+    assert(sync->stats().filtered == 1 && sync->stats().accepted == 2);
+    std::cout << "声明的日志器已创建" << std::endl;
+}
+
+// 测试33：按时间滚动
+void test_roll_interval() {
+    std::cout << "\n=== 测试33：按时间滚动测试 ===" << std::endl;
+
+    // 下一个整点和零点
+    time_t now = Log::tool::Date::GetTime();
+    struct tm t;
+    time_t hour = Log::tool::Date::NextBoundary(now, 3600);
+    localtime_r(&hour, &t);
+    assert(hour > now && hour - now <= 3600 && t.tm_min == 0 && t.tm_sec == 0);
+    time_t day = Log::tool::Date::NextBoundary(now, 86400);
+    localtime_r(&day, &t);
+    // 夏令时切换的那一天可能多一个小时
+    assert(day > now && day - now <= 90000 && t.tm_hour == 0 && t.tm_min == 0 && t.tm_sec == 0);
+    assert(Log::tool::Date::NextBoundary(now, 10) == now + 10);
+
+    system("rm -rf ./test_logs/interval");
+    Log::SinkWay::RollFileSink sink(1000000, "./test_logs/interval/hour_log", Log::Data::HOURLY, Log::RetainPolicy(2));
+    assert(sink.GetNextRoll() > now && sink.GetNextRoll() <= Log::tool::Date::GetTime() + 3600);
+    sink.WriteFile("第一个周期\n");
+    assert(sink.GetRotations() == 0);
+    for (int i = 0; i < 3; ++i) {
+        // 把滚动时间点移到过去,模拟进入下一个周期
+        sink.SetNextRoll(Log::tool::Date::GetTime() - 1);
+        sink.WriteFile("周期 " + std::to_string(i) + "\n");
+        assert(sink.GetNextRoll() > Log::tool::Date::GetTime());
+    }
+    assert(sink.GetRotations() == 3);
+
+    // 4个文件只保留最新的2个
+    Log::LogCleaner::getInstance().drain();
+    auto files = Log::tool::File::ListFiles("./test_logs/interval/hour_log[0-9]*_*.txt");
+    assert(files.size() == 2);
+    std::cout << "按时间滚动" << sink.GetRotations() << "次" << std::endl;
+}
+
 // 主测试函数
 int main() {
     std::cout << "开始日志系统测试..." << std::endl;
@@ -319,6 +1792,29 @@ int main() {
         test_thread_pool();
         test_format_strings();
         test_logger_management();
+        test_roll_retention();
+        test_roll_state();
+        test_roll_compress();
+        test_block_file();
+        test_independent_sinks();
+        test_sink_level_pattern();
+        test_structured_fields();
+        test_binary_format();
+        test_backtrace();
+        test_rate_limited();
+        test_dynamic_sites();
+        test_vmodule();
+        test_mdc();
+        test_record_pool();
+        test_fixed_buffer();
+        test_buffer_budget();
+        test_metrics();
+        test_latency_histogram();
+        test_profile();
+        test_config_reload();
+        test_config_snapshot();
+        test_logger_topology();
+        test_roll_interval();
         
         std::cout << "\n=== 所有测试完成 ===" << std::endl;
         std::cout << "请检查以下目录的日志文件：" << std::endl;
@@ -0,0 +1,318 @@
+#include "../include/log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+/*
+    异步日志器长时间压力与正确性测试
+    多个生产线程写入带线程号和序号的记录,轮流经过同步、AnsyCtrlCommon(阻塞/丢弃)、AnsyCtrlThpool,
+    每个日志器同时写滚动文件(很小的滚动阈值,频繁滚动)、普通文件和内存校验落地方向
+    每一轮结束时销毁日志器(等待后台写完),再读回所有文件检查:
+        1.每条记录完整,没有被截断或与其他记录交错
+        2.同一线程的记录按序号递增
+        3.不丢弃的策略下没有丢失;丢弃策略下丢失条数等于该落地方向统计的丢弃条数
+    运行期间按固定间隔输出吞吐量
+
+    用法: teststress [--seconds N] [--threads N] [--per N] [--report N]
+        --seconds 总运行时间,默认5秒,可设为数小时
+        --threads 生产线程数,默认8
+        --per     每一轮每个线程写入的条数,默认5000
+        --report  输出吞吐量的间隔秒数,默认1
+    发现错误时返回1
+*/
+
+namespace
+{
+    // 记录的正文: R <线程号> <序号> <长度随序号变化的填充>
+    std::string Payload(size_t tid, size_t seq)
+    {
+        size_t len = (tid * 31 + seq) % 97 + 1;
+        return std::string(len, static_cast<char>('a' + seq % 26));
+    }
+
+    // 逐字节读入日志内容并校验,可以分多次输入
+    class Checker
+    {
+    public:
+        Checker(size_t threads, bool lossless)
+            : _lossless(lossless), _last(threads, 0), _count(threads, 0), _records(0), _torn(0), _disorder(0)
+        {
+        }
+
+        void feed(const char *data, size_t len)
+        {
+            _rest.append(data, len);
+            size_t begin = 0, pos;
+            while ((pos = _rest.find('\n', begin)) != std::string::npos)
+            {
+                Line(_rest.substr(begin, pos - begin));
+                begin = pos + 1;
+            }
+            _rest.erase(0, begin);
+        }
+
+        // 结束输入,expected为每个线程写入的条数;返回丢失的条数
+        size_t finish(size_t expected)
+        {
+            if (!_rest.empty())
+            {
+                ++_torn;
+                _rest.clear();
+            }
+            size_t missing = 0;
+            for (size_t t = 0; t < _count.size(); ++t)
+                missing += expected > _count[t] ? expected - _count[t] : 0;
+            return missing;
+        }
+
+        size_t records() const { return _records; }
+        size_t torn() const { return _torn; }
+        size_t disorder() const { return _disorder; }
+
+    private:
+        void Line(const std::string &line)
+        {
+            std::istringstream in(line);
+            std::string tag, payload;
+            size_t tid = 0, seq = 0;
+            if (!(in >> tag >> tid >> seq >> payload) || tag != "R" || tid >= _last.size() ||
+                payload != Payload(tid, seq) || !in.eof())
+            {
+                if (_torn++ < 5)
+                    std::cerr << "  不完整的记录: " << line.substr(0, 120) << std::endl;
+                return;
+            }
+            ++_records;
+            ++_count[tid];
+            // 序号从1开始;不丢弃时必须连续
+            if (seq <= _last[tid] || (_lossless && seq != _last[tid] + 1))
+            {
+                if (_disorder++ < 5)
+                    std::cerr << "  线程" << tid << "序号" << _last[tid] << "之后是" << seq << std::endl;
+            }
+            _last[tid] = seq;
+        }
+
+    private:
+        bool _lossless;
+        std::vector<size_t> _last;
+        std::vector<size_t> _count;
+        std::string _rest;
+        size_t _records;
+        size_t _torn;
+        size_t _disorder;
+    };
+
+    // 在写入时校验,检查异步缓冲区交给落地方向的每一块
+    class CheckSink : public Log::Sink
+    {
+    public:
+        CheckSink(size_t threads, bool lossless)
+            : _checker(threads, lossless)
+        {
+        }
+        void WriteFile(const std::string &str) override { WriteData(str.data(), str.size()); }
+        void WriteData(const char *data, size_t len) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _checker.feed(data, len);
+        }
+        Checker _checker;
+        std::mutex _mutex;
+    };
+
+    struct Combo
+    {
+        const char *name;
+        Log::Data::LogGerType type;
+        Log::Data::AnsyCtrlType actrl;
+        Log::Data::OverflowPolicy overflow;
+        bool lossless;
+    };
+
+    struct Totals
+    {
+        std::atomic<size_t> messages{0};
+        std::atomic<size_t> bytes{0};
+        size_t rounds = 0;
+        size_t rotations = 0;
+        size_t dropped = 0;
+        size_t failures = 0;
+    };
+
+    // 滚动文件按序号排序后拼接
+    std::string ReadRolled(const std::string &dir)
+    {
+        std::vector<Log::tool::File::FileInfo> files = Log::tool::File::ListFiles(dir + "roll*" + Log::Data::defaultFix());
+        std::sort(files.begin(), files.end(), [&](const Log::tool::File::FileInfo &a, const Log::tool::File::FileInfo &b)
+                  { return std::stoul(a.path.substr(dir.size() + 4)) < std::stoul(b.path.substr(dir.size() + 4)); });
+        std::string all;
+        for (auto &f : files)
+        {
+            std::ifstream in(f.path, std::ios::binary);
+            all.append((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        }
+        return all;
+    }
+    std::string ReadFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    bool Verify(const char *what, const Combo &combo, Checker &checker, size_t per, size_t dropped)
+    {
+        size_t missing = checker.finish(per);
+        bool ok = checker.torn() == 0 && checker.disorder() == 0 &&
+                  (combo.lossless ? missing == 0 : missing == dropped);
+        if (!ok)
+            std::cerr << "[失败] " << combo.name << " " << what << ": 记录" << checker.records() << " 不完整"
+                      << checker.torn() << " 乱序" << checker.disorder() << " 丢失" << missing
+                      << " 统计丢弃" << dropped << std::endl;
+        return ok;
+    }
+
+    void Round(const Combo &combo, size_t threads, size_t per, size_t round, Totals &totals)
+    {
+        std::string dir = "./stress_logs/" + std::to_string(round) + "/";
+        system(("rm -rf " + dir).c_str());
+        Log::tool::File::createFilePath(dir);
+
+        Log::Sink::ptr roll = Log::SinkFactory::RollFileSink(256 * 1024, dir + "roll", Log::Data::NONE, Log::RetainPolicy());
+        Log::Sink::ptr file = Log::SinkFactory::FiletSink(dir + "file.log");
+        std::shared_ptr<CheckSink> check = std::make_shared<CheckSink>(threads, combo.lossless);
+        std::vector<Log::Sink::ptr> sinks = {roll, file, check};
+        for (auto &s : sinks)
+            s->SetOverflow(combo.overflow);
+        Log::LogGer::Logger::ptr lg;
+        {
+            Log::LogGer::LoggerBuilder::ptr bp = std::make_shared<Log::LogGer::LocalLogder>();
+            bp->InitLevel(Log::LogLevel::DEBUG);
+            bp->InitLoggerType(combo.type);
+            bp->InitACType(combo.actrl);
+            bp->InitLoggername(std::string("stress_") + combo.name);
+            bp->InitFormat("%c%n");
+            bp->InitSinkWay(sinks);
+            lg = bp->InitLB();
+        }
+
+        std::vector<std::thread> ths;
+        for (size_t t = 0; t < threads; ++t)
+            ths.emplace_back([&, t]()
+                             {
+                for (size_t seq = 1; seq <= per; ++seq)
+                {
+                    std::string payload = Payload(t, seq);
+                    lg->INFO("R {} {} {}", t, seq, payload);
+                    totals.messages.fetch_add(1, std::memory_order_relaxed);
+                    totals.bytes.fetch_add(payload.size() + 16, std::memory_order_relaxed);
+                } });
+        for (auto &th : ths)
+            th.join();
+
+        // 销毁日志器,等待后台写完
+        std::vector<Log::ChannelStats> stats = lg->getSinkStats();
+        lg.reset();
+        std::vector<size_t> dropped;
+        for (size_t i = 0; i < sinks.size(); ++i)
+        {
+            dropped.push_back(stats[i].dropped);
+            totals.dropped += stats[i].dropped;
+        }
+        totals.rotations += roll->GetRotations();
+        sinks.clear();
+        roll.reset();
+        file.reset();
+
+        Checker rolled(threads, combo.lossless), plain(threads, combo.lossless);
+        std::string data = ReadRolled(dir);
+        rolled.feed(data.data(), data.size());
+        data = ReadFile(dir + "file.log");
+        plain.feed(data.data(), data.size());
+        bool ok = Verify("滚动文件", combo, rolled, per, dropped[0]);
+        ok = Verify("普通文件", combo, plain, per, dropped[1]) && ok;
+        {
+            // 拿到锁说明最后一次写入已经完成
+            std::unique_lock<std::mutex> lock(check->_mutex);
+            ok = Verify("写入时校验", combo, check->_checker, per, dropped[2]) && ok;
+        }
+        if (ok)
+            system(("rm -rf " + dir).c_str());
+        else
+            ++totals.failures;
+        ++totals.rounds;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t seconds = 5, threads = 8, per = 5000, report = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        size_t value = std::stoul(argv[i + 1]);
+        if (arg == "--seconds")
+            seconds = value;
+        else if (arg == "--threads")
+            threads = value;
+        else if (arg == "--per")
+            per = value;
+        else if (arg == "--report")
+            report = value ? value : 1;
+    }
+
+    const Combo combos[] = {
+        {"sync", Log::Data::SYNCLOGGER, Log::Data::COMMON, Log::Data::BLOCK, true},
+        {"common_block", Log::Data::ASYNLOGGER, Log::Data::COMMON, Log::Data::BLOCK, true},
+        {"common_drop", Log::Data::ASYNLOGGER, Log::Data::COMMON, Log::Data::DROP, false},
+        {"thpool", Log::Data::ASYNLOGGER, Log::Data::THPOOL, Log::Data::DROP, false},
+    };
+    const size_t ncombo = sizeof(combos) / sizeof(combos[0]);
+
+    Totals totals;
+    std::atomic<bool> done(false);
+    auto start = std::chrono::steady_clock::now();
+    std::thread reporter([&]()
+                         {
+        size_t last = 0, lastbytes = 0;
+        auto prev = start;
+        while (!done)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            auto now = std::chrono::steady_clock::now();
+            double dt = std::chrono::duration<double>(now - prev).count();
+            if (dt < report && !done)
+                continue;
+            size_t n = totals.messages, b = totals.bytes;
+            printf("[%6.0fs] %10.0f 条/秒 %8.2f MB/秒 累计%zu条\n",
+                   std::chrono::duration<double>(now - start).count(), (n - last) / dt,
+                   (b - lastbytes) / dt / 1048576, n);
+            fflush(stdout);
+            last = n;
+            lastbytes = b;
+            prev = now;
+        } });
+
+    size_t round = 0;
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(seconds) || round < ncombo)
+    {
+        Round(combos[round % ncombo], threads, per, round, totals);
+        ++round;
+    }
+    done = true;
+    reporter.join();
+
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("共%zu轮 %zu条 平均%.0f条/秒 滚动%zu次 丢弃%zu条 失败%zu轮\n", totals.rounds, totals.messages.load(),
+           totals.messages / total, totals.rotations, totals.dropped, totals.failures);
+    if (!totals.failures)
+        system("rm -rf ./stress_logs");
+    return totals.failures ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#include "../include/format.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+/*
+    二进制日志文件(BinaryFileSink)解码工具
+    用法: logdecode <文件> [--pattern 格式]
+    按日志格式还原为文本输出,默认使用配置文件中的日志格式
+*/
+
+static int Usage()
+{
+    std::cerr << "用法: logdecode <文件> [--pattern 格式]" << std::endl;
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path, pattern;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--pattern" && i + 1 < argc)
+            pattern = argv[++i];
+        else if (path.empty() && arg[0] != '-')
+            path = arg;
+        else
+            return Usage();
+    }
+    if (path.empty())
+        return Usage();
+
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs)
+    {
+        std::cerr << "无法打开文件: " << path << std::endl;
+        return 1;
+    }
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+
+    Log::Formatctrl fc(pattern.empty() ? Log::Data::defaultformat() : pattern);
+    size_t count = 0, skipped = 0;
+    bool ok = Log::Binary::Decode(ss.str(), [&](const Log::Binary::Entry &e)
+                                  {
+        Log::Message msg(e.line, e.level, e.file, e.type, e.logger, e.content);
+        msg._time = static_cast<time_t>(e.time_us / 1000000);
+        msg._tidnum = e.tid;
+        std::string line = fc.format(msg);
+        fwrite(line.data(), 1, line.size(), stdout);
+        ++count; }, &skipped);
+    if (skipped)
+        std::cerr << "跳过" << skipped << "条缺少调用点字典的日志" << std::endl;
+    if (!ok)
+    {
+        std::cerr << "文件不完整或已损坏,已还原" << count << "条日志" << std::endl;
+        return 1;
+    }
+    return 0;
+}